@@ -7,10 +7,31 @@
 //------------------------------------------------------------------------------
 // INCLUDE HEADERS
 //------------------------------------------------------------------------------
+#define _GNU_SOURCE
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <netdb.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
 
 
 //------------------------------------------------------------------------------
@@ -20,6 +41,95 @@
 #define MAX_BOARD_COLUMNS   26
 #define MAX_BOARD_ROWS      26
 #define MAX_BOARD_TITLE     LINE_MAX
+#define MAX_INPUT_PATH      4096
+#define MAX_WORKER_THREADS  256
+#define RECORD_SEPARATOR    "================================================================================\n"
+#define END_OF_PROCESSING   "\n*** END OF PROCESSING ***\n\n"
+#define ORDERED_ITEM_LIMIT  ( 1 << 20 ) // bytes an ordered item buffers before it waits for its turn
+#define SHARD_RECORD_TAG    "@@ shard-record"
+#define SHARD_END_TAG       "@@ shard-end"
+#define DEFAULT_CHUNK_SIZE  64
+#define MAX_FARM_WORKERS    256
+#define DEFAULT_FARM_HOST   "127.0.0.1"
+#define DEFAULT_HEARTBEAT   1.0     // seconds between worker heartbeats
+#define DEFAULT_HEARTBEAT_TIMEOUT 10.0 // seconds of silence before a worker is declared dead
+#define CHECKPOINT_MAGIC    "reversi-checkpoint 1"
+#define CACHE_MAGIC         "RVCACHE1"
+#define CACHE_VERSION       1
+#define SYMMETRIC_KEY_SALT  0x9E3779B97F4A7C15ull // sets symmetry-canonical cache keys apart from exact ones
+#define CACHE_WAYS          4       // records per bucket
+#define DEFAULT_CACHE_RECORDS ( 1 << 20 )
+#define GREEDY_ENGINE_CONFIG "greedy"
+#define TRANSFORM_MIRROR    1       // col -> nColumns - 1 - col
+#define TRANSFORM_FLIP      2       // row -> nRows - 1 - row
+#define TRANSFORM_TRANSPOSE 4       // row <-> col, square boards only; applied first
+#define N_SQUARE_TRANSFORMS 8
+#define N_RECTANGLE_TRANSFORMS 4
+#define DEDUP_INITIAL_CAPACITY 4096
+#define KEY_INDEX_INITIAL_CAPACITY 4096
+#define BOOK_MAGIC          "RVBOOK1"
+#define BOOK_VERSION        1
+#define MAX_MOVES           ( MAX_BOARD_ROWS * MAX_BOARD_COLUMNS )
+#define MAX_FLIPS           ( 8 * MAX_BOARD_ROWS ) // 8 directions, each shorter than the board
+#define SEARCH_INFINITY     32000
+#define SEARCH_WIN          10000   // final scores are +/-(SEARCH_WIN + disc difference)
+#define DEFAULT_BOOK_DEPTH  6
+#define DEFAULT_BOOK_NODES  1000
+#define MAX_BOOK_DEPTH      60
+#define TABLEBASE_MAGIC     "RVTBASE"
+#define TABLEBASE_VERSION   1
+#define TABLEBASE_MAX_CELLS 16      // larger boards have far too many positions to solve completely
+#define DEFAULT_TABLEBASE_SIZE 4
+#define DEFAULT_SEARCH_DEPTH 4
+#define MAX_ENGINE_SPEC     256     // engine configuration text, see parseEngineSpec()
+#define DEFAULT_MCTS_PLAYOUTS 2000
+#define MCTS_EXPLORATION    1.4     // weight of the exploration term of UCB1
+#define MAX_MCTS_NODES      ( 1 << 22 ) // beyond, leaves are no longer expanded
+#define DEFAULT_ENDGAME_EMPTIES 12  // empty cells from which the endgame engine solves exactly
+#define DEFAULT_TABLE_ENTRIES ( 1 << 20 ) // transposition table entries per thread
+#define WTHOR_HEADER_SIZE   16
+#define WTHOR_GAME_SIZE     68      // 8x8 games: 8 bytes of players and scores, then 60 moves
+#define WTHOR_MOVES_OFFSET  8
+#define WTHOR_MAX_MOVES     60
+#define NPY_HEADER_SIZE     256     // fixed, so the shape can be filled in once the count is known
+#define DATASET_BATCH_RECORDS 65536 // positions collected before they are labelled and written
+#define WEIGHTS_MAGIC       "RVWGHT1"
+#define WEIGHTS_VERSION     1
+#define N_PATTERNS          11
+#define MAX_PATTERN_CELLS   10
+#define MAX_PATTERN_INSTANCES 64
+#define WEIGHT_PHASES       6       // game stages by number of discs, each with its own weights
+#define TRAIN_CHUNK_RECORDS 65536
+#define TRAIN_WEIGHT_SLICES 64      // jobs of the gradient reduction
+#define DEFAULT_EPOCHS      30
+#define DEFAULT_LEARNING_RATE 1.0
+#define LOGISTIC_SCALE      10.0    // evaluation points per unit of logit
+#define DEFAULT_MATCH_GAMES 2000
+#define DEFAULT_SPRT_ELO0   0.0
+#define DEFAULT_SPRT_ELO1   10.0
+#define SPRT_ALPHA          0.05    // chance of accepting an improvement which is not one
+#define SPRT_BETA           0.05    // chance of missing an improvement of ELO1
+#define MAX_PV_LENGTH       32
+#define TIME_SAFETY_MARGIN  0.05    // seconds a clock keeps back for overheads
+#define TIME_RESERVE_MOVES  2       // moves budgeted beyond those left to play
+#define HARD_TIME_FACTOR    4.0     // hard limit of a move, in soft limits
+#define MIN_MOVE_TIME       0.005   // seconds every move gets, however short the clock
+#define STABLE_ITERATIONS   3       // iterations confirming the best move before a clocked search stops early
+#define TIME_INSTABILITY_FACTOR 1.5 // soft limit growth when the best move changes
+#define ITERATION_TIME_GROWTH 2.5   // time of an iteration over that of the previous one, as predicted
+#define ASPIRATION_WINDOW   8       // half width of the first root window around the expected score
+#define ORDER_TABLE_MOVE    ( 1 << 30 ) // move ordering keys: the table move first, then the killers,
+#define ORDER_KILLER        ( 1 << 29 ) //   then history less opponent mobility
+#define ORDER_MOBILITY_WEIGHT 4096  // history points per reply left to the opponent
+#define ORDER_MOBILITY_DEPTH 3      // depth from which mobility orders moves; shallower, history alone
+#define ORDER_HISTORY_LIMIT ( 1 << 20 ) // history scores are halved past this
+#define DEFAULT_RANDOM_PLIES 8      // random opening moves, so self-play games differ
+#define MAX_GAME_MOVES      ( 2 * MAX_MOVES ) // every move fills a cell and passes never follow a pass
+#define GAME_FILE_MAGIC     "RVGAMES"
+#define GAME_FILE_VERSION   1
+#define GAME_CUSTOM_START   1       // GameRecordHeader flag: the start position follows the header
+#define GAME_SHORT_MOVE_CELLS 255   // boards with fewer cells store one byte per move, others two
+#define GAME_RECORD_MAX_BYTES ( 2 * MAX_GAME_MOVES + 1 + ( MAX_MOVES + 3 ) / 4 ) // moves, player and packed start
 
 typedef enum
 {
@@ -41,8 +151,802 @@ typedef struct
     GameBoardCell player; // who can move next
     GameBoardCell state[MAX_BOARD_ROWS][MAX_BOARD_COLUMNS];
     char title[MAX_BOARD_TITLE];
+    char engine[MAX_ENGINE_SPEC]; // engine requested by the board; empty for the run's engine
 }GameBoard;
 
+typedef struct
+{
+    int row;                // -1 for a pass
+    int col;
+    GameBoardCell player;   // player who moved
+    int nFlips;
+    short flips[MAX_FLIPS]; // reversed cells, as row * MAX_BOARD_COLUMNS + col
+}MoveUndo;
+
+typedef enum
+{
+    BOUND_EXACT,
+    BOUND_LOWER,            // the score is at least the stored one
+    BOUND_UPPER             // the score is at most the stored one
+}ScoreBound;
+
+typedef struct
+{
+    uint64_t key;           // hashGameBoard() of the position
+    int16_t score;
+    int16_t move;           // best or refuting cell, as row * MAX_BOARD_COLUMNS + col; -1 if none
+    uint8_t depth;
+    uint8_t bound;          // a ScoreBound
+    uint16_t generation;    // SearchContext.generation when stored; entries of others are empty
+}TranspositionEntry;
+
+typedef struct
+{
+    int nInstances;         // every symmetric image of every pattern
+    int nCells[MAX_PATTERN_INSTANCES];
+    uint8_t cells[MAX_PATTERN_INSTANCES][MAX_PATTERN_CELLS]; // row * 8 + col, most significant digit first
+    int offset[MAX_PATTERN_INSTANCES]; // first weight of the instance's pattern within a phase
+    int nPhaseWeights;      // weights of one phase, the last being the bias
+}PatternSet;
+
+// Weight files are little-endian: a WeightsHeader followed by WEIGHT_PHASES times
+// [nPhaseWeights] floats, indexed as PatternSet lays them out.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t nPhases;
+    uint32_t nPhaseWeights;
+    float scale;            // evaluation points per unit of the weight sum
+}WeightsHeader;
+
+typedef struct
+{
+    PatternSet patterns;
+    float * weights;
+    float scale;
+}PatternWeights;
+
+typedef struct
+{
+    FILE * output;
+    double start;           // currentSeconds() when the analysis began
+    unsigned long startNodes; // search nodes counted before the analysis
+    double interval;        // seconds between progress lines within an iteration; 0 for none
+    double next;            // currentSeconds() of the next progress line
+}InfoSink;
+
+typedef struct
+{
+    unsigned long nodes;
+    const PatternWeights * weights; // NULL to evaluate with evaluateBoard()
+    TranspositionEntry * table; // NULL to search without a transposition table
+    uint64_t tableMask;     // entries - 1, entries being a power of two
+    uint16_t generation;    // of the table's live entries, advanced by clearTranspositionTable()
+    unsigned long tableHits; // probes which ended the search of a node
+    double deadline;        // currentSeconds() at which to stop searching; 0 for no limit
+    boolean stopped;        // the deadline passed: scores of the current iteration are void
+    volatile int stopRequest; // set by another thread to stop the search as at a deadline
+    InfoSink * info;        // progress reports, or NULL
+    double softTime;        // seconds of the move after which no iteration starts; 0 without a clock
+    boolean plain;          // plain alpha-beta, without null windows nor aspiration windows
+    unsigned long researches; // moves searched again after beating a null window
+    unsigned long aspirationFails; // root searches repeated with a wider window
+    unsigned long cutoffs;  // nodes which failed high
+    unsigned long firstCutoffs; // of them, on their first move
+    int history[MAX_MOVES]; // cutoff counts per cell, row * MAX_BOARD_COLUMNS + col, weighted by depth
+    short killers[MAX_MOVES + 1][2]; // cells + 1 of the last cutoff moves per remaining depth; 0 for none
+}SearchContext;
+
+// Game files are little-endian: a GameFileHeader, then the games one after another.
+// Each game is a GameRecordHeader, the start position when it is not the standard
+// start (one byte for the player to move, then four cells per byte, two bits each,
+// row-major), and one entry per move: the cell row * nColumns + col, or all ones
+// for a pass. An entry is one byte on boards of fewer than GAME_SHORT_MOVE_CELLS
+// cells and two bytes on larger boards.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+}GameFileHeader;
+
+typedef struct
+{
+    uint16_t nMoves;
+    uint8_t nRows;
+    uint8_t nColumns;
+    uint8_t flags;
+    uint8_t reserved;
+    int16_t result;         // BLACK discs minus WHITE discs at the end
+}GameRecordHeader;
+
+typedef struct
+{
+    GameBoard start;
+    boolean customStart;    // false for the standard start, see initStartBoard()
+    int moves[MAX_GAME_MOVES]; // cells as row * MAX_BOARD_COLUMNS + col, -1 for a pass
+    int nMoves;
+    int result;             // BLACK discs minus WHITE discs at the end
+}GameRecord;
+
+//--------------------------------------------------
+// GameVisitor
+// PURPOSE: Called by replayGame() with each position of a game, before its move
+// INPUT PARAMETERS:
+//   [context]<IN> Caller data
+//   [board]<IN> Position
+//   [ply]<IN> Number of moves played so far
+//   [move]<IN> Cell played next, -1 for a pass
+//--------------------------------------------------
+typedef void (*GameVisitor)( void * context, const GameBoard * board, int ply, int move );
+
+typedef struct
+{
+    uint64_t black;         // 8x8 position as bitboards, see packBitboards()
+    uint64_t white;
+    GameBoardCell player;
+    uint64_t key;           // canonicalHash() of the position
+    int firstChild;         // offset in the child list, valid once expanded
+    int nChildren;
+    int score;              // minimax value for the side to move
+    int depth;              // search depth behind the value
+    int dropout;            // smallest total loss against best play from the root
+    boolean expanded;
+    boolean evaluated;      // score holds a search or book value
+    boolean terminal;       // game over
+    int bestRow;            // best move, in the frame of this board
+    int bestCol;
+    int firstParent;        // first BookLink to the node's parents, -1 for the root
+    boolean queued;         // on a worklist of the current update
+    boolean dirty;          // changed since it was last journaled
+}BookNode;
+
+typedef struct
+{
+    int parent;
+    int next;               // next link to a parent of the same node, or -1
+}BookLink;
+
+typedef struct
+{
+    int dropout;            // drop-out of the leaf when it was pushed
+    int node;
+}BookLeaf;
+
+typedef enum
+{
+    SOURCE_ENGINE,          // computed for this board
+    SOURCE_BOOK,
+    SOURCE_TABLEBASE
+}MoveSource;
+
+typedef struct
+{
+    int row;                // -1 when there is no move
+    int col;
+    int score;              // number of reverses for the greedy engine
+    int depth;
+    MoveSource source;
+}BoardMove;
+
+typedef struct
+{
+    int cell;               // row * MAX_BOARD_COLUMNS + col
+    int score;              // number of reverses for the greedy engine
+    int order;              // what the ranking sorts on: the score, or the visits for MCTS
+    int nFlips;
+    int firstFlip;          // first of the move's cells in MoveRanking.flips
+}RankedMove;
+
+typedef struct
+{
+    RankedMove moves[MAX_MOVES]; // best first
+    int nMoves;
+    short * flips;          // reversed cells of every move, as row * MAX_BOARD_COLUMNS + col
+    int nFlips;
+    int flipCapacity;
+}MoveRanking;
+
+// Book files are little-endian: a BookHeader followed by [nRecords] BookRecords
+// sorted by key. Keys are canonicalHash() values and moves are in the frame of
+// the canonical image.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t nRecords;
+    uint64_t reserved;
+}BookHeader;
+
+typedef struct
+{
+    uint64_t key;
+    int16_t score;
+    int8_t row;
+    int8_t col;
+    uint8_t depth;
+    uint8_t reserved[3];
+}BookRecord;
+
+typedef struct
+{
+    const BookHeader * header;
+    const BookRecord * records;
+    size_t mappedSize;
+    unsigned long nHits;    // counters are updated atomically by the worker threads
+    unsigned long nLookups;
+}OpeningBook;
+
+// Tablebase files are little-endian: a TablebaseHeader followed by an open
+// addressing table of [capacity] TablebaseRecords, indexed by key modulo the
+// capacity and probed linearly. Keys are canonicalHash() values and moves are
+// in the frame of the canonical image.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t nRows;
+    uint32_t nColumns;
+    uint64_t nRecords;
+    uint64_t capacity;      // a power of two, at least twice nRecords
+    uint64_t reserved[3];
+}TablebaseHeader;
+
+typedef struct
+{
+    uint64_t key;
+    int8_t score;           // final disc difference for the side to move under perfect play
+    int8_t row;             // -1 for a pass or a finished game
+    int8_t col;
+    uint8_t used;           // 0 for an empty slot
+    uint8_t reserved[4];
+}TablebaseRecord;
+
+typedef struct
+{
+    const TablebaseHeader * header;
+    const TablebaseRecord * records;
+    size_t mappedSize;
+    unsigned long nHits;    // counters are updated atomically by the worker threads
+    unsigned long nLookups;
+}Tablebase;
+
+typedef struct
+{
+    TablebaseRecord * records;
+    uint64_t capacity;
+    uint64_t nRecords;
+    unsigned long nodes;
+}TablebaseSolver;
+
+typedef struct
+{
+    BookRecord * records;
+    size_t nRecords;
+    size_t capacity;
+    pthread_mutex_t lock;
+}BookCollector;
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t nBuckets;      // power of two
+    uint32_t nWays;
+    uint32_t recordSize;
+    uint32_t generation;    // bumped by every run, to age out old records
+    uint32_t reserved[9];
+}PositionCacheHeader;
+
+// A record is two words: [check] is the key XOR [data]. A reader recomputes the key
+// from both words, so a record torn by two processes writing at once reads as a miss.
+// [data] packs score (16 bits), depth (8), row + 1 (8), col + 1 (8), generation (8)
+// and engine config (16).
+typedef struct
+{
+    uint64_t check;
+    uint64_t data;
+}CacheRecord;
+
+typedef struct
+{
+    int fd;
+    PositionCacheHeader * header;
+    CacheRecord * records;
+    size_t mappedSize;
+    unsigned int generation;
+    unsigned long nHits;    // counters are updated atomically by the worker threads
+    unsigned long nMisses;
+    unsigned long nStores;
+}PositionCache;
+
+typedef enum
+{
+    DEDUP_EMPTY,
+    DEDUP_PENDING,          // being computed by some thread
+    DEDUP_READY
+}DedupState;
+
+typedef struct
+{
+    uint64_t key;
+    uint64_t exact;         // exact key of the board the move was computed on
+    BoardMove move;         // in the frame of the key's image
+    boolean invariant;      // every symmetric image would get the image of the move
+    DedupState state;
+}DedupEntry;
+
+typedef struct
+{
+    DedupEntry * entries;   // open addressing, linear probing
+    size_t capacity;        // power of two
+    size_t nUsed;
+    boolean symmetric;      // key on canonical hashes rather than exact positions
+    unsigned long nUnique;
+    unsigned long nDuplicates;
+    unsigned long nRecomputed; // images computed again, their best move possibly tied
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+}DedupTable;
+
+typedef struct
+{
+    uint64_t key;
+    int value;              // -1 for an empty slot
+}KeyIndexEntry;
+
+typedef struct
+{
+    KeyIndexEntry * entries; // open addressing, linear probing
+    size_t capacity;        // power of two
+    size_t nUsed;
+}KeyIndex;
+
+typedef struct
+{
+    int nBoards;
+    double seconds;
+}StreamStats;
+
+typedef struct
+{
+    char ** paths;
+    int nPaths;
+    int capacity;
+}InputList;
+
+typedef enum
+{
+    MODE_BATCH,
+    MODE_MERGE,
+    MODE_COORDINATOR,
+    MODE_WORKER,
+    MODE_BUILD_BOOK,
+    MODE_MAKE_TABLEBASE,
+    MODE_SELF_PLAY,
+    MODE_REPLAY,
+    MODE_ANNOTATE,
+    MODE_IMPORT_WTHOR,
+    MODE_EXPORT_DATASET,
+    MODE_TRAIN,
+    MODE_MATCH,
+    MODE_PLAY,
+    MODE_NBOARD
+}RunMode;
+
+typedef enum
+{
+    ENGINE_GREEDY,          // most reverses, first in row-major order
+    ENGINE_SEARCH,          // iterative alpha-beta, see searchIterative()
+    ENGINE_MCTS,            // Monte Carlo tree search with random playouts
+    ENGINE_ENDGAME          // exact solver near the end, the search before
+}EngineKind;
+
+typedef struct
+{
+    char name[MAX_ENGINE_SPEC]; // as given on the command line or the board
+    EngineKind kind;
+    int depth;              // deepest search iteration; 0 for --depth
+    double moveTime;        // seconds per move; 0 for no limit
+    int playouts;           // MCTS playouts per move; 0 for DEFAULT_MCTS_PLAYOUTS, or no limit with a time
+    int endgameEmpties;     // empty cells from which the endgame engine solves exactly
+    boolean plainSearch;    // search with plain alpha-beta, to compare with principal variation search
+    PatternWeights * weights; // search evaluation; NULL for --weights
+}EngineSpec;
+
+typedef struct
+{
+    int16_t move;           // cell played to reach the node, as row * MAX_BOARD_COLUMNS + col; -1 for a pass
+    int16_t nChildren;      // -1 until expanded
+    uint8_t player;         // player who made [move]
+    int firstChild;         // children are consecutive nodes
+    uint32_t visits;
+    float wins;             // playouts won by [player], draws counting half
+}MctsNode;
+
+typedef struct
+{
+    double remaining;       // seconds; negative once the flag fell
+    double increment;       // seconds added after each move
+}GameClock;
+
+typedef struct
+{
+    EngineSpec spec;
+    int depth;              // spec.depth, or --depth
+    const PatternWeights * weights; // spec.weights, or --weights
+    uint64_t tableEntries;
+    uint64_t seed;
+    unsigned int configId;  // engineConfigId() of the configuration, keys stored results
+    boolean initialized;
+    boolean ownsWeights;    // spec.weights was loaded for this engine alone
+    boolean busy;           // checked out of an engine pool
+    SearchContext search;   // search and endgame engines
+    MctsNode * tree;        // MCTS engine
+    uint64_t treeKey;       // hashGameBoard() of the tree's root; 0 when there is no tree
+    boolean treeChosen;     // the tree holds the playouts of a finished chooseMctsMove()
+    int nTreeNodes;
+    int treeCapacity;
+    GameClock * clock;      // clock of the side to move, charged by chooseEngineMove(); NULL to play by spec.moveTime
+    unsigned long nMoves;
+    unsigned long nPlayouts;
+    double seconds;         // spent choosing moves
+}Engine;
+
+//--------------------------------------------------
+// EngineType
+// PURPOSE: Operations of one kind of engine; all but [choose] may be NULL
+//   init: set up the state of an engine whose configuration initEngine() filled in
+//   choose: pick the move of board->player (row -1 when there is none) and
+//     restore the board before returning
+//   rank: score every move of a MoveRanking, better moves higher; unchanged, the
+//     scores are the numbers of reverses
+//   ponder: think about a position until search.stopRequest is set, to answer
+//     it or, under MCTS, any position below it sooner; best is the move found
+//   stats: print the totals of the engine
+//   reset: forget what earlier positions taught the engine, as between games
+//   release: free the state of the engine
+//--------------------------------------------------
+typedef struct
+{
+    const char * name;
+    void ( * init )( Engine * engine );
+    void ( * choose )( Engine * engine, GameBoard * board, BoardMove * best );
+    void ( * rank )( Engine * engine, GameBoard * board, MoveRanking * ranking );
+    void ( * ponder )( Engine * engine, GameBoard * board, BoardMove * best );
+    void ( * stats )( const Engine * engine, FILE * output );
+    void ( * reset )( Engine * engine );
+    void ( * release )( Engine * engine );
+}EngineType;
+
+typedef struct
+{
+    RunMode mode;
+    int nThreads;
+    const char * outputDir; // NULL for one combined stream on standard output
+    const char * outputFile; // combined stream written to this file instead of standard output
+    const char * cacheFile; // persistent position cache, or NULL
+    int cacheRecords;
+    boolean cacheSymmetric; // key the cache on symmetry-canonical hashes
+    boolean dedup;          // compute repeated boards of the run only once
+    boolean dedupSymmetric; // count symmetric images as repeats too
+    const char * bookFile;  // opening book to consult, or NULL
+    const char * makeBookFile; // book to write from the results of the run, or NULL
+    const char * buildBookFile; // book grown by drop-out expansion, or NULL
+    int bookNodes;          // positions added to the book per run
+    int bookDepth;          // search depth of the book leaves
+    const char * tablebaseFile; // perfect-play table for small boards, or NULL
+    const char * makeTablebaseFile; // tablebase to generate, or NULL
+    int tablebaseSize;      // rows and columns of the generated tablebase
+    long selfPlayGames;     // games to play in self-play mode
+    EngineSpec engine;      // engine of boards without their own and of self-play
+    int searchDepth;        // depth of the search engines
+    int randomPlies;        // opening plies played at random in self-play
+    uint64_t seed;          // self-play random seed
+    uint64_t tableEntries;  // transposition table entries per search thread
+    const char * datasetFile; // training dataset to export, or NULL
+    const char * weightsFile; // pattern weights for the search evaluation, or NULL
+    PatternWeights * weights; // loaded from weightsFile
+    const char * trainFile; // pattern weights to fit, or NULL
+    int epochs;
+    double learningRate;
+    boolean logistic;       // fit the win probability instead of the disc difference
+    boolean trainOnScore;   // fit the search score label instead of the game result
+    EngineSpec players[2];  // engines of a match
+    long matchGames;        // most games of a match
+    double sprtElo0;        // Elo difference of the null hypothesis
+    double sprtElo1;        // Elo difference of the alternative hypothesis
+    boolean ponder;         // think on the opponent's time in play mode
+    double infoInterval;    // seconds between progress lines of play mode; 0 for one per iteration
+    GameClock clock;        // time control of each side in games; remaining 0 for none
+    boolean info;           // print the progress of go commands too
+    int checkpointEvery;    // boards between checkpoints; 0 disables checkpoints
+    boolean resume;         // continue from the last checkpoint
+    int shardIndex;
+    int nShards;            // 0 when not sharding
+    boolean shardByChunk;   // own whole chunks of [chunkSize] boards rather than single boards
+    int chunkSize;
+    int topMoves;           // ranked moves printed after the best one; 0 for none
+    char farmHost[LINE_MAX]; // coordinator address to listen on or connect to
+    int farmPort;
+    int nSpawnWorkers;      // local worker processes started by the coordinator
+    double heartbeat;
+    double heartbeatTimeout;
+    InputList inputs;
+}Options;
+
+typedef struct
+{
+    PositionCache * cache;  // NULL when no cache file is used
+    DedupTable * dedup;     // NULL unless duplicates are eliminated
+    OpeningBook * book;     // NULL when no book is used
+    BookCollector * bookOut; // results collected for --make-book, or NULL
+    Tablebase * tablebase;  // NULL when no tablebase is used
+    const char * bookOutPath;
+    const Options * options;
+    Engine ** engines;      // engines created so far, checked out by acquireEngine()
+    int nEngines;
+    int engineCapacity;
+    pthread_mutex_t engineLock;
+    boolean symmetry;       // key the cache on symmetry-canonical hashes (--cache-symmetric)
+}AnalysisContext;
+
+typedef struct
+{
+    const Options * options;
+    BookNode * nodes;
+    int nNodes;
+    int nodeCapacity;
+    KeyIndex index;         // canonical key to node
+    int * children;         // child lists of the expanded nodes
+    int * childCells;       // move leading to each child, -1 for a pass
+    int nChildren;
+    int childCapacity;
+    BookLink * links;       // parent lists, for transpositions make a node's parents many
+    int nLinks;
+    int linkCapacity;
+    int * leaves;           // nodes to evaluate in the current batch
+    int nLeaves;
+    int * dirty;            // nodes changed this round
+    int nDirty;
+    int dirtyCapacity;
+    int * work;             // worklist space, one entry per node
+    int workCapacity;
+    BookLeaf * heap;        // unexpanded leaves by drop-out; entries go stale when it changes
+    int nHeap;
+    int heapCapacity;
+    unsigned long nodesSearched; // updated atomically by the worker threads
+}BookBuildContext;
+
+typedef struct
+{
+    char path[MAX_INPUT_PATH];
+    char inputPath[MAX_INPUT_PATH];
+    int every;              // boards between two checkpoints
+    int sinceSaved;
+    int input;              // index of the input being read
+    long offset;            // bytes of that input consumed
+    int ordinal;            // boards of that input consumed, owned by this shard or not
+    int nBoards;            // boards written to the output, over all runs
+    long outputSize;        // output bytes known to be on disk
+}Checkpoint;
+
+typedef struct
+{
+    FILE * file;
+    boolean hasRecord;
+    int shard;              // i of the i/N in the tags; nShards 0 until a tag was read
+    int nShards;
+    int input;
+    int ordinal;
+    int * inputBoards;      // boards of each input according to its end tag, -1 until read
+    int nInputs;
+    boolean mismatched;     // tags of different shard runs in one output
+    char * body;
+    size_t length;
+    size_t capacity;
+    char * line;
+    size_t lineCapacity;
+    boolean truncated;      // the last record ended before its length
+}ShardReader;
+
+// job callback for the worker pool: [index] is the job number, [thread] the worker number
+typedef void ( * WorkerJob )( void * context, int index, int thread );
+
+typedef struct
+{
+    WorkerJob job;
+    void * context;
+    int nJobs;
+    int nextJob;
+    int nextThread;
+    pthread_mutex_t lock;
+}WorkerPool;
+
+typedef struct
+{
+    FILE * output;
+    char ** buffers;
+    size_t * sizes;
+    boolean * ready;
+    int nItems;
+    int nextItem;
+    pthread_mutex_t lock;
+    pthread_cond_t turn;    // signalled whenever nextItem moves on
+}OrderedOutput;
+
+typedef struct
+{
+    const Options * options;
+    GameBoard * starts;     // start positions, used round robin
+    int nStarts;
+    long nChunks;
+    OrderedOutput output;
+    unsigned long nPositions; // updated atomically by the worker threads
+    long nDropped;          // games ended by an illegal engine move, updated atomically
+    Engine engines[MAX_WORKER_THREADS]; // one per worker thread, reset between games
+}SelfPlayContext;
+
+typedef struct
+{
+    const Options * options;
+    GameRecord * games;     // the current batch of games
+    int nGames;
+    long firstNumber;       // number of the first game of the batch
+    OrderedOutput output;
+    SearchContext searches[MAX_WORKER_THREADS]; // one per worker thread, reused across games
+    unsigned long nPositions; // updated atomically by the worker threads
+    unsigned long nFailed;  // games with an illegal move, updated atomically by the worker threads
+}AnnotateContext;
+
+// WTHOR files are little-endian: a 16-byte header holding the number of games at
+// offset 4 and the board size at offset 12 (0 or 8 for 8x8), then fixed-size game
+// records. Moves are 10 * row + col counted from 1, 0 past the end of the game;
+// passes are not recorded.
+typedef struct
+{
+    const char * path;
+    int fd;
+    long nGames;
+    int firstJob;           // jobs are chunks of games, numbered across all files
+}WthorFile;
+
+typedef struct
+{
+    const Options * options;
+    WthorFile * files;
+    int nFiles;
+    int nJobs;
+    OrderedOutput output;
+    unsigned long nGames;   // counters are updated atomically by the worker threads
+    unsigned long nPositions;
+    unsigned long nRejected;
+}WthorContext;
+
+// Dataset files are NumPy .npy files of one record array; the fields, in the
+// order below, are described in the header written by writeNpyHeader().
+typedef struct
+{
+    uint8_t planes[2][8][8]; // BLACK discs, then WHITE discs, as 0 or 1
+    int16_t score;          // search score for the side to move
+    uint8_t side;           // side to move: 0 for BLACK, 1 for WHITE
+    int8_t result;          // final disc difference for the side to move
+    int8_t best;            // best cell found by the search, row * 8 + col; -1 without search
+    int8_t played;          // cell played in the game
+    uint8_t ply;            // moves played before the position
+    uint8_t empties;        // empty cells
+}DatasetRecord;
+
+typedef struct
+{
+    const Options * options;
+    DatasetRecord * records; // unique positions of the current batch
+    int nRecords;
+    unsigned long nNodes;   // updated atomically by the worker threads
+}DatasetContext;
+
+typedef struct
+{
+    const DatasetRecord * records;
+    uint64_t nRecords;
+    size_t mappedSize;
+    int firstJob;           // jobs are chunks of records, numbered across all datasets
+}DatasetMap;
+
+typedef struct
+{
+    const Options * options;
+    PatternSet patterns;
+    DatasetMap * datasets;
+    int nDatasets;
+    int nJobs;
+    int nWeights;           // WEIGHT_PHASES * patterns.nPhaseWeights
+    float * weights;
+    float * counts;         // occurrences of each weight in the data
+    float * gradients[MAX_WORKER_THREADS]; // per-thread sums, reduced after each epoch
+    float * threadCounts[MAX_WORKER_THREADS];
+    double loss[MAX_WORKER_THREADS];
+    boolean counting;       // first pass: count occurrences instead of training
+}TrainContext;
+
+typedef struct
+{
+    const Options * options;
+    GameRecord * openings;  // opening lines, used round robin; NULL for random ones
+    int nOpenings;
+    Engine engines[2][MAX_WORKER_THREADS]; // per player and worker thread
+    pthread_mutex_t lock;   // guards the tallies and the decision
+    long wins;              // game results for players[0]
+    long draws;
+    long losses;
+    double llr;             // log-likelihood ratio of the SPRT
+    long timeLosses[2];     // games lost on time, per player
+    long illegalLosses[2];  // games lost by an illegal move, per player
+    int decision;           // +1 when the alternative is accepted, -1 for the null, 0 while open
+}MatchContext;
+
+typedef struct
+{
+    Engine * engine;
+    GameBoard board;        // position pondered
+    int predicted;          // reply the position assumes, as row * MAX_BOARD_COLUMNS + col; -1 for every reply
+    BoardMove best;         // move found for the position
+    boolean complete;       // the ponder finished before it was stopped
+    boolean analysis;       // run the engine's choose operation and print its move, rather than ponder
+    InfoSink info;          // progress lines of an analysis
+    boolean running;
+    pthread_t thread;
+}PonderContext;
+
+typedef struct
+{
+    char * text;            // boards in readGameBoard() format; freed once done
+    size_t size;
+    int nBoards;
+    char * result;          // printed records; freed once written out
+    size_t resultSize;
+    int nAssigned;          // 2 once stolen by an idle worker
+    boolean done;
+    double assignedAt;
+}FarmChunk;
+
+typedef struct
+{
+    int fd;
+    int chunk;              // chunk in progress, or -1 when idle
+    double lastSeen;
+    char * buffer;          // bytes received but not yet parsed
+    size_t length;
+    size_t capacity;
+}FarmWorker;
+
+typedef struct
+{
+    int fd;
+    volatile int stop;
+    double interval;
+    pthread_mutex_t * writeLock;
+}HeartbeatContext;
+
+typedef struct
+{
+    const Options * options;
+    FILE * output;          // combined stream
+    OrderedOutput combined;
+    AnalysisContext analysis;
+    StreamStats * stats;
+    boolean * succeeded;
+}BatchContext;
+
+typedef struct
+{
+    char * path;            // makeOutputPath() of the input
+    int input;
+}OutputName;
+
 
 //------------------------------------------------------------------------------
 // PROTOTYPES
@@ -59,12 +963,15 @@ boolean checkstate( const GameBoard * board );
 
 //--------------------------------------------------
 // computeBestMove
-// PURPOSE: Read one board from standard input and compute a player's best move
+// PURPOSE: Compute a player's best move and print it with the board
 // INPUT PARAMETERS:
+//   [analysis]<IN/OUT> Shared resources of the run, such as the position cache
+//   [position]<IN> Board read by readGameBoard()
+//   [output]<IN> Stream to print the board and its best move to
 // OUTPUT PARAMETERS:
 //   [boolean]<OUT> True if succeeded; otherwise, false
 //--------------------------------------------------
-boolean computeBestMove( );
+boolean computeBestMove( AnalysisContext * analysis, const GameBoard * position, FILE * output );
 
 //--------------------------------------------------
 // canPlayAt
@@ -111,8 +1018,9 @@ int numReverseDirection( const GameBoard * board, int row, int col, int dirRow,
 
 //--------------------------------------------------
 // readGameBoard
-// PURPOSE: Read a game board from standard input
+// PURPOSE: Read a game board from the input stream
 // INPUT PARAMETERS:
+//   [input]<IN> Stream to read from
 //   [board]<OUT> Board to store the information
 // OUTPUT PARAMETERS:
 //   [boolean]<OUT> True if no error occurred; otherwise, false
@@ -121,323 +1029,10256 @@ int numReverseDirection( const GameBoard * board, int row, int col, int dirRow,
 //   the board's row on each line (' ' for NONE, 'B' for BLACK, and 'W' for WHITE)
 //   and an empty line at the end.
 //--------------------------------------------------
-boolean readGameBoard( GameBoard * board );
+boolean readGameBoard( FILE * input, GameBoard * board );
 
 //--------------------------------------------------
 // printBoard
 // PURPOSE: Print board in pretty format
 // INPUT PARAMETERS:
+//   [output]<IN> Stream to print to
 //   [board]<IN> Game board to print
 //--------------------------------------------------
-void printBoard( const GameBoard * board );
+void printBoard( FILE * output, const GameBoard * board );
 
 //--------------------------------------------------
 // printBoardColumnName
 // PURPOSE: Print board's column head. Support function for printBoard()
 // INPUT PARAMETERS:
+//   [output]<IN> Stream to print to
 //   [nColumns]<IN> The number of columns for the currently printing board
 //--------------------------------------------------
-void printBoardColumnName( int nColumns );
+void printBoardColumnName( FILE * output, int nColumns );
 
 //--------------------------------------------------
 // printBoardRowSeparator
 // PURPOSE: Print board's row separator. Support function for printBoard()
 // INPUT PARAMETERS:
+//   [output]<IN> Stream to print to
 //   [nColumns]<IN> The number of columns for the currently printing board
 //--------------------------------------------------
-void printBoardRowSeparator( int nColumns );
+void printBoardRowSeparator( FILE * output, int nColumns );
 
+//--------------------------------------------------
+// parseOptions
+// PURPOSE: Parse the command line into run options
+// INPUT PARAMETERS:
+//   [argc]<IN> Number of arguments
+//   [argv]<IN> Arguments
+//   [options]<OUT> Parsed options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the command line is valid; otherwise, false
+//--------------------------------------------------
+boolean parseOptions( int argc, char * argv[], Options * options );
 
-//------------------------------------------------------------------------------
-// VARIABLES
-//------------------------------------------------------------------------------
-
+//--------------------------------------------------
+// printUsage
+// PURPOSE: Print command line help to standard error
+//--------------------------------------------------
+void printUsage( void );
 
-//------------------------------------------------------------------------------
-// FUNCTIONS
-//------------------------------------------------------------------------------
-//------------------------------------------------------
-// main
-// PURPOSE: Application entry point.
+//--------------------------------------------------
+// addInputPath
+// PURPOSE: Add an input file, or every file below an input directory, to the list
 // INPUT PARAMETERS:
+//   [inputs]<IN/OUT> List to append to
+//   [path]<IN> File or directory path; "-" stands for standard input
 // OUTPUT PARAMETERS:
-//   [int]<OUT> Application exit code.
-//------------------------------------------------------
-int main( void )
-{
-    while( computeBestMove( ) )
-    {
-        printf( "================================================================================\n" );
-        printf( "\n" );
-    }
-    printf( "\n*** END OF PROCESSING ***\n\n" );
-    return EXIT_SUCCESS;
-}
+//   [boolean]<OUT> True if the path exists; otherwise, false
+// REMARKS: Directory entries are visited in sorted order and hidden entries are
+//   skipped, so the same tree always gives the same input order.
+//--------------------------------------------------
+boolean addInputPath( InputList * inputs, const char * path );
 
+//--------------------------------------------------
+// freeInputList
+// PURPOSE: Release the memory held by an input list
+// INPUT PARAMETERS:
+//   [inputs]<IN/OUT> List to release
+//--------------------------------------------------
+void freeInputList( InputList * inputs );
 
-boolean checkstate( const GameBoard * board )
-{
-	assert(0 < board->nColumns && board->nColumns < MAX_BOARD_COLUMNS);
-	assert(0 < board->nRows && board->nColumns < MAX_BOARD_ROWS);
-	assert(board->player == WHITE || board->player == BLACK);
+//--------------------------------------------------
+// runWorkerPool
+// PURPOSE: Run [nJobs] jobs on up to [nThreads] threads and wait for all of them
+// INPUT PARAMETERS:
+//   [nThreads]<IN> Number of worker threads; 1 runs the jobs on the calling thread
+//   [nJobs]<IN> Number of jobs
+//   [job]<IN> Callback run once per job index
+//   [context]<IN> Passed to every callback
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the threads could be started; otherwise, false
+// REMARKS: Jobs are handed out in index order as threads become free.
+//--------------------------------------------------
+boolean runWorkerPool( int nThreads, int nJobs, WorkerJob job, void * context );
 
-	boolean bState = false;
+//--------------------------------------------------
+// workerPoolThread
+// PURPOSE: Thread body of the worker pool. Support function for runWorkerPool()
+// INPUT PARAMETERS:
+//   [argument]<IN> WorkerPool the thread belongs to
+// OUTPUT PARAMETERS:
+//   [void *]<OUT> Always NULL
+//--------------------------------------------------
+void * workerPoolThread( void * argument );
 
-	if (0 < board->nColumns && board->nColumns < MAX_BOARD_COLUMNS
-		&& 0 < board->nRows && board->nColumns < MAX_BOARD_ROWS
-		&&board->player == WHITE || board->player == BLACK)
-	{
-		bState = true;
-	}
+//--------------------------------------------------
+// initOrderedOutput
+// PURPOSE: Prepare an output that writes buffers in index order, whatever order they finish in
+// INPUT PARAMETERS:
+//   [ordered]<OUT> Ordered output to initialize
+//   [output]<IN> Stream the buffers are written to
+//   [nItems]<IN> Number of buffers that will be submitted
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if succeeded; otherwise, false
+//--------------------------------------------------
+boolean initOrderedOutput( OrderedOutput * ordered, FILE * output, int nItems );
+
+//--------------------------------------------------
+// submitOrderedOutput
+// PURPOSE: Hand over the finished buffer of one item
+// INPUT PARAMETERS:
+//   [ordered]<IN/OUT> Ordered output
+//   [index]<IN> Item index
+//   [buffer]<IN> malloc'ed buffer; ownership is taken
+//   [size]<IN> Number of bytes in the buffer
+// REMARKS: Thread-safe. Every item which is now at the head of the order is written out.
+//--------------------------------------------------
+void submitOrderedOutput( OrderedOutput * ordered, int index, char * buffer, size_t size );
+
+//--------------------------------------------------
+// openOrderedItem
+// PURPOSE: Open a memory stream that buffers the output of one item
+// INPUT PARAMETERS:
+//   [ordered]<IN/OUT> Ordered output
+//   [index]<IN> Item index
+// OUTPUT PARAMETERS:
+//   [FILE *]<OUT> Stream to write the item to, or NULL on failure
+// REMARKS: The item is written through spillOrderedItem() and closeOrderedItem().
+//--------------------------------------------------
+FILE * openOrderedItem( OrderedOutput * ordered, int index );
+
+//--------------------------------------------------
+// spillOrderedItem
+// PURPOSE: Keep the buffer of an item bounded
+// INPUT PARAMETERS:
+//   [ordered]<IN/OUT> Ordered output
+//   [index]<IN> Item index
+//   [output]<IN> Stream the item is written to
+// OUTPUT PARAMETERS:
+//   [FILE *]<OUT> Stream to go on writing the item to
+// REMARKS: Once the buffer holds ORDERED_ITEM_LIMIT bytes, waits until every earlier
+//   item is written, writes the buffer out and returns the underlying output, which
+//   the item then owns until closeOrderedItem(). Items must be started in index
+//   order, as the worker pool does, or the wait may never end.
+//--------------------------------------------------
+FILE * spillOrderedItem( OrderedOutput * ordered, int index, FILE * output );
+
+//--------------------------------------------------
+// closeOrderedItem
+// PURPOSE: Finish an item opened with openOrderedItem()
+// INPUT PARAMETERS:
+//   [ordered]<IN/OUT> Ordered output
+//   [index]<IN> Item index
+//   [output]<IN> Stream the item was last written to
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if succeeded; otherwise, false
+//--------------------------------------------------
+boolean closeOrderedItem( OrderedOutput * ordered, int index, FILE * output );
+
+//--------------------------------------------------
+// freeOrderedOutput
+// PURPOSE: Release an ordered output
+// INPUT PARAMETERS:
+//   [ordered]<IN/OUT> Ordered output to release
+//--------------------------------------------------
+void freeOrderedOutput( OrderedOutput * ordered );
+
+//--------------------------------------------------
+// processStream
+// PURPOSE: Compute the best move for every board of an input stream
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+//   [analysis]<IN/OUT> Shared resources of the run
+//   [inputIndex]<IN> Index of the input in the options
+//   [input]<IN> Stream to read boards from
+//   [output]<IN> Stream to print the results to
+//   [stats]<OUT> Number of boards and time spent
+//   [checkpoint]<IN/OUT> Progress to record every few boards, or NULL
+//   [ordered]<IN/OUT> Ordered output [output] is item [inputIndex] of, or NULL
+// OUTPUT PARAMETERS:
+//   [FILE *]<OUT> Stream the results were last printed to: [output] unless spilled
+// REMARKS: Every board is followed by the record separator. The end-of-processing
+//   trailer is left to the caller so that several streams can be combined.
+//   When sharding, boards owned by other shards are read but skipped, and each
+//   printed record is preceded by a tag line used by mergeShards(), which gives the
+//   shard, the record's place and its length in bytes; an end tag with the number of
+//   boards of the input follows the last record.
+//   When resuming, the input must already be positioned at the checkpoint offset;
+//   board ordinals then continue from the checkpoint. An ordered item is spilled
+//   after every board (see spillOrderedItem()) but left open.
+//--------------------------------------------------
+FILE * processStream( const Options * options, AnalysisContext * analysis, int inputIndex, FILE * input, FILE * output,
+    StreamStats * stats, Checkpoint * checkpoint, OrderedOutput * ordered );
+
+//--------------------------------------------------
+// processSink
+// PURPOSE: Process a range of inputs into one output file, with checkpoints if requested
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+//   [analysis]<IN/OUT> Shared resources of the run
+//   [firstInput]<IN> Index of the first input
+//   [endInput]<IN> Index past the last input
+//   [outputPath]<IN> Output file; its checkpoint is kept next to it with a ".ckpt" suffix
+//   [stats]<OUT> Per-input statistics, indexed like the inputs
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if succeeded; otherwise, false
+// REMARKS: On resume the output is cut back to the size recorded by the checkpoint,
+//   dropping records written after it, and reading restarts at the recorded input
+//   offset, so no result is lost or duplicated.
+//--------------------------------------------------
+boolean processSink( const Options * options, AnalysisContext * analysis, int firstInput, int endInput,
+    const char * outputPath, StreamStats * stats );
+
+//--------------------------------------------------
+// saveCheckpoint
+// PURPOSE: Commit the output written so far and record the progress
+// INPUT PARAMETERS:
+//   [checkpoint]<IN/OUT> Progress to save
+//   [output]<IN> Output stream the progress refers to
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the checkpoint is on disk; otherwise, false
+// REMARKS: The output is flushed and synced before the checkpoint, which is written
+//   to a temporary file and renamed over the old one, so a crash at any point leaves
+//   a checkpoint that never refers to output which is not on disk.
+//--------------------------------------------------
+boolean saveCheckpoint( Checkpoint * checkpoint, FILE * output );
+
+//--------------------------------------------------
+// loadCheckpoint
+// PURPOSE: Read back a checkpoint saved by saveCheckpoint()
+// INPUT PARAMETERS:
+//   [checkpoint]<IN/OUT> Checkpoint whose path is set; receives the progress
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if a valid checkpoint was found; otherwise, false
+//--------------------------------------------------
+boolean loadCheckpoint( Checkpoint * checkpoint );
+
+//--------------------------------------------------
+// openAnalysis
+// PURPOSE: Open the resources shared by every board of a run
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+//   [analysis]<OUT> Resources to set up
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if succeeded; otherwise, false
+//--------------------------------------------------
+boolean openAnalysis( const Options * options, AnalysisContext * analysis );
+
+//--------------------------------------------------
+// closeAnalysis
+// PURPOSE: Report the statistics of the shared resources and release them
+// INPUT PARAMETERS:
+//   [analysis]<IN/OUT> Resources to release
+//--------------------------------------------------
+void closeAnalysis( AnalysisContext * analysis );
+
+//--------------------------------------------------
+// mixHash
+// PURPOSE: Scramble a 64-bit value (splitmix64 finalizer)
+// INPUT PARAMETERS:
+//   [value]<IN> Value to scramble
+// OUTPUT PARAMETERS:
+//   [uint64_t]<OUT> Well-mixed hash of the value
+//--------------------------------------------------
+uint64_t mixHash( uint64_t value );
+
+//--------------------------------------------------
+// hashGameBoard
+// PURPOSE: Compute the hash of a position: size, side to move and cells, not the title
+// INPUT PARAMETERS:
+//   [board]<IN> Board to hash
+// OUTPUT PARAMETERS:
+//   [uint64_t]<OUT> Position hash
+// REMARKS: Every occupied cell contributes a Zobrist-style term keyed by its index
+//   (row * nColumns + col) and color, so the terms can be combined in any order.
+//--------------------------------------------------
+uint64_t hashGameBoard( const GameBoard * board );
+
+//--------------------------------------------------
+// countTransforms
+// PURPOSE: Find out how many symmetries a board size has
+// INPUT PARAMETERS:
+//   [board]<IN> Board
+// OUTPUT PARAMETERS:
+//   [int]<OUT> 8 for a square board, 4 for a rectangular one
+// REMARKS: Transforms are numbered by the TRANSFORM_* bits; the first
+//   countTransforms() of them apply to the board, 0 being the identity.
+//--------------------------------------------------
+int countTransforms( const GameBoard * board );
+
+//--------------------------------------------------
+// transformCell
+// PURPOSE: Map a cell to where a transform moves it
+// INPUT PARAMETERS:
+//   [transform]<IN> Combination of TRANSFORM_* bits
+//   [nRows]<IN> Number of rows of the board
+//   [nColumns]<IN> Number of columns of the board
+//   [row]<IN/OUT> Cell row; left alone when negative (no move)
+//   [col]<IN/OUT> Cell column
+//--------------------------------------------------
+void transformCell( int transform, int nRows, int nColumns, int * row, int * col );
+
+//--------------------------------------------------
+// inverseTransformCell
+// PURPOSE: Map a cell of a transformed board back to the original board
+// INPUT PARAMETERS:
+//   [transform]<IN> Transform which produced the transformed board
+//   [nRows]<IN> Number of rows of the board
+//   [nColumns]<IN> Number of columns of the board
+//   [row]<IN/OUT> Cell row; left alone when negative (no move)
+//   [col]<IN/OUT> Cell column
+//--------------------------------------------------
+void inverseTransformCell( int transform, int nRows, int nColumns, int * row, int * col );
+
+//--------------------------------------------------
+// transformGameBoard
+// PURPOSE: Apply a symmetry to a whole board
+// INPUT PARAMETERS:
+//   [board]<IN> Board to transform
+//   [transform]<IN> Combination of TRANSFORM_* bits
+//   [result]<OUT> Transformed board, with the same title and player
+//--------------------------------------------------
+void transformGameBoard( const GameBoard * board, int transform, GameBoard * result );
+
+//--------------------------------------------------
+// packBitboards
+// PURPOSE: Pack an 8x8 board into one bit per cell and color (bit row * 8 + col)
+// INPUT PARAMETERS:
+//   [board]<IN> 8x8 board
+//   [black]<OUT> Black discs
+//   [white]<OUT> White discs
+//--------------------------------------------------
+void packBitboards( const GameBoard * board, uint64_t * black, uint64_t * white );
+
+//--------------------------------------------------
+// transformBitboard
+// PURPOSE: Apply a symmetry to an 8x8 bitboard, matching transformCell()
+// INPUT PARAMETERS:
+//   [bits]<IN> Bitboard
+//   [transform]<IN> Combination of TRANSFORM_* bits
+// OUTPUT PARAMETERS:
+//   [uint64_t]<OUT> Transformed bitboard
+//--------------------------------------------------
+uint64_t transformBitboard( uint64_t bits, int transform );
+
+//--------------------------------------------------
+// hashBitboards
+// PURPOSE: Hash an 8x8 position given as bitboards
+// INPUT PARAMETERS:
+//   [black]<IN> Black discs
+//   [white]<IN> White discs
+//   [player]<IN> Side to move
+// OUTPUT PARAMETERS:
+//   [uint64_t]<OUT> The same value hashGameBoard() gives for the unpacked board
+//--------------------------------------------------
+uint64_t hashBitboards( uint64_t black, uint64_t white, GameBoardCell player );
+
+//--------------------------------------------------
+// canonicalHash
+// PURPOSE: Hash a position so that all its symmetric images get the same value
+// INPUT PARAMETERS:
+//   [board]<IN> Board to hash
+//   [transform]<OUT> Transform turning the board into its canonical image; may be NULL
+// OUTPUT PARAMETERS:
+//   [uint64_t]<OUT> Smallest hashGameBoard() over the symmetric images
+// REMARKS: A result stored in the frame of the canonical image is mapped back to
+//   any image with inverseTransformCell(). 8x8 boards are transformed as bitboards.
+//   When best moves tie, an image may get a different, equally good move back.
+//--------------------------------------------------
+uint64_t canonicalHash( const GameBoard * board, int * transform );
+
+//--------------------------------------------------
+// positionKey
+// PURPOSE: Compute the key results of a position are shared under
+// INPUT PARAMETERS:
+//   [analysis]<IN> Run resources; tells whether symmetry is used
+//   [board]<IN> Board
+//   [transform]<OUT> Transform into the frame results are kept in; 0 without symmetry
+// OUTPUT PARAMETERS:
+//   [uint64_t]<OUT> Key of the position cache
+// REMARKS: Exact by default, so a cached answer is the one computing the board gives.
+//   With symmetry, a tied best move may come back as the image of another board's choice.
+//--------------------------------------------------
+uint64_t positionKey( const AnalysisContext * analysis, const GameBoard * board, int * transform );
+
+//--------------------------------------------------
+// createDedupTable
+// PURPOSE: Create the table of positions already seen in this run
+// INPUT PARAMETERS:
+//   [symmetric]<IN> Treat symmetric images as the same position
+// OUTPUT PARAMETERS:
+//   [DedupTable *]<OUT> Empty table
+//--------------------------------------------------
+DedupTable * createDedupTable( boolean symmetric );
+
+//--------------------------------------------------
+// freeDedupTable
+// PURPOSE: Report the unique and duplicate counts on standard error and free the table
+// INPUT PARAMETERS:
+//   [table]<IN/OUT> Table to free; may be NULL
+//--------------------------------------------------
+void freeDedupTable( DedupTable * table );
+
+//--------------------------------------------------
+// reserveDuplicate
+// PURPOSE: Look a position up, or reserve it for the caller to compute
+// INPUT PARAMETERS:
+//   [table]<IN/OUT> Table of seen positions
+//   [key]<IN> Position key
+//   [exact]<IN> Exact key of the board; [key] itself unless the table is symmetric
+//   [move]<OUT> Result of the earlier occurrence
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True for a duplicate; false when the caller must compute the
+//                  position and hand the result to publishDuplicate()
+// REMARKS: Thread-safe. A duplicate of a position still being computed by another
+//   thread waits for that result instead of computing it again. A symmetric image
+//   of the earlier board is only a duplicate when that result was published as
+//   invariant: otherwise its own tie-break may pick another move, and the caller
+//   computes it (publishDuplicate() then leaves the entry alone).
+//--------------------------------------------------
+boolean reserveDuplicate( DedupTable * table, uint64_t key, uint64_t exact, BoardMove * move );
+
+//--------------------------------------------------
+// publishDuplicate
+// PURPOSE: Store the result of a position reserved by reserveDuplicate()
+// INPUT PARAMETERS:
+//   [table]<IN/OUT> Table of seen positions
+//   [key]<IN> Position key
+//   [exact]<IN> Exact key of the board, as given to reserveDuplicate()
+//   [move]<IN> Result, in the frame of the key's image
+//   [invariant]<IN> The result maps onto every symmetric image (see isOnlyBestMove())
+//--------------------------------------------------
+void publishDuplicate( DedupTable * table, uint64_t key, uint64_t exact, const BoardMove * move, boolean invariant );
+
+//--------------------------------------------------
+// initKeyIndex
+// PURPOSE: Prepare an empty key to index map
+// INPUT PARAMETERS:
+//   [index]<OUT> Map
+// REMARKS: Single-threaded, unlike the DedupTable.
+//--------------------------------------------------
+void initKeyIndex( KeyIndex * index );
+
+//--------------------------------------------------
+// lookupKeyIndex
+// PURPOSE: Find the value of a key
+// INPUT PARAMETERS:
+//   [index]<IN> Map
+//   [key]<IN> Key
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Value, or -1 if the key is not in the map
+//--------------------------------------------------
+int lookupKeyIndex( const KeyIndex * index, uint64_t key );
+
+//--------------------------------------------------
+// insertKeyIndex
+// PURPOSE: Add a key to the map
+// INPUT PARAMETERS:
+//   [index]<IN/OUT> Map
+//   [key]<IN> Key
+//   [value]<IN> Value, 0 or more
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the key was added; false if it was there already, with its value kept
+//--------------------------------------------------
+boolean insertKeyIndex( KeyIndex * index, uint64_t key, int value );
+
+//--------------------------------------------------
+// freeKeyIndex
+// PURPOSE: Release a key to index map
+// INPUT PARAMETERS:
+//   [index]<IN/OUT> Map
+//--------------------------------------------------
+void freeKeyIndex( KeyIndex * index );
+
+//--------------------------------------------------
+// findKeyIndexEntry
+// PURPOSE: Find the slot of a key, or the empty slot where it belongs. Support function for the KeyIndex
+// INPUT PARAMETERS:
+//   [entries]<IN> Slots
+//   [capacity]<IN> Number of slots, a power of two
+//   [key]<IN> Key
+// OUTPUT PARAMETERS:
+//   [KeyIndexEntry *]<OUT> Slot
+//--------------------------------------------------
+KeyIndexEntry * findKeyIndexEntry( KeyIndexEntry * entries, size_t capacity, uint64_t key );
+
+//--------------------------------------------------
+// findDedupEntry
+// PURPOSE: Find the slot of a key, or the empty slot where it belongs. Support function for the DedupTable
+// INPUT PARAMETERS:
+//   [entries]<IN> Slots
+//   [capacity]<IN> Number of slots, a power of two
+//   [key]<IN> Position key
+// OUTPUT PARAMETERS:
+//   [DedupEntry *]<OUT> Slot
+//--------------------------------------------------
+DedupEntry * findDedupEntry( DedupEntry * entries, size_t capacity, uint64_t key );
+
+//--------------------------------------------------
+// countReverses
+// PURPOSE: Find out how many pieces the player reverses by playing at a cell
+// INPUT PARAMETERS:
+//   [board]<IN/OUT> Board; restored before returning
+//   [row]<IN> Cell row, or -1 for no move
+//   [col]<IN> Cell column
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Number of reverses; 0 for no move or an occupied cell
+//--------------------------------------------------
+int countReverses( GameBoard * board, int row, int col );
+
+//--------------------------------------------------
+// isOnlyBestMove
+// PURPOSE: Check if a result would come out the same, mapped, on every symmetric image of the board
+// INPUT PARAMETERS:
+//   [engine]<IN> Engine the result was computed with
+//   [board]<IN/OUT> Board; restored before returning
+//   [best]<IN> Result
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True for a pass, a book or tablebase answer, or the greedy engine's
+//                  only move with the most reverses; otherwise, false
+// REMARKS: Ties are broken by scan order, which a symmetry changes. The search
+//   engines do not tell whether another move scored the same, so their results
+//   never count as invariant.
+//--------------------------------------------------
+boolean isOnlyBestMove( const Engine * engine, GameBoard * board, const BoardMove * best );
+
+//--------------------------------------------------
+// openOpeningBook
+// PURPOSE: Map an opening book file read-only
+// INPUT PARAMETERS:
+//   [path]<IN> Book file
+// OUTPUT PARAMETERS:
+//   [OpeningBook *]<OUT> Opened book, or NULL on error
+// REMARKS: The mapping is shared, so processes using the same book share one copy
+//   in the page cache.
+//--------------------------------------------------
+OpeningBook * openOpeningBook( const char * path );
+
+//--------------------------------------------------
+// closeOpeningBook
+// PURPOSE: Report the book hit count on standard error and unmap the book
+// INPUT PARAMETERS:
+//   [book]<IN/OUT> Book to close; may be NULL
+//--------------------------------------------------
+void closeOpeningBook( OpeningBook * book );
+
+//--------------------------------------------------
+// lookupOpeningBook
+// PURPOSE: Find the record of a key in the book
+// INPUT PARAMETERS:
+//   [book]<IN/OUT> Book to search
+//   [key]<IN> Canonical position hash
+// OUTPUT PARAMETERS:
+//   [const BookRecord *]<OUT> Record, or NULL when the position is not in the book
+// REMARKS: Keys are uniformly distributed hashes, so the search interpolates the
+//   probe position and only falls back to bisection when interpolation stalls.
+//--------------------------------------------------
+const BookRecord * lookupOpeningBook( OpeningBook * book, uint64_t key );
+
+//--------------------------------------------------
+// createBookCollector
+// PURPOSE: Create an empty, thread-safe list of book records
+// OUTPUT PARAMETERS:
+//   [BookCollector *]<OUT> Empty collector
+//--------------------------------------------------
+BookCollector * createBookCollector( void );
+
+//--------------------------------------------------
+// addBookRecord
+// PURPOSE: Append the result of a position to a collector
+// INPUT PARAMETERS:
+//   [collector]<IN/OUT> Collector
+//   [key]<IN> Canonical position hash
+//   [move]<IN> Result, in the frame of the canonical image
+//--------------------------------------------------
+void addBookRecord( BookCollector * collector, uint64_t key, const BoardMove * move );
+
+//--------------------------------------------------
+// freeBookCollector
+// PURPOSE: Free a collector
+// INPUT PARAMETERS:
+//   [collector]<IN/OUT> Collector to free; may be NULL
+//--------------------------------------------------
+void freeBookCollector( BookCollector * collector );
+
+//--------------------------------------------------
+// writeOpeningBook
+// PURPOSE: Sort records and write them as a book file
+// INPUT PARAMETERS:
+//   [path]<IN> Book file to replace
+//   [records]<IN/OUT> Records; sorted in place
+//   [nRecords]<IN> Number of records
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the book was written; otherwise, false
+// REMARKS: Of several records with one key, the deepest is kept. The file is
+//   written under a temporary name and renamed, so readers never see half a book.
+//--------------------------------------------------
+boolean writeOpeningBook( const char * path, BookRecord * records, size_t nRecords );
+
+//--------------------------------------------------
+// compareBookRecords
+// PURPOSE: qsort() order of book records: by key, deepest first
+// INPUT PARAMETERS:
+//   [left]<IN> Record
+//   [right]<IN> Record
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Negative, zero or positive
+//--------------------------------------------------
+int compareBookRecords( const void * left, const void * right );
+
+//--------------------------------------------------
+// opponentOf
+// PURPOSE: Find out the other player
+// INPUT PARAMETERS:
+//   [player]<IN> BLACK or WHITE
+// OUTPUT PARAMETERS:
+//   [GameBoardCell]<OUT> WHITE or BLACK
+//--------------------------------------------------
+GameBoardCell opponentOf( GameBoardCell player );
+
+//--------------------------------------------------
+// initStartBoard
+// PURPOSE: Set up the standard starting position: four discs in the center, BLACK to move
+// INPUT PARAMETERS:
+//   [board]<OUT> Board to set up
+//   [nRows]<IN> Number of rows
+//   [nColumns]<IN> Number of columns
+//--------------------------------------------------
+void initStartBoard( GameBoard * board, int nRows, int nColumns );
+
+//--------------------------------------------------
+// unpackBitboards
+// PURPOSE: Rebuild an 8x8 board from bitboards, the reverse of packBitboards()
+// INPUT PARAMETERS:
+//   [black]<IN> Black discs
+//   [white]<IN> White discs
+//   [player]<IN> Side to move
+//   [board]<OUT> Board
+//--------------------------------------------------
+void unpackBitboards( uint64_t black, uint64_t white, GameBoardCell player, GameBoard * board );
+
+//--------------------------------------------------
+// playMove
+// PURPOSE: Play the current player's piece at a cell, reverse the outflanked pieces
+//   and hand the turn over
+// INPUT PARAMETERS:
+//   [board]<IN/OUT> Board to play on
+//   [row]<IN> Cell row
+//   [col]<IN> Cell column
+//   [undo]<OUT> What undoMove() needs to take the move back; may be NULL
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Number of reversed pieces; 0 for an illegal move, which leaves the board untouched
+//--------------------------------------------------
+int playMove( GameBoard * board, int row, int col, MoveUndo * undo );
+
+//--------------------------------------------------
+// passMove
+// PURPOSE: Hand the turn over without playing
+// INPUT PARAMETERS:
+//   [board]<IN/OUT> Board
+//   [undo]<OUT> What undoMove() needs to take the pass back; may be NULL
+//--------------------------------------------------
+void passMove( GameBoard * board, MoveUndo * undo );
+
+//--------------------------------------------------
+// undoMove
+// PURPOSE: Take back a move made by playMove() or passMove()
+// INPUT PARAMETERS:
+//   [board]<IN/OUT> Board
+//   [undo]<IN> Record of the move
+//--------------------------------------------------
+void undoMove( GameBoard * board, const MoveUndo * undo );
+
+//--------------------------------------------------
+// generateMoves
+// PURPOSE: List the legal moves of the current player
+// INPUT PARAMETERS:
+//   [board]<IN/OUT> Board; restored before returning
+//   [cells]<OUT> Legal cells in row-major order, as row * MAX_BOARD_COLUMNS + col; may be NULL
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Number of legal moves
+//--------------------------------------------------
+int generateMoves( GameBoard * board, int * cells );
+
+//--------------------------------------------------
+// isLegalMove
+// PURPOSE: Check if the current player can play at a cell
+// INPUT PARAMETERS:
+//   [board]<IN/OUT> Board; restored before returning
+//   [row]<IN> Cell row
+//   [col]<IN> Cell column
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if at least one piece would be reversed; otherwise, false
+//--------------------------------------------------
+boolean isLegalMove( GameBoard * board, int row, int col );
+
+//--------------------------------------------------
+// discDifference
+// PURPOSE: Count the current player's discs minus the opponent's
+// INPUT PARAMETERS:
+//   [board]<IN> Board
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Disc difference
+//--------------------------------------------------
+int discDifference( const GameBoard * board );
+
+//--------------------------------------------------
+// finalScore
+// PURPOSE: Score a finished game for the current player
+// INPUT PARAMETERS:
+//   [board]<IN> Board where neither player can move
+// OUTPUT PARAMETERS:
+//   [int]<OUT> SEARCH_WIN plus the disc difference for a win, the negation for a loss, 0 for a draw
+//--------------------------------------------------
+int finalScore( const GameBoard * board );
+
+//--------------------------------------------------
+// evaluateBoard
+// PURPOSE: Estimate how good a position is for the current player
+// INPUT PARAMETERS:
+//   [board]<IN/OUT> Board; restored before returning
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Heuristic score from corners, mobility and discs, well inside +/-SEARCH_WIN
+//--------------------------------------------------
+int evaluateBoard( GameBoard * board );
+
+//--------------------------------------------------
+// searchPosition
+// PURPOSE: Alpha-beta (negamax) search of a position
+// INPUT PARAMETERS:
+//   [search]<IN/OUT> Search state and statistics
+//   [board]<IN/OUT> Board; restored before returning
+//   [depth]<IN> Remaining depth in plies
+//   [alpha]<IN> Lower bound of the window
+//   [beta]<IN> Upper bound of the window
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Score for the current player, exact inside the window
+// REMARKS: A player without moves passes; when neither can move the game is scored
+//   with finalScore().
+//--------------------------------------------------
+int searchPosition( SearchContext * search, GameBoard * board, int depth, int alpha, int beta );
+
+//--------------------------------------------------
+// searchBestMove
+// PURPOSE: Search every move of the current player and pick the best
+// INPUT PARAMETERS:
+//   [search]<IN/OUT> Search state and statistics
+//   [board]<IN/OUT> Board; restored before returning
+//   [depth]<IN> Depth in plies, at least 1
+//   [best]<OUT> Best move (row -1 when the player must pass), its score and depth
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Score of the position for the current player
+//--------------------------------------------------
+int searchBestMove( SearchContext * search, GameBoard * board, int depth, BoardMove * best );
+
+//--------------------------------------------------
+// orderMoves
+// PURPOSE: Sort the moves of a node, the likeliest to cut off first: the table
+//   move, then the killers of the depth, then by history score less the replies
+//   each leaves to the opponent
+// INPUT PARAMETERS:
+//   [search]<IN> Search, with its history and killers
+//   [board]<IN/OUT> Board; restored before returning
+//   [cells]<IN/OUT> Moves, as row * MAX_BOARD_COLUMNS + col
+//   [nMoves]<IN> Number of moves
+//   [hintMove]<IN> Table move, -1 for none
+//   [depth]<IN> Depth left; mobility counts from ORDER_MOBILITY_DEPTH
+// REMARKS: Equal moves keep their order, row-major from generateMoves().
+//--------------------------------------------------
+void orderMoves( SearchContext * search, GameBoard * board, int * cells, int nMoves, int hintMove, int depth );
+
+//--------------------------------------------------
+// recordCutoff
+// PURPOSE: Count a cutoff and credit its move in the history and killer tables
+// INPUT PARAMETERS:
+//   [search]<IN/OUT> Search
+//   [cell]<IN> Move which cut off
+//   [depth]<IN> Depth left at the node
+//   [index]<IN> Position of the move in the node's order
+//--------------------------------------------------
+void recordCutoff( SearchContext * search, int cell, int depth, int index );
+
+//--------------------------------------------------
+// ageMoveOrdering
+// PURPOSE: Halve the history scores and forget the killers between the iterations
+//   of a search, so the ordering follows the deeper iteration
+// INPUT PARAMETERS:
+//   [search]<IN/OUT> Search
+//--------------------------------------------------
+void ageMoveOrdering( SearchContext * search );
+
+//--------------------------------------------------
+// clearMoveOrdering
+// PURPOSE: Forget the history scores and the killers before a new root search,
+//   so its result does not depend on the positions searched before
+// INPUT PARAMETERS:
+//   [search]<IN/OUT> Search
+//--------------------------------------------------
+void clearMoveOrdering( SearchContext * search );
+
+//--------------------------------------------------
+// searchRoot
+// PURPOSE: Search every move of the current player within a window and pick the best
+// INPUT PARAMETERS:
+//   [search]<IN/OUT> Search state and statistics
+//   [board]<IN/OUT> Board; restored before returning
+//   [depth]<IN> Depth in plies, at least 1
+//   [alpha]<IN> Score the result must beat to be exact
+//   [beta]<IN> Score at which the search stops as good enough
+//   [best]<OUT> Best move, its score and depth, as searchBestMove(); only
+//     meaningful when the score is inside the window
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Score of the position: exact inside the window, otherwise a bound
+//     beyond it
+// REMARKS: Moves after the first are searched with a null window and again only
+//   when they beat it, unless search->plain is set.
+//--------------------------------------------------
+int searchRoot( SearchContext * search, GameBoard * board, int depth, int alpha, int beta, BoardMove * best );
+
+//--------------------------------------------------
+// searchAspiration
+// PURPOSE: Search the root within a narrow window around an expected score,
+//   widening it on each side the score falls out of
+// INPUT PARAMETERS:
+//   [search]<IN/OUT> Search state and statistics
+//   [board]<IN/OUT> Board; restored before returning
+//   [depth]<IN> Depth in plies, at least 1
+//   [guess]<IN> Expected score, as from an earlier iteration
+//   [best]<OUT> Best move, its score and depth, as searchBestMove()
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Exact score of the position, as searchBestMove()
+// REMARKS: The window starts ASPIRATION_WINDOW either side of the guess and
+//   doubles its width past each failed side.
+//--------------------------------------------------
+int searchAspiration( SearchContext * search, GameBoard * board, int depth, int guess, BoardMove * best );
+
+//--------------------------------------------------
+// createTranspositionTable
+// PURPOSE: Give a search context a transposition table
+// INPUT PARAMETERS:
+//   [search]<IN/OUT> Search context
+//   [nEntries]<IN> Requested entries, rounded down to a power of two; 0 for none
+//--------------------------------------------------
+void createTranspositionTable( SearchContext * search, uint64_t nEntries );
+
+//--------------------------------------------------
+// clearTranspositionTable
+// PURPOSE: Forget every entry of a search context's transposition table
+// INPUT PARAMETERS:
+//   [search]<IN/OUT> Search context
+// REMARKS: The entries are only wiped when the generation wraps around, so a
+//   clear per position costs nothing.
+//--------------------------------------------------
+void clearTranspositionTable( SearchContext * search );
+
+//--------------------------------------------------
+// freeTranspositionTable
+// PURPOSE: Release a search context's transposition table
+// INPUT PARAMETERS:
+//   [search]<IN/OUT> Search context
+//--------------------------------------------------
+void freeTranspositionTable( SearchContext * search );
+
+//--------------------------------------------------
+// storeTransposition
+// PURPOSE: Record the result of a node in the transposition table, if there is one
+// INPUT PARAMETERS:
+//   [search]<IN/OUT> Search context
+//   [key]<IN> hashGameBoard() of the node
+//   [depth]<IN> Depth searched
+//   [score]<IN> Score found
+//   [bound]<IN> How the score relates to the true value
+//   [move]<IN> Best or refuting cell, -1 if none
+//--------------------------------------------------
+void storeTransposition( SearchContext * search, uint64_t key, int depth, int score, ScoreBound bound, int move );
+
+//--------------------------------------------------
+// pollSearch
+// PURPOSE: Stop a search at its deadline or on request, and print its progress
+//   when due. Support function for searchPosition()
+// INPUT PARAMETERS:
+//   [search]<IN/OUT> Search
+//--------------------------------------------------
+void pollSearch( SearchContext * search );
+
+//--------------------------------------------------
+// startInfo
+// PURPOSE: Start the progress reports of an analysis
+// INPUT PARAMETERS:
+//   [info]<OUT> Progress reports
+//   [output]<IN> Stream to print them to
+//   [interval]<IN> Seconds between progress lines within an iteration; 0 for none
+//   [search]<IN> Search whose nodes are counted from now on
+//--------------------------------------------------
+void startInfo( InfoSink * info, FILE * output, double interval, const SearchContext * search );
+
+//--------------------------------------------------
+// printSearchInfo
+// PURPOSE: Print the result of a finished search iteration as
+//   "info depth D score S time MS nodes N nps N pv CELL..."
+// INPUT PARAMETERS:
+//   [search]<IN/OUT> Search, with its progress reports set
+//   [board]<IN/OUT> Position searched; restored before returning
+//   [best]<IN> Result of the iteration
+//--------------------------------------------------
+void printSearchInfo( SearchContext * search, GameBoard * board, const BoardMove * best );
+
+//--------------------------------------------------
+// searchIterative
+// PURPOSE: Search the best move by iterative deepening
+// INPUT PARAMETERS:
+//   [search]<IN/OUT> Search state; its transposition table carries the move ordering
+//     from one depth to the next
+//   [board]<IN/OUT> Board; restored before returning
+//   [depth]<IN> Final depth in plies, at least 1
+//   [best]<OUT> Best move, its score and depth, as searchBestMove()
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Score of the position for the current player
+// REMARKS: When the search deadline passes, the result of the last complete
+//   iteration is returned; the move may be -1 if not even depth 1 completed.
+//--------------------------------------------------
+int searchIterative( SearchContext * search, GameBoard * board, int depth, BoardMove * best );
+
+//--------------------------------------------------
+// principalVariation
+// PURPOSE: Follow the best moves stored in the transposition table
+// INPUT PARAMETERS:
+//   [search]<IN> Search context
+//   [board]<IN/OUT> Board to start from; restored before returning
+//   [moves]<OUT> Cells of the variation, -1 for a pass
+//   [maxMoves]<IN> Room in [moves]
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Length of the variation
+//--------------------------------------------------
+int principalVariation( const SearchContext * search, GameBoard * board, int * moves, int maxMoves );
+
+//--------------------------------------------------
+// runBookBuilder
+// PURPOSE: Grow an opening book from the standard 8x8 start by drop-out expansion
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the book was written; otherwise, false
+// REMARKS: Each round expands the leaves which lose least against best play along
+//   their line from the start, evaluates the new leaves by alpha-beta search on the
+//   worker pool, backs the values up by minimax and appends what changed to the
+//   journal <book>.journal; the book itself is rewritten at the end. An existing book,
+//   and the journal of an interrupted run, are read back first, so runs can be
+//   repeated to grow it or to resume.
+//--------------------------------------------------
+boolean runBookBuilder( const Options * options );
+
+//--------------------------------------------------
+// addBookNode
+// PURPOSE: Find or create the tree node of a position. Support function for runBookBuilder()
+// INPUT PARAMETERS:
+//   [build]<IN/OUT> Book tree
+//   [board]<IN> Position
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Node index
+//--------------------------------------------------
+int addBookNode( BookBuildContext * build, const GameBoard * board );
+
+//--------------------------------------------------
+// addBookChild
+// PURPOSE: Link a node to the next child of an expanded node. Support function for runBookBuilder()
+// INPUT PARAMETERS:
+//   [build]<IN/OUT> Book tree
+//   [parent]<IN> Node being expanded; its children must be added one after another
+//   [child]<IN> Child node
+//   [cell]<IN> Move from the parent to the child, -1 for a pass
+//--------------------------------------------------
+void addBookChild( BookBuildContext * build, int parent, int child, int cell );
+
+//--------------------------------------------------
+// markBookNode
+// PURPOSE: Note that a node changed this round. Support function for runBookBuilder()
+// INPUT PARAMETERS:
+//   [build]<IN/OUT> Book tree
+//   [node]<IN> Node
+//--------------------------------------------------
+void markBookNode( BookBuildContext * build, int node );
+
+//--------------------------------------------------
+// evaluateBookLeafJob
+// PURPOSE: Worker pool job searching one new leaf of the book tree
+// INPUT PARAMETERS:
+//   [context]<IN> BookBuildContext
+//   [index]<IN> Index in the leaf list
+//   [thread]<IN> Worker number (unused)
+//--------------------------------------------------
+void evaluateBookLeafJob( void * context, int index, int thread );
+
+//--------------------------------------------------
+// backUpBookNodes
+// PURPOSE: Recompute the minimax values above some expanded nodes. Support function for runBookBuilder()
+// INPUT PARAMETERS:
+//   [build]<IN/OUT> Book tree; every node whose value or best move changes is marked
+//   [seeds]<IN> Nodes to start from
+//   [nSeeds]<IN> Number of seeds
+// REMARKS: A node whose value changes passes the update on to its parents, so the
+//   work is bounded by what actually changed.
+//--------------------------------------------------
+void backUpBookNodes( BookBuildContext * build, const int * seeds, int nSeeds );
+
+//--------------------------------------------------
+// updateBookDropouts
+// PURPOSE: Recompute the drop-outs below nodes whose value changed. Support function for runBookBuilder()
+// INPUT PARAMETERS:
+//   [build]<IN/OUT> Book tree; leaves with a new drop-out are pushed on the leaf heap
+//   [seeds]<IN> Nodes whose value changed, or new nodes
+//   [nSeeds]<IN> Number of seeds
+// REMARKS: The drop-out of a node is the smallest sum of losses against best play
+//   on a line from the start to it. Nodes are updated by increasing number of discs,
+//   so every parent is final before its children are looked at.
+//--------------------------------------------------
+void updateBookDropouts( BookBuildContext * build, const int * seeds, int nSeeds );
+
+//--------------------------------------------------
+// pushBookDropout
+// PURPOSE: Queue a node for updateBookDropouts()
+// INPUT PARAMETERS:
+//   [build]<IN/OUT> Book tree
+//   [heads]<IN/OUT> Queue heads by number of discs
+//   [node]<IN> Node
+//--------------------------------------------------
+void pushBookDropout( BookBuildContext * build, int * heads, int node );
+
+//--------------------------------------------------
+// pushBookLeaf
+// PURPOSE: Push a leaf with its current drop-out on the heap of leaves to expand
+// INPUT PARAMETERS:
+//   [build]<IN/OUT> Book tree
+//   [node]<IN> Leaf
+//--------------------------------------------------
+void pushBookLeaf( BookBuildContext * build, int node );
+
+//--------------------------------------------------
+// popBookLeaf
+// PURPOSE: Pop the unexpanded leaf with the smallest drop-out
+// INPUT PARAMETERS:
+//   [build]<IN/OUT> Book tree
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Leaf, or -1 when there is none left
+//--------------------------------------------------
+int popBookLeaf( BookBuildContext * build );
+
+//--------------------------------------------------
+// makeBookRecord
+// PURPOSE: Convert a book tree node into its book record
+// INPUT PARAMETERS:
+//   [node]<IN> Node
+//   [record]<OUT> Record, keyed and oriented on the canonical image
+//--------------------------------------------------
+void makeBookRecord( const BookNode * node, BookRecord * record );
+
+//--------------------------------------------------
+// mergeBookJournal
+// PURPOSE: Fold the journal of an interrupted runBookBuilder() into its book
+// INPUT PARAMETERS:
+//   [path]<IN> Book file; the journal is <path>.journal
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if there was no journal or it was merged; otherwise, false
+// REMARKS: Journal records are later than the book's, so they replace them. A torn
+//   last record is dropped.
+//--------------------------------------------------
+boolean mergeBookJournal( const char * path );
+
+//--------------------------------------------------
+// openTablebase
+// PURPOSE: Map a tablebase file read-only
+// INPUT PARAMETERS:
+//   [path]<IN> Tablebase file
+// OUTPUT PARAMETERS:
+//   [Tablebase*]<OUT> Tablebase; NULL if the file is missing or invalid
+//--------------------------------------------------
+Tablebase * openTablebase( const char * path );
+
+//--------------------------------------------------
+// closeTablebase
+// PURPOSE: Report the lookup statistics and unmap a tablebase
+// INPUT PARAMETERS:
+//   [tablebase]<IN> Tablebase; may be NULL
+//--------------------------------------------------
+void closeTablebase( Tablebase * tablebase );
+
+//--------------------------------------------------
+// findTablebaseSlot
+// PURPOSE: Find the slot of a key, or the empty slot where it belongs
+// INPUT PARAMETERS:
+//   [records]<IN> Table
+//   [capacity]<IN> Number of slots, a power of two
+//   [key]<IN> Key to find
+// OUTPUT PARAMETERS:
+//   [TablebaseRecord*]<OUT> Slot
+//--------------------------------------------------
+TablebaseRecord * findTablebaseSlot( const TablebaseRecord * records, uint64_t capacity, uint64_t key );
+
+//--------------------------------------------------
+// lookupTablebase
+// PURPOSE: Find the perfect-play result of a position
+// INPUT PARAMETERS:
+//   [tablebase]<IN/OUT> Tablebase; lookup counters are updated
+//   [board]<IN> Position
+//   [transform]<OUT> Transform of the canonical image, to map the move back
+// OUTPUT PARAMETERS:
+//   [const TablebaseRecord*]<OUT> Record; NULL if the board size differs or the position
+//     is not reachable from the standard start
+//--------------------------------------------------
+const TablebaseRecord * lookupTablebase( Tablebase * tablebase, const GameBoard * board, int * transform );
+
+//--------------------------------------------------
+// solveTablebasePosition
+// PURPOSE: Solve a position and every position reachable from it. Support function for makeTablebase()
+// INPUT PARAMETERS:
+//   [solver]<IN/OUT> Positions solved so far
+//   [board]<IN/OUT> Position; restored before returning
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Final disc difference for the side to move under perfect play
+//--------------------------------------------------
+int solveTablebasePosition( TablebaseSolver * solver, GameBoard * board );
+
+//--------------------------------------------------
+// makeTablebase
+// PURPOSE: Solve every position reachable from the standard start of a small board
+//   and write them as a tablebase
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the tablebase was written; otherwise, false
+//--------------------------------------------------
+boolean makeTablebase( const Options * options );
+
+//--------------------------------------------------
+// nextRandom
+// PURPOSE: Draw from a counter-based generator; each caller owns its state
+// INPUT PARAMETERS:
+//   [state]<IN/OUT> Generator state
+// OUTPUT PARAMETERS:
+//   [uint64_t]<OUT> Random value
+//--------------------------------------------------
+uint64_t nextRandom( uint64_t * state );
+
+//--------------------------------------------------
+// playSelfPlayGame
+// PURPOSE: Play a game to the end
+// INPUT PARAMETERS:
+//   [options]<IN> Random opening plies
+//   [engine]<IN/OUT> Engine playing both sides
+//   [board]<IN/OUT> Start position; the final position on return
+//   [random]<IN/OUT> Generator of this game
+//   [moves]<OUT> Cells played, -1 for a pass; room for MAX_GAME_MOVES
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Number of moves; -1 if the engine chose an illegal move, which ends the game
+//--------------------------------------------------
+int playSelfPlayGame( const Options * options, Engine * engine, GameBoard * board, uint64_t * random, int * moves );
+
+//--------------------------------------------------
+// selfPlayJob
+// PURPOSE: Worker pool job playing one chunk of self-play games
+// INPUT PARAMETERS:
+//   [context]<IN> SelfPlayContext
+//   [index]<IN> Chunk number
+//   [thread]<IN> Worker number (unused)
+//--------------------------------------------------
+void selfPlayJob( void * context, int index, int thread );
+
+//--------------------------------------------------
+// runSelfPlay
+// PURPOSE: Play games from the standard start or from the input boards and print the records
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if all games were played and written; otherwise, false
+// REMARKS: Games are dealt to the worker pool in chunks and each game draws from its
+//   own generator seeded from --seed and its number, so the records do not depend on
+//   the thread count. Games are appended to the --output game file, or printed as
+//   text by printGameRecord().
+//--------------------------------------------------
+boolean runSelfPlay( const Options * options );
+
+//--------------------------------------------------
+// isStandardStart
+// PURPOSE: Check if a board is the standard start of its size
+// INPUT PARAMETERS:
+//   [board]<IN> Board
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if it equals initStartBoard() of the same size; otherwise, false
+//--------------------------------------------------
+boolean isStandardStart( const GameBoard * board );
+
+//--------------------------------------------------
+// openGameFile
+// PURPOSE: Open a game file for appending, creating it when it is missing or empty
+// INPUT PARAMETERS:
+//   [path]<IN> Game file
+// OUTPUT PARAMETERS:
+//   [FILE*]<OUT> File positioned at its end; NULL on error or if it is not a game file
+//--------------------------------------------------
+FILE * openGameFile( const char * path );
+
+//--------------------------------------------------
+// readGameFileHeader
+// PURPOSE: Read and check the header of a game file
+// INPUT PARAMETERS:
+//   [input]<IN> File positioned at its start
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True for a game file of this version; otherwise, false
+//--------------------------------------------------
+boolean readGameFileHeader( FILE * input );
+
+//--------------------------------------------------
+// writeGameRecord
+// PURPOSE: Append a game to a game file
+// INPUT PARAMETERS:
+//   [output]<IN> Game file, or a buffer of records
+//   [game]<IN> Game
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the game was written; otherwise, false
+//--------------------------------------------------
+boolean writeGameRecord( FILE * output, const GameRecord * game );
+
+//--------------------------------------------------
+// readGameRecord
+// PURPOSE: Read the next game of a game file
+// INPUT PARAMETERS:
+//   [input]<IN> Game file, past the header
+//   [game]<OUT> Game; reused from call to call, nothing is allocated
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if a game was read; false at the end of the file or on a damaged record
+//--------------------------------------------------
+boolean readGameRecord( FILE * input, GameRecord * game );
+
+//--------------------------------------------------
+// replayGame
+// PURPOSE: Play the moves of a game from its start with playMove()
+// INPUT PARAMETERS:
+//   [game]<IN> Game
+//   [board]<OUT> Final position, or the position before the first illegal move
+//   [visit]<IN> Called with each position before its move; may be NULL
+//   [context]<IN> Passed to [visit]
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Number of moves replayed; less than game->nMoves if a move is illegal
+//--------------------------------------------------
+int replayGame( const GameRecord * game, GameBoard * board, GameVisitor visit, void * context );
+
+//--------------------------------------------------
+// printGameRecord
+// PURPOSE: Print a game as one line of text:
+//     <game> <BLACK minus WHITE discs> <move>...
+//   where a move is a cell name such as d3, or -- for a pass. A game which does
+//   not begin at the standard start is preceded by its start position.
+// INPUT PARAMETERS:
+//   [output]<IN> Output file
+//   [number]<IN> Game number
+//   [game]<IN> Game
+//--------------------------------------------------
+void printGameRecord( FILE * output, long number, const GameRecord * game );
+
+//--------------------------------------------------
+// runReplay
+// PURPOSE: Replay every game of the input game files and print them as text
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if every game replayed to its recorded result; otherwise, false
+//--------------------------------------------------
+boolean runReplay( const Options * options );
+
+//--------------------------------------------------
+// readMoveList
+// PURPOSE: Read a game from the standard 8x8 start given as a line of moves
+// INPUT PARAMETERS:
+//   [input]<IN> Text input
+//   [game]<OUT> Game
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if a game was read; false at the end of the input
+// REMARKS: Moves are cell names such as f5, separated by blanks or not, and -- for a
+//   pass. Other words are skipped, so the text of printGameRecord() reads back; lines
+//   without moves are skipped. A pass left out before a move of the opponent is put
+//   back in; otherwise the moves are not checked.
+//--------------------------------------------------
+boolean readMoveList( FILE * input, GameRecord * game );
+
+//--------------------------------------------------
+// annotateGameJob
+// PURPOSE: Worker pool job annotating one game of the current batch
+// INPUT PARAMETERS:
+//   [context]<IN> AnnotateContext
+//   [index]<IN> Game of the batch
+//   [thread]<IN> Worker number, selecting the search context
+//--------------------------------------------------
+void annotateGameJob( void * context, int index, int thread );
+
+//--------------------------------------------------
+// runAnnotate
+// PURPOSE: Replay the input games and print the best move at every ply
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if every game was read and replayed; otherwise, false
+// REMARKS: Inputs are binary game files or text move lists (see readMoveList()).
+//   Each game is replayed move by move with one search context, searching each
+//   position by iterative deepening to --depth. The transposition table is kept
+//   from ply to ply, so the principal variation of the previous ply orders the
+//   moves of the next one and its subtrees are not searched again. The table is
+//   cleared between games, so the results do not depend on the thread count.
+//   One line per ply:
+//     <game>.<ply> <player> <move played>: best <move>, score <score> at depth <depth>, pv <moves>
+//--------------------------------------------------
+boolean runAnnotate( const Options * options );
+
+//--------------------------------------------------
+// openWthorFile
+// PURPOSE: Open a WTHOR file and read its header
+// INPUT PARAMETERS:
+//   [path]<IN> WTHOR file
+//   [file]<OUT> Open file
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True for a readable 8x8 WTHOR file; otherwise, false
+//--------------------------------------------------
+boolean openWthorFile( const char * path, WthorFile * file );
+
+//--------------------------------------------------
+// decodeWthorGame
+// PURPOSE: Turn a WTHOR game record into a game, putting back the passes
+// INPUT PARAMETERS:
+//   [record]<IN> WTHOR_GAME_SIZE bytes
+//   [game]<OUT> Game from the standard 8x8 start
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if every move is legal; otherwise, false
+//--------------------------------------------------
+boolean decodeWthorGame( const unsigned char * record, GameRecord * game );
+
+//--------------------------------------------------
+// importWthorJob
+// PURPOSE: Worker pool job decoding one chunk of WTHOR games
+// INPUT PARAMETERS:
+//   [context]<IN> WthorContext
+//   [index]<IN> Job number
+//   [thread]<IN> Worker number (unused)
+//--------------------------------------------------
+void importWthorJob( void * context, int index, int thread );
+
+//--------------------------------------------------
+// runImportWthor
+// PURPOSE: Convert the games of WTHOR files to a game file or to boards for analysis
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if every file was read and written; otherwise, false
+// REMARKS: The files are cut into chunks of --chunk-size games which are decoded
+//   in parallel, read with pread() and written in order as they complete, so no
+//   file is ever held in memory. With --output FILE the games are appended to a
+//   game file; otherwise every position before a move is written to standard
+//   output in the input format of the batch analysis, ready to be piped into it.
+//--------------------------------------------------
+boolean runImportWthor( const Options * options );
+
+//--------------------------------------------------
+// writeNpyHeader
+// PURPOSE: Write the NumPy header of a dataset file
+// INPUT PARAMETERS:
+//   [output]<IN> Dataset file, positioned at its start
+//   [nRecords]<IN> Number of records
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the header was written; otherwise, false
+//--------------------------------------------------
+boolean writeNpyHeader( FILE * output, uint64_t nRecords );
+
+//--------------------------------------------------
+// labelDatasetJob
+// PURPOSE: Worker pool job searching the score and best move of a chunk of dataset records
+// INPUT PARAMETERS:
+//   [context]<IN> DatasetContext
+//   [index]<IN> Chunk number
+//   [thread]<IN> Worker number (unused)
+//--------------------------------------------------
+void labelDatasetJob( void * context, int index, int thread );
+
+//--------------------------------------------------
+// runExportDataset
+// PURPOSE: Export the positions of the input games as a training dataset
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the dataset was written; otherwise, false
+// REMARKS: Inputs are game files, such as those of --self-play or --import-wthor;
+//   only 8x8 games are exported. Every position before a move is taken once, the
+//   first time its hash is seen, with the game result as label. Batches of
+//   positions are then searched to --depth on the worker pool (--depth 0 skips
+//   the search) and appended to the file, so memory does not grow with the input.
+//--------------------------------------------------
+boolean runExportDataset( const Options * options );
+
+//--------------------------------------------------
+// buildPatternSet
+// PURPOSE: Lay out the evaluation patterns: rows, diagonals and corner regions, each
+//   with its distinct symmetric images sharing the same weights
+// INPUT PARAMETERS:
+//   [patterns]<OUT> Pattern set
+//--------------------------------------------------
+void buildPatternSet( PatternSet * patterns );
+
+//--------------------------------------------------
+// patternPhase
+// PURPOSE: Find the weight phase of a position
+// INPUT PARAMETERS:
+//   [empties]<IN> Empty cells of the 8x8 board
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Phase, 0 to WEIGHT_PHASES - 1
+//--------------------------------------------------
+int patternPhase( int empties );
+
+//--------------------------------------------------
+// computePatternIndices
+// PURPOSE: Find the weight of every pattern instance of a position
+// INPUT PARAMETERS:
+//   [patterns]<IN> Pattern set
+//   [squares]<IN> 64 cells, row-major: 0 empty, 1 side to move, 2 opponent
+//   [indices]<OUT> Weight index within the phase, one per instance
+//--------------------------------------------------
+void computePatternIndices( const PatternSet * patterns, const uint8_t * squares, int * indices );
+
+//--------------------------------------------------
+// loadPatternWeights
+// PURPOSE: Read a weight file written by the trainer
+// INPUT PARAMETERS:
+//   [path]<IN> Weight file
+// OUTPUT PARAMETERS:
+//   [PatternWeights*]<OUT> Weights; NULL if the file is missing or does not match the patterns
+//--------------------------------------------------
+PatternWeights * loadPatternWeights( const char * path );
+
+//--------------------------------------------------
+// freePatternWeights
+// PURPOSE: Release loaded weights
+// INPUT PARAMETERS:
+//   [weights]<IN> Weights; may be NULL
+//--------------------------------------------------
+void freePatternWeights( PatternWeights * weights );
+
+//--------------------------------------------------
+// evaluatePatterns
+// PURPOSE: Evaluate an 8x8 position with pattern weights
+// INPUT PARAMETERS:
+//   [weights]<IN> Weights
+//   [board]<IN> 8x8 board
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Score for the current player, well inside +/-SEARCH_WIN
+//--------------------------------------------------
+int evaluatePatterns( const PatternWeights * weights, const GameBoard * board );
+
+//--------------------------------------------------
+// mapDataset
+// PURPOSE: Map a dataset file written by runExportDataset() read-only
+// INPUT PARAMETERS:
+//   [path]<IN> Dataset file
+//   [dataset]<OUT> Mapped records
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True for a dataset of this layout; otherwise, false
+//--------------------------------------------------
+boolean mapDataset( const char * path, DatasetMap * dataset );
+
+//--------------------------------------------------
+// trainGradientJob
+// PURPOSE: Worker pool job adding the gradient of one chunk of records to the thread's buffer
+// INPUT PARAMETERS:
+//   [context]<IN> TrainContext
+//   [index]<IN> Chunk number
+//   [thread]<IN> Worker number, selecting the buffer
+//--------------------------------------------------
+void trainGradientJob( void * context, int index, int thread );
+
+//--------------------------------------------------
+// trainUpdateJob
+// PURPOSE: Worker pool job summing the thread buffers of one slice of the weights and
+//   stepping those weights
+// INPUT PARAMETERS:
+//   [context]<IN> TrainContext
+//   [index]<IN> Slice number
+//   [thread]<IN> Worker number (unused)
+//--------------------------------------------------
+void trainUpdateJob( void * context, int index, int thread );
+
+//--------------------------------------------------
+// runTrainer
+// PURPOSE: Fit pattern weights to the input datasets and write a weight file
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the weights were written; otherwise, false
+// REMARKS: Full-batch gradient descent of the squared error of the disc difference
+//   (or of the log loss of the win probability with --logistic). Each epoch the
+//   worker threads add the gradients of chunks of records to buffers of their own;
+//   the buffers are then summed slice by slice and each weight steps by its mean
+//   gradient, so rare configurations learn as fast as common ones.
+//--------------------------------------------------
+boolean runTrainer( const Options * options );
+
+//--------------------------------------------------
+// parseEngineSpec
+// PURPOSE: Read an engine configuration such as "search,depth=6,time=0.05,weights=FILE"
+// INPUT PARAMETERS:
+//   [text]<IN> Engine name (greedy, search, mcts or endgame) followed by comma
+//     separated settings: depth=D, time=SECONDS, playouts=N, empties=N, pvs=0|1, weights=FILE
+//   [spec]<OUT> Engine configuration; weights are loaded
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the configuration is valid; otherwise, false
+//--------------------------------------------------
+boolean parseEngineSpec( const char * text, EngineSpec * spec );
+
+//--------------------------------------------------
+// engineType
+// PURPOSE: Find the operations of a kind of engine
+// INPUT PARAMETERS:
+//   [kind]<IN> Kind of engine
+// OUTPUT PARAMETERS:
+//   [const EngineType *]<OUT> Operations
+//--------------------------------------------------
+const EngineType * engineType( EngineKind kind );
+
+//--------------------------------------------------
+// initEngine
+// PURPOSE: Set up an engine
+// INPUT PARAMETERS:
+//   [engine]<OUT> Engine; release it with freeEngine()
+//   [spec]<IN> Configuration; its weights stay owned by the caller
+//   [options]<IN> Run options, supplying what the configuration leaves unset
+//--------------------------------------------------
+void initEngine( Engine * engine, const EngineSpec * spec, const Options * options );
+
+//--------------------------------------------------
+// chooseEngineMove
+// PURPOSE: Let an engine pick the move of the current player
+// INPUT PARAMETERS:
+//   [engine]<IN/OUT> Engine
+//   [board]<IN/OUT> Board; restored before returning
+//   [best]<OUT> Chosen move, row -1 when there is no legal move; the score and
+//     depth are those of the engine, as the number of reverses for the greedy one
+//--------------------------------------------------
+void chooseEngineMove( Engine * engine, GameBoard * board, BoardMove * best );
+
+//--------------------------------------------------
+// allocateMoveTime
+// PURPOSE: Budget the time of a move from the clock of the side to move
+// INPUT PARAMETERS:
+//   [clock]<IN> Clock of the side to move
+//   [board]<IN> Position
+//   [soft]<OUT> Seconds after which the engine should answer; a search finishes
+//     its iteration first and takes longer while its best move changes
+//   [hard]<OUT> Seconds after which the engine must answer
+// REMARKS: The time left, less a safety margin, is shared among the moves left
+//   to the side, half the empty cells, plus TIME_RESERVE_MOVES; the increment
+//   comes on top. The hard limit is HARD_TIME_FACTOR soft limits, within half
+//   of the time left.
+//--------------------------------------------------
+void allocateMoveTime( const GameClock * clock, const GameBoard * board, double * soft, double * hard );
+
+//--------------------------------------------------
+// isMctsSettled
+// PURPOSE: Decide whether a clocked MCTS may stop: its soft limit is spent, or the
+//   playouts left until it cannot change the most visited move
+// INPUT PARAMETERS:
+//   [engine]<IN> MCTS engine, its search.softTime set
+//   [nPlayouts]<IN> Playouts of the move so far
+//   [elapsed]<IN> Seconds of the move so far
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True to stop; otherwise, false
+//--------------------------------------------------
+boolean isMctsSettled( const Engine * engine, long nPlayouts, double elapsed );
+
+//--------------------------------------------------
+// rankEngineMoves
+// PURPOSE: List every legal move with its reversed cells in one pass, scored by
+//   an engine and sorted best first
+// INPUT PARAMETERS:
+//   [engine]<IN/OUT> Engine
+//   [board]<IN/OUT> Board; restored before returning
+//   [ranking]<IN/OUT> Ranking; its flips buffer grows as needed, free it with
+//     free( ranking->flips )
+// REMARKS: Equal scores keep row-major order, so the greedy ranking starts with
+//   the greedy engine's choice. No move is played, so the engine's move count and
+//   time do not change.
+//--------------------------------------------------
+void rankEngineMoves( Engine * engine, GameBoard * board, MoveRanking * ranking );
+
+//--------------------------------------------------
+// compareRankedMoves
+// PURPOSE: qsort() order of ranked moves: higher orders first, then row-major
+//--------------------------------------------------
+int compareRankedMoves( const void * left, const void * right );
+
+//--------------------------------------------------
+// printMoveRanking
+// PURPOSE: Print the best moves of a ranking
+// INPUT PARAMETERS:
+//   [output]<IN> Stream to print to
+//   [ranking]<IN> Ranking
+//   [count]<IN> Most moves to print
+//   [scored]<IN> Print the engine scores besides the reverses
+//--------------------------------------------------
+void printMoveRanking( FILE * output, const MoveRanking * ranking, int count, boolean scored );
+
+//--------------------------------------------------
+// resetEngine
+// PURPOSE: Make an engine forget earlier positions, as at the start of a game
+// INPUT PARAMETERS:
+//   [engine]<IN/OUT> Engine
+//--------------------------------------------------
+void resetEngine( Engine * engine );
+
+//--------------------------------------------------
+// mergeEngineStats
+// PURPOSE: Add the totals of an engine to those of another of the same configuration
+// INPUT PARAMETERS:
+//   [total]<IN/OUT> Engine collecting the totals
+//   [engine]<IN> Engine to add
+//--------------------------------------------------
+void mergeEngineStats( Engine * total, const Engine * engine );
+
+//--------------------------------------------------
+// printEngineStats
+// PURPOSE: Print the totals of an engine
+// INPUT PARAMETERS:
+//   [engine]<IN> Engine
+//   [output]<IN> Stream to print to
+//--------------------------------------------------
+void printEngineStats( const Engine * engine, FILE * output );
+
+//--------------------------------------------------
+// freeEngine
+// PURPOSE: Free the state of an engine set up by initEngine()
+// INPUT PARAMETERS:
+//   [engine]<IN/OUT> Engine; may never have been set up
+//--------------------------------------------------
+void freeEngine( Engine * engine );
+
+//--------------------------------------------------
+// acquireEngine
+// PURPOSE: Check an engine out of the pool of a run, creating it if every engine
+//   of the configuration is in use
+// INPUT PARAMETERS:
+//   [analysis]<IN/OUT> Resources of the run
+//   [text]<IN> Configuration as for parseEngineSpec(); empty for the run's engine
+// OUTPUT PARAMETERS:
+//   [Engine *]<OUT> Engine, to hand back with releaseEngine(); NULL if the configuration is invalid
+//--------------------------------------------------
+Engine * acquireEngine( AnalysisContext * analysis, const char * text );
+
+//--------------------------------------------------
+// releaseEngine
+// PURPOSE: Hand an engine back to the pool of a run
+// INPUT PARAMETERS:
+//   [analysis]<IN/OUT> Resources of the run
+//   [engine]<IN> Engine from acquireEngine()
+//--------------------------------------------------
+void releaseEngine( AnalysisContext * analysis, Engine * engine );
+
+//--------------------------------------------------
+// chooseGreedyMove
+// PURPOSE: EngineType choose operation: the move reversing the most pieces
+//--------------------------------------------------
+void chooseGreedyMove( Engine * engine, GameBoard * board, BoardMove * best );
+
+//--------------------------------------------------
+// printGreedyStats
+// PURPOSE: EngineType stats operation of the greedy engine
+//--------------------------------------------------
+void printGreedyStats( const Engine * engine, FILE * output );
+
+//--------------------------------------------------
+// initSearchEngine
+// PURPOSE: EngineType init operation of the search and endgame engines: create
+//   the transposition table
+//--------------------------------------------------
+void initSearchEngine( Engine * engine );
+
+//--------------------------------------------------
+// chooseSearchMove
+// PURPOSE: EngineType choose operation: iterative deepening to the engine's depth
+//   or until its time per move runs out
+//--------------------------------------------------
+void chooseSearchMove( Engine * engine, GameBoard * board, BoardMove * best );
+
+//--------------------------------------------------
+// chooseEndgameMove
+// PURPOSE: EngineType choose operation: solve exactly from spec.endgameEmpties
+//   empty cells, the score being the final disc difference; search before
+// REMARKS: Under a time per move or a clock, the solve stops at the hard limit
+//   and the move of a search given half the time is played instead.
+//--------------------------------------------------
+void chooseEndgameMove( Engine * engine, GameBoard * board, BoardMove * best );
+
+//--------------------------------------------------
+// rankSearchMoves
+// PURPOSE: EngineType rank operation of the search and endgame engines: a full
+//   window search of every move, exact for the endgame engine near the end
+// REMARKS: Otherwise every move is searched one ply deeper per iteration up to the
+//   engine's depth, keeping the scores of the last iteration finished within the
+//   time per move.
+//--------------------------------------------------
+void rankSearchMoves( Engine * engine, GameBoard * board, MoveRanking * ranking );
+
+//--------------------------------------------------
+// printSearchStats
+// PURPOSE: EngineType stats operation of the search and endgame engines
+//--------------------------------------------------
+void printSearchStats( const Engine * engine, FILE * output );
+
+//--------------------------------------------------
+// resetSearchEngine
+// PURPOSE: EngineType reset operation: clear the transposition table
+//--------------------------------------------------
+void resetSearchEngine( Engine * engine );
+
+//--------------------------------------------------
+// releaseSearchEngine
+// PURPOSE: EngineType release operation: free the transposition table
+//--------------------------------------------------
+void releaseSearchEngine( Engine * engine );
+
+//--------------------------------------------------
+// chooseMctsMove
+// PURPOSE: EngineType choose operation: UCB1 tree search over random playouts,
+//   playing the most visited move; the score is its winning percentage and the
+//   depth that of the deepest selection
+// REMARKS: Playouts are seeded from the position, so results do not depend on
+//   the thread or on earlier positions.
+//--------------------------------------------------
+void chooseMctsMove( Engine * engine, GameBoard * board, BoardMove * best );
+
+//--------------------------------------------------
+// rankMctsMoves
+// PURPOSE: EngineType rank operation of the MCTS engine: the winning percentage
+//   of every move after the playouts of one chooseMctsMove(), most visited first
+// REMARKS: A tree just chosen from at the position is ranked as it is, so the
+//   ranking starts with the move chosen.
+//--------------------------------------------------
+void rankMctsMoves( Engine * engine, GameBoard * board, MoveRanking * ranking );
+
+//--------------------------------------------------
+// ponderSearch
+// PURPOSE: EngineType ponder operation of the search and endgame engines: search
+//   to the engine's depth without a time limit, filling the transposition table
+//--------------------------------------------------
+void ponderSearch( Engine * engine, GameBoard * board, BoardMove * best );
+
+//--------------------------------------------------
+// ponderMcts
+// PURPOSE: EngineType ponder operation of the MCTS engine: add playouts below the
+//   position, covering every reply; the tree is kept for chooseMctsMove()
+//--------------------------------------------------
+void ponderMcts( Engine * engine, GameBoard * board, BoardMove * best );
+
+//--------------------------------------------------
+// rootMctsTree
+// PURPOSE: Make a position the root of the MCTS tree, keeping the tree if it is
+//   rooted there already
+// INPUT PARAMETERS:
+//   [engine]<IN/OUT> MCTS engine
+//   [board]<IN/OUT> Position; restored before returning
+//--------------------------------------------------
+void rootMctsTree( Engine * engine, GameBoard * board );
+
+//--------------------------------------------------
+// runMctsPlayouts
+// PURPOSE: Grow the MCTS tree of a position by playouts
+// INPUT PARAMETERS:
+//   [engine]<IN/OUT> MCTS engine, its tree rooted at [board]
+//   [board]<IN> Position of the root
+//   [limit]<IN> Most playouts; -1 for no limit
+//   [deadline]<IN> currentSeconds() at which to stop; 0 for no limit
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Depth of the deepest selection
+// REMARKS: Stops early when search.stopRequest is set.
+//--------------------------------------------------
+int runMctsPlayouts( Engine * engine, const GameBoard * board, long limit, double deadline );
+
+//--------------------------------------------------
+// printMctsInfo
+// PURPOSE: Print the state of an MCTS as "info depth D score S time MS playouts N pv CELL...",
+//   the score being the winning percentage of the most visited move
+// INPUT PARAMETERS:
+//   [engine]<IN/OUT> MCTS engine, with its progress reports set
+//   [board]<IN> Position of the root
+//   [depth]<IN> Deepest selection so far
+//--------------------------------------------------
+void printMctsInfo( Engine * engine, const GameBoard * board, int depth );
+
+//--------------------------------------------------
+// advanceMctsTree
+// PURPOSE: Move the root of the MCTS tree to the child reached by a move, keeping
+//   the subtree below it
+// INPUT PARAMETERS:
+//   [engine]<IN/OUT> MCTS engine
+//   [board]<IN> Position after the move
+//   [move]<IN> Cell played from the root, -1 for a pass
+//--------------------------------------------------
+void advanceMctsTree( Engine * engine, const GameBoard * board, int move );
+
+//--------------------------------------------------
+// resetMctsEngine
+// PURPOSE: EngineType reset operation of the MCTS engine: drop the tree
+//--------------------------------------------------
+void resetMctsEngine( Engine * engine );
+
+//--------------------------------------------------
+// printMctsStats
+// PURPOSE: EngineType stats operation of the MCTS engine
+//--------------------------------------------------
+void printMctsStats( const Engine * engine, FILE * output );
+
+//--------------------------------------------------
+// releaseMctsEngine
+// PURPOSE: EngineType release operation: free the tree
+//--------------------------------------------------
+void releaseMctsEngine( Engine * engine );
+
+//--------------------------------------------------
+// expandMctsNode
+// PURPOSE: Add the children of a tree node, one per legal move or a single pass
+// INPUT PARAMETERS:
+//   [engine]<IN/OUT> MCTS engine
+//   [node]<IN> Node to expand
+//   [board]<IN/OUT> Position of the node; restored before returning
+// REMARKS: Nodes below the root stay leaves once the tree holds MAX_MCTS_NODES.
+//--------------------------------------------------
+void expandMctsNode( Engine * engine, int node, GameBoard * board );
+
+//--------------------------------------------------
+// playRandomGame
+// PURPOSE: Finish a game with random moves
+// INPUT PARAMETERS:
+//   [board]<IN/OUT> Position; the final position on return
+//   [random]<IN/OUT> Generator
+//--------------------------------------------------
+void playRandomGame( GameBoard * board, uint64_t * random );
+
+//--------------------------------------------------
+// updateSprt
+// PURPOSE: Recompute the log-likelihood ratio of a match and decide when it crosses a bound
+// INPUT PARAMETERS:
+//   [match]<IN/OUT> Match, with its lock held
+//--------------------------------------------------
+void updateSprt( MatchContext * match );
+
+//--------------------------------------------------
+// matchPairJob
+// PURPOSE: Worker pool job playing one opening twice, with the colours swapped
+// INPUT PARAMETERS:
+//   [context]<IN> MatchContext
+//   [index]<IN> Pair number
+//   [thread]<IN> Worker number, selecting the search contexts
+//--------------------------------------------------
+void matchPairJob( void * context, int index, int thread );
+
+//--------------------------------------------------
+// runMatch
+// PURPOSE: Play two engines against each other until the SPRT decides or the games run out
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the match was played; otherwise, false
+// REMARKS: Openings are the move lists of the inputs, the first --random-plies moves
+//   of the games of game file inputs or, without inputs, --random-plies random moves
+//   from --seed. Each opening is played twice,
+//   each engine having BLACK once. The SPRT tests the Elo advantage of the first
+//   engine, --sprt ELO0 against ELO1, with error rates SPRT_ALPHA and SPRT_BETA.
+//--------------------------------------------------
+boolean runMatch( const Options * options );
+
+//--------------------------------------------------
+// startPonder
+// PURPOSE: Start thinking, in a thread of its own, about the position the opponent
+//   faces after the engine's move
+// INPUT PARAMETERS:
+//   [ponder]<OUT> Ponder state
+//   [engine]<IN/OUT> Engine; not to be used until stopPonder()
+//   [board]<IN> Position after the engine's move
+//--------------------------------------------------
+void startPonder( PonderContext * ponder, Engine * engine, const GameBoard * board );
+
+//--------------------------------------------------
+// stopPonder
+// PURPOSE: Stop a ponder and wait for its thread
+// INPUT PARAMETERS:
+//   [ponder]<IN/OUT> Ponder state; nothing happens if it is not running
+//--------------------------------------------------
+void stopPonder( PonderContext * ponder );
+
+//--------------------------------------------------
+// ponderThread
+// PURPOSE: Thread body running the engine's ponder operation. Support function for startPonder()
+// INPUT PARAMETERS:
+//   [argument]<IN> PonderContext
+// OUTPUT PARAMETERS:
+//   [void *]<OUT> Always NULL
+//--------------------------------------------------
+void * ponderThread( void * argument );
+
+//--------------------------------------------------
+// runPlay
+// PURPOSE: Play a game through commands on standard input
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True unless the input ended in error
+// REMARKS: Commands, one per line: "new" starts over from the 8x8 start, "move CELL"
+//   and "pass" play the opponent's move, "go" plays the engine's move and prints it as
+//   "move CELL" or "pass", "board" prints the position and "quit" ends the session.
+//   "analyze" thinks about the position in the background, streaming "info" lines
+//   (see printSearchInfo()) until the engine's budget is spent or another command
+//   such as "stop" arrives, then prints "best CELL". Other replies are "ok" and
+//   "error <reason>". Every line of the analysis and every reply is written under
+//   the lock of stdout, so they never interleave. With --ponder, the search engines search the predicted reply
+//   after each of their moves and answer at once when it is played; MCTS keeps
+//   growing its tree below every reply.
+//--------------------------------------------------
+boolean runPlay( const Options * options );
+
+//--------------------------------------------------
+// parseNboardMove
+// PURPOSE: Read a move as NBoard and GGF write it: a column letter and a row
+//   number, as in "F5", or "PA" for a pass; an evaluation may follow
+// INPUT PARAMETERS:
+//   [text]<IN> Move text
+//   [cell]<OUT> row * MAX_BOARD_COLUMNS + col, -1 for a pass
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the text is a move; otherwise, false
+//--------------------------------------------------
+boolean parseNboardMove( const char * text, int * cell );
+
+//--------------------------------------------------
+// playNboardMove
+// PURPOSE: Play a move of the side to move if it is legal
+// INPUT PARAMETERS:
+//   [board]<IN/OUT> Board
+//   [cell]<IN> As from parseNboardMove(); a pass is legal only without moves
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the move was played; otherwise, false
+//--------------------------------------------------
+boolean playNboardMove( GameBoard * board, int cell );
+
+//--------------------------------------------------
+// parseGgfGame
+// PURPOSE: Set up the position at the end of a game in GGF, as NBoard sends it in
+//   "set game (;GM[Othello]...BO[8 ---...O*--- *]B[F5//0.00]W[F6];)"
+// INPUT PARAMETERS:
+//   [text]<IN> GGF game
+//   [board]<OUT> Position after the last move
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the game has a square start position and legal moves;
+//     otherwise, false
+// REMARKS: Tags other than BO, B and W are skipped. A move of the side not to
+//   move stands for a pass the record leaves out.
+//--------------------------------------------------
+boolean parseGgfGame( const char * text, GameBoard * board );
+
+//--------------------------------------------------
+// runNboard
+// PURPOSE: Serve an NBoard GUI or tournament manager on standard input and output
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True unless the input ended in error
+// REMARKS: Handles "nboard", "set game", "set depth", "move", "go" (answered by
+//   "=== MOVE/EVAL/SECONDS"), "hint N" (answered by one "search MOVE EVAL 0 DEPTH"
+//   line per best move), "ping N", "learn" and "quit"; other commands are
+//   reported on standard error. Evaluations are the engine's scores. One engine
+//   serves the whole session, so its transposition table or MCTS tree stays warm
+//   from move to move.
+//--------------------------------------------------
+boolean runNboard( const Options * options );
+
+//--------------------------------------------------
+// engineConfigId
+// PURPOSE: Compute the identifier of an engine configuration stored in cache records
+// INPUT PARAMETERS:
+//   [engine]<IN> Engine with its effective depth, weights and settings filled in
+//   [clock]<IN> Game clock of the run; remaining 0 for none
+// OUTPUT PARAMETERS:
+//   [unsigned int]<OUT> 16-bit identifier
+//--------------------------------------------------
+unsigned int engineConfigId( const Engine * engine, const GameClock * clock );
+
+//--------------------------------------------------
+// openPositionCache
+// PURPOSE: Map a persistent position cache file, creating it when needed
+// INPUT PARAMETERS:
+//   [path]<IN> Cache file
+//   [nRecords]<IN> Capacity of a new file, rounded up to a power of two; an existing
+//                  file keeps its own capacity
+// OUTPUT PARAMETERS:
+//   [PositionCache *]<OUT> Opened cache, or NULL on error
+// REMARKS: The file is mapped shared, so concurrent processes see each other's results.
+//--------------------------------------------------
+PositionCache * openPositionCache( const char * path, int nRecords );
+
+//--------------------------------------------------
+// closePositionCache
+// PURPOSE: Report the hit rate of the run on standard error and unmap the cache
+// INPUT PARAMETERS:
+//   [cache]<IN/OUT> Cache to close; may be NULL
+//--------------------------------------------------
+void closePositionCache( PositionCache * cache );
+
+//--------------------------------------------------
+// lookupPositionCache
+// PURPOSE: Find the stored result of a position
+// INPUT PARAMETERS:
+//   [cache]<IN/OUT> Cache to search
+//   [key]<IN> Position hash
+//   [config]<IN> Engine configuration identifier
+//   [move]<OUT> Stored result
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True on a hit; otherwise, false
+//--------------------------------------------------
+boolean lookupPositionCache( PositionCache * cache, uint64_t key, unsigned int config, BoardMove * move );
+
+//--------------------------------------------------
+// storePositionCache
+// PURPOSE: Store the result of a position
+// INPUT PARAMETERS:
+//   [cache]<IN/OUT> Cache to update
+//   [key]<IN> Position hash
+//   [config]<IN> Engine configuration identifier
+//   [move]<IN> Result to store
+// REMARKS: The record replaces the same position if present, else an empty way of
+//   the bucket, else the way written by the oldest run, shallowest first.
+//--------------------------------------------------
+void storePositionCache( PositionCache * cache, uint64_t key, unsigned int config, const BoardMove * move );
+
+//--------------------------------------------------
+// isShardOwned
+// PURPOSE: Check if a board belongs to the shard this process runs
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+//   [ordinal]<IN> Position of the board in its input, counting from 0
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the board must be processed here; otherwise, false
+// REMARKS: Always true when not sharding. Boards, or chunks of boards, are dealt
+//   round-robin, so the choice depends on nothing but the input itself.
+//--------------------------------------------------
+boolean isShardOwned( const Options * options, int ordinal );
+
+//--------------------------------------------------
+// readShardRecord
+// PURPOSE: Read the next tagged record of a shard output
+// INPUT PARAMETERS:
+//   [reader]<IN/OUT> Shard reader; hasRecord tells whether a record was read
+// REMARKS: End tags passed on the way are collected in inputBoards.
+//--------------------------------------------------
+void readShardRecord( ShardReader * reader );
+
+//--------------------------------------------------
+// mergeShards
+// PURPOSE: Interleave shard outputs back into the order of a single-process run
+// INPUT PARAMETERS:
+//   [options]<IN> Run options; the inputs are the shard output files
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if all shards could be merged; otherwise, false
+// REMARKS: Each shard output is already sorted, so this is a k-way merge on the
+//   (input, ordinal) tag of each record. Tags are stripped from the result. The
+//   merge fails unless every shard of the run is given once and the records of
+//   each input run without a gap up to the number of boards in its end tags.
+//--------------------------------------------------
+boolean mergeShards( const Options * options );
+
+//--------------------------------------------------
+// processInputJob
+// PURPOSE: Worker pool job processing one input of the batch
+// INPUT PARAMETERS:
+//   [context]<IN> BatchContext of the run
+//   [index]<IN> Index of the input in the options
+//   [thread]<IN> Worker number (unused)
+//--------------------------------------------------
+void processInputJob( void * context, int index, int thread );
+
+//--------------------------------------------------
+// runBatch
+// PURPOSE: Process all inputs given on the command line
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if every input could be processed; otherwise, false
+// REMARKS: Inputs are processed concurrently. Results go either to one output file
+//   per input or to standard output in the order the inputs were given.
+//--------------------------------------------------
+boolean runBatch( const Options * options );
+
+//--------------------------------------------------
+// makeOutputPath
+// PURPOSE: Build the per-input output file name inside the output directory
+// INPUT PARAMETERS:
+//   [outputDir]<IN> Output directory
+//   [inputPath]<IN> Input path
+//   [suffix]<IN> Extension appended to the name
+//   [path]<OUT> Buffer receiving the name (MAX_INPUT_PATH characters)
+// REMARKS: Directory separators of the input path are turned into '_' so that
+//   inputs with the same base name in different directories do not collide;
+//   checkOutputPaths() rejects the inputs whose names still do.
+//--------------------------------------------------
+void makeOutputPath( const char * outputDir, const char * inputPath, const char * suffix, char * path );
+
+//--------------------------------------------------
+// compareOutputNames
+// PURPOSE: qsort() order of output names: by path, then by input
+// INPUT PARAMETERS:
+//   [left]<IN> OutputName
+//   [right]<IN> OutputName
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Negative, zero or positive
+//--------------------------------------------------
+int compareOutputNames( const void * left, const void * right );
+
+//--------------------------------------------------
+// checkOutputPaths
+// PURPOSE: Make sure no two inputs write the same file of the output directory
+// INPUT PARAMETERS:
+//   [options]<IN> Run options, with outputDir set
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if every input has an output file of its own; otherwise, false
+// REMARKS: Flattening makes a/b and a_b the same name, and one would overwrite the other.
+//--------------------------------------------------
+boolean checkOutputPaths( const Options * options );
+
+//--------------------------------------------------
+// currentSeconds
+// PURPOSE: Read a monotonic clock
+// OUTPUT PARAMETERS:
+//   [double]<OUT> Seconds since an arbitrary point
+//--------------------------------------------------
+double currentSeconds( void );
+
+//--------------------------------------------------
+// writeGameBoard
+// PURPOSE: Write a board in the format read by readGameBoard()
+// INPUT PARAMETERS:
+//   [output]<IN> Stream to write to
+//   [board]<IN> Board to write
+//--------------------------------------------------
+void writeGameBoard( FILE * output, const GameBoard * board );
+
+//--------------------------------------------------
+// parseHostPort
+// PURPOSE: Split a "[HOST:]PORT" argument
+// INPUT PARAMETERS:
+//   [argument]<IN> Text to parse
+//   [host]<OUT> Host; left untouched when absent (LINE_MAX characters)
+//   [port]<OUT> Port
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the port is valid; otherwise, false
+//--------------------------------------------------
+boolean parseHostPort( const char * argument, char * host, int * port );
+
+//--------------------------------------------------
+// sendAll
+// PURPOSE: Write a whole buffer to a socket
+// INPUT PARAMETERS:
+//   [fd]<IN> Socket
+//   [data]<IN> Bytes to send
+//   [size]<IN> Number of bytes
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if everything was sent; otherwise, false
+//--------------------------------------------------
+boolean sendAll( int fd, const void * data, size_t size );
+
+//--------------------------------------------------
+// readFarmChunk
+// PURPOSE: Read the next chunk of boards for the worker farm
+// INPUT PARAMETERS:
+//   [options]<IN> Run options; chunkSize boards are read per chunk
+//   [inputIndex]<IN/OUT> Input being read
+//   [input]<IN/OUT> Open stream of that input, or NULL
+//   [chunk]<OUT> Chunk to fill
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if at least one board was read; otherwise, false
+// REMARKS: Inputs are read lazily one after another, so the coordinator only
+//   holds the chunks which are in flight or waiting to be written out.
+//--------------------------------------------------
+boolean readFarmChunk( const Options * options, int * inputIndex, FILE ** input, FarmChunk * chunk );
+
+//--------------------------------------------------
+// runCoordinator
+// PURPOSE: Hand board chunks to worker processes over TCP and print their results in order
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if all boards were processed; otherwise, false
+// REMARKS: Workers pull one chunk at a time, so faster workers simply take more.
+//   Once the inputs are exhausted an idle worker steals a copy of the oldest chunk
+//   still in flight; the first result wins. A worker which disconnects or misses
+//   heartbeats for heartbeatTimeout seconds is dropped and its chunk reassigned.
+//--------------------------------------------------
+boolean runCoordinator( const Options * options );
+
+//--------------------------------------------------
+// runWorker
+// PURPOSE: Connect to a coordinator and process the chunks it sends until told to quit
+// INPUT PARAMETERS:
+//   [options]<IN> Run options
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the coordinator ended the session; otherwise, false
+//--------------------------------------------------
+boolean runWorker( const Options * options );
+
+//--------------------------------------------------
+// heartbeatThread
+// PURPOSE: Thread body sending heartbeats while a worker is busy. Support function for runWorker()
+// INPUT PARAMETERS:
+//   [argument]<IN> HeartbeatContext
+// OUTPUT PARAMETERS:
+//   [void *]<OUT> Always NULL
+//--------------------------------------------------
+void * heartbeatThread( void * argument );
+
+//--------------------------------------------------
+// receiveFarmMessages
+// PURPOSE: Parse the complete messages a worker has sent. Support function for runCoordinator()
+// INPUT PARAMETERS:
+//   [worker]<IN/OUT> Worker whose buffer is parsed
+//   [chunks]<IN/OUT> Chunks of the run
+//   [nChunks]<IN> Number of chunks
+// OUTPUT PARAMETERS:
+//   [boolean]<OUT> True if the messages are well formed; otherwise, false
+//--------------------------------------------------
+boolean receiveFarmMessages( FarmWorker * worker, FarmChunk * chunks, int nChunks );
+
+
+//------------------------------------------------------------------------------
+// VARIABLES
+//------------------------------------------------------------------------------
+
+
+//------------------------------------------------------------------------------
+// FUNCTIONS
+//------------------------------------------------------------------------------
+//------------------------------------------------------
+// main
+// PURPOSE: Application entry point.
+// INPUT PARAMETERS:
+//   [argc]<IN> Number of arguments
+//   [argv]<IN> Input files or directories and options; see printUsage()
+// OUTPUT PARAMETERS:
+//   [int]<OUT> Application exit code.
+//------------------------------------------------------
+int main( int argc, char * argv[] )
+{
+    Options options;
+    boolean success = false;
+    int exitCode = EXIT_FAILURE;
+
+    if( parseOptions( argc, argv, &options ) )
+    {
+        switch( options.mode )
+        {
+        case MODE_MERGE:
+            success = mergeShards( &options );
+            break;
+        case MODE_COORDINATOR:
+            success = runCoordinator( &options );
+            break;
+        case MODE_WORKER:
+            success = runWorker( &options );
+            break;
+        case MODE_BUILD_BOOK:
+            success = runBookBuilder( &options );
+            break;
+        case MODE_MAKE_TABLEBASE:
+            success = makeTablebase( &options );
+            break;
+        case MODE_SELF_PLAY:
+            success = runSelfPlay( &options );
+            break;
+        case MODE_REPLAY:
+            success = runReplay( &options );
+            break;
+        case MODE_ANNOTATE:
+            success = runAnnotate( &options );
+            break;
+        case MODE_IMPORT_WTHOR:
+            success = runImportWthor( &options );
+            break;
+        case MODE_EXPORT_DATASET:
+            success = runExportDataset( &options );
+            break;
+        case MODE_TRAIN:
+            success = runTrainer( &options );
+            break;
+        case MODE_MATCH:
+            success = runMatch( &options );
+            break;
+        case MODE_PLAY:
+            success = runPlay( &options );
+            break;
+        case MODE_NBOARD:
+            success = runNboard( &options );
+            break;
+        case MODE_BATCH:
+        default:
+            success = runBatch( &options );
+            break;
+        }
+        if( success )
+        {
+            exitCode = EXIT_SUCCESS;
+        }
+    }
+    freeInputList( &options.inputs );
+    freePatternWeights( options.weights );
+    freePatternWeights( options.engine.weights );
+    freePatternWeights( options.players[0].weights );
+    freePatternWeights( options.players[1].weights );
+    return exitCode;
+}
+
+
+boolean checkstate( const GameBoard * board )
+{
+	assert(0 < board->nColumns && board->nColumns < MAX_BOARD_COLUMNS);
+	assert(0 < board->nRows && board->nColumns < MAX_BOARD_ROWS);
+	assert(board->player == WHITE || board->player == BLACK);
+
+	boolean bState = false;
+
+	if (0 < board->nColumns && board->nColumns < MAX_BOARD_COLUMNS
+		&& 0 < board->nRows && board->nColumns < MAX_BOARD_ROWS
+		&&board->player == WHITE || board->player == BLACK)
+	{
+		bState = true;
+	}
 
 	return bState;
 }
 
 
-boolean computeBestMove( )
+boolean computeBestMove( AnalysisContext * analysis, const GameBoard * position, FILE * output )
+{
+    GameBoard board = *position; // working copy to try the pieces on
+    BoardMove best, stored;
+    Engine * engine;
+    MoveRanking * ranking = NULL;
+    const BookRecord * record = NULL;
+    const TablebaseRecord * solved;
+    uint64_t key = 0, dedupKey = 0, exactKey = 0, bookKey = 0;
+    int transform = 0, dedupTransform = 0, bookTransform = 0;
+    int bestReverse = 0;
+    boolean duplicate = false;
+    boolean found = false;
+    boolean success = false;
+
+    engine = acquireEngine( analysis, board.engine );
+    if( NULL != engine )
+    {   // what the engine met on earlier boards would break ties differently from run to run
+        resetEngine( engine );
+    }
+    if( NULL != engine && checkstate( &board ) )
+    {
+        printBoard( output, &board );
+
+        // stored results are kept in the frame of the key's image; map them back
+        if( NULL != analysis->dedup )
+        {
+            // boards asking for different engines are not repeats
+            exactKey = hashGameBoard( &board ) ^ mixHash( engine->configId );
+            dedupKey = analysis->dedup->symmetric
+                ? canonicalHash( &board, &dedupTransform ) ^ mixHash( engine->configId ) : exactKey;
+            duplicate = reserveDuplicate( analysis->dedup, dedupKey, exactKey, &best );
+            if( duplicate )
+            {
+                inverseTransformCell( dedupTransform, board.nRows, board.nColumns, &best.row, &best.col );
+            }
+            found = duplicate;
+        }
+        if( !found && NULL != analysis->tablebase
+            && NULL != ( solved = lookupTablebase( analysis->tablebase, &board, &transform ) ) )
+        {
+            best.row = solved->row;
+            best.col = solved->col;
+            inverseTransformCell( transform, board.nRows, board.nColumns, &best.row, &best.col );
+            best.score = solved->score;
+            best.depth = board.nRows * board.nColumns;
+            best.source = SOURCE_TABLEBASE;
+            found = true;
+        }
+        if( !found && ( NULL != analysis->book || NULL != analysis->bookOut ) )
+        {
+            bookKey = canonicalHash( &board, &bookTransform );
+        }
+        if( !found && NULL != analysis->book && NULL != ( record = lookupOpeningBook( analysis->book, bookKey ) ) )
+        {
+            best.row = record->row;
+            best.col = record->col;
+            inverseTransformCell( bookTransform, board.nRows, board.nColumns, &best.row, &best.col );
+            best.score = record->score;
+            best.depth = record->depth;
+            best.source = SOURCE_BOOK;
+            found = true;
+        }
+        if( !found && NULL != analysis->cache )
+        {
+            key = positionKey( analysis, &board, &transform );
+            found = lookupPositionCache( analysis->cache, key, engine->configId, &best );
+            if( found )
+            {
+                inverseTransformCell( transform, board.nRows, board.nColumns, &best.row, &best.col );
+            }
+        }
+        if( !found )
+        {
+            chooseEngineMove( engine, &board, &best );
+            best.source = SOURCE_ENGINE;
+        }
+        if( 0 < analysis->options->topMoves )
+        {   // after the choice, which the MCTS ranking reuses
+            ranking = calloc( 1, sizeof( MoveRanking ) );
+            assert( NULL != ranking );
+            rankEngineMoves( engine, &board, ranking );
+        }
+        bestReverse = SOURCE_ENGINE == best.source && ENGINE_GREEDY == engine->spec.kind
+            ? best.score : countReverses( &board, best.row, best.col );
+        if( !found && NULL != analysis->cache )
+        {
+            stored = best;
+            transformCell( transform, board.nRows, board.nColumns, &stored.row, &stored.col );
+            storePositionCache( analysis->cache, key, engine->configId, &stored );
+        }
+        if( !duplicate && NULL != analysis->dedup )
+        {   // always publish a reservation, threads may be waiting on it
+            stored = best;
+            transformCell( dedupTransform, board.nRows, board.nColumns, &stored.row, &stored.col );
+            publishDuplicate( analysis->dedup, dedupKey, exactKey, &stored,
+                analysis->dedup->symmetric && isOnlyBestMove( engine, &board, &best ) );
+        }
+        if( NULL == record && NULL != analysis->bookOut )
+        {
+            stored = best;
+            transformCell( bookTransform, board.nRows, board.nColumns, &stored.row, &stored.col );
+            addBookRecord( analysis->bookOut, bookKey, &stored );
+        }
+        fprintf( output, "\n" );
+        fprintf( output, "The best move for %s is (%c, %d), which will reverse %d opponent piece(s)\n",
+            WHITE == board.player ? "WHITE" : "BLACK",
+            best.col + 'a',
+            best.row + 1,
+            bestReverse );
+        if( SOURCE_BOOK == best.source )
+        {
+            fprintf( output, "(book move: score %d, depth %d)\n", best.score, best.depth );
+        }
+        else if( SOURCE_TABLEBASE == best.source )
+        {
+            fprintf( output, "(tablebase move: final disc difference %+d under perfect play)\n", best.score );
+        }
+        else if( ENGINE_GREEDY != engine->spec.kind )
+        {
+            fprintf( output, "(%s move: score %d, depth %d)\n", engine->spec.name, best.score, best.depth );
+        }
+        if( NULL != ranking )
+        {
+            printMoveRanking( output, ranking, analysis->options->topMoves, ENGINE_GREEDY != engine->spec.kind );
+            free( ranking->flips );
+            free( ranking );
+        }
+        fprintf( output, "\n" );
+        success = true;
+    }
+    if( NULL != engine )
+    {
+        releaseEngine( analysis, engine );
+    }
+    return success;
+}
+
+
+boolean canPlayAt( const GameBoard * board, int row, int col )
+{
+    boolean result = false;
+
+	if (checkstate(board))
+	{
+		assert(0 <= row && row < board->nRows);
+		assert(0 <= col && col < board->nColumns);
+
+		//only can play at the spot that demonstrates NONE state
+		if (0 <= row && row < board->nRows && 0 <= col && col < board->nColumns && board->state[row][col] == NONE)
+		{
+			//check if opponent's piece is around given position. 8 directions 
+			if ((row - 1 >= 0 && row -1 < board->nRows && col -1 >= 0 && col - 1 < board->nRows && board->state[row - 1][col - 1] != board->player && board->state[row - 1][col - 1] != NONE)
+				|| (row - 1 > 0 && row - 1 < board->nRows && board->state[row - 1][col] != board->player && board->state[row - 1][col] != NONE)
+				|| (row - 1 >= 0 && row - 1 < board->nRows && col + 1 >= 0 && col + 1 < board->nRows && board->state[row - 1][col + 1] != board->player && board->state[row - 1][col + 1] != NONE)
+				|| (col - 1 >= 0 && col - 1 < board->nRows && board->state[row][col - 1] != board->player && board->state[row][col - 1] != NONE)
+				|| (col + 1 >= 0 && col + 1 < board->nRows && board->state[row][col + 1] != board->player && board->state[row][col + 1] != NONE)
+				|| (row + 1 >= 0 && row + 1 < board->nRows && col - 1 >= 0 && col - 1 < board->nRows && board->state[row + 1][col - 1] != board->player && board->state[row + 1][col - 1] != NONE)
+				|| (row + 1 >= 0 && row + 1 < board->nRows && board->state[row + 1][col] != board->player && board->state[row + 1][col] != NONE)
+				|| (row + 1 >= 0 && row + 1 < board->nRows && col + 1 >= 0 && col + 1 < board->nRows && board->state[row + 1][col + 1] != board->player && board->state[row + 1][col + 1] != NONE))
+			{
+				result = true;
+			}
+		}
+	}
+
+	return result;
+}
+
+
+int numAllReverse( const GameBoard * board, int row, int col )
+{
+    int count = 0;
+
+    if( checkstate( board ) )
+    {
+        assert( 0 <= row && row < board->nRows );
+        assert( 0 <= col && col < board->nColumns );
+        assert( board->state[row][col] == board->player );
+
+        if( 0 <= row && row < board->nRows && 0 <= col && col < board->nColumns && board->state[row][col] == board->player )
+        {   // we could make following statements to one; however, this is easier to step-in in debugger
+            count += numReverseDirection( board, row, col, -1, -1 );
+            count += numReverseDirection( board, row, col, -1, 0 );
+            count += numReverseDirection( board, row, col, -1, 1 );
+            count += numReverseDirection( board, row, col, 0, -1 );
+            count += numReverseDirection( board, row, col, 0, 1 );
+            count += numReverseDirection( board, row, col, 1, -1 );
+            count += numReverseDirection( board, row, col, 1, 0 );
+            count += numReverseDirection( board, row, col, 1, 1 );
+        }
+    }
+    return count;
+}
+
+
+int numReverseDirection( const GameBoard * board, int row, int col, int dirRow, int dirCol )
+{
+	int count = 0;
+
+	if (checkstate(board))
+	{
+		assert(0 <= row && row < board->nRows);
+		assert(0 <= col && col < board->nColumns);
+		assert(board->state[row][col] == board->player);
+		
+		if (0 <= row && row < board->nRows && 0 <= col && col < board->nColumns && board->state[row][col] == board->player)
+		{
+			//the cell which we are going to check must be inside board.
+			while (0 <= row + dirRow && row + dirRow < board->nRows && 0 <= col + dirCol && col + dirCol < board->nColumns)
+			{
+				if (board->state[row + dirRow][col + dirCol] == board->player)
+					return count;
+				else if (board->state[row + dirRow][col + dirCol] == NONE)
+					break;
+				else
+					count++;
+
+				row = row + dirRow;
+				col = col + dirCol;
+			}
+		}	
+	}
+	//outside board or found NONE state position.
+	count = 0;
+	return count;
+}
+
+
+boolean readGameBoard( FILE * input, GameBoard * board )
+{
+    char line[LINE_MAX];
+    char player = 0;
+    int length = 0;
+    int col, row;
+    boolean success = false;
+
+    assert( NULL != board );
+    if( NULL != board )
+    {
+        memset( board, 0, sizeof( GameBoard ) ); // initialization
+
+        fgets( board->title, MAX_BOARD_TITLE, input );
+        length = strlen( board->title );
+        if( length > 0 && board->title[length - 1] == '\n' )
+        {   // remove \n
+            board->title[length - 1] = '\0';
+        }
+
+        fgets( line, MAX_BOARD_TITLE, input );
+        sscanf( line, "%d %d %c %255s", &board->nColumns, &board->nRows, &player, board->engine );
+        board->player = 'W' == player ? WHITE : BLACK; // who will play next?
+
+        for( row = 0; NULL != fgets( line, LINE_MAX, input ) && row < board->nRows; row++ )
+        {   // by putting read line first, we discard the last empty line
+            for( col = 0; '\0' != line[col] && col < board->nColumns; col++ )
+            {
+                switch( line[col] )
+                {
+                case 'B':
+                    board->state[row][col] = BLACK;
+                    break;
+                case 'W':
+                    board->state[row][col] = WHITE;
+                    break;
+                case ' ':
+                default:
+                    board->state[row][col] = NONE;
+                    break;
+                }
+            }
+        }
+        success = row > 0 && row >= board->nRows && checkstate( board );
+    }
+    return success;
+}
+
+
+void printBoard( FILE * output, const GameBoard * board )
+{
+    int col, row;
+
+    if( checkstate( board ) )
+    {
+        fprintf( output, "%s\n\n", board->title );
+        printBoardColumnName( output, board->nColumns );
+        printBoardRowSeparator( output, board->nColumns );
+        for( row = 0; row < board->nRows; row++ )
+        {
+            fprintf( output, "%2d|", row + 1 );
+            for( col = 0; col < board->nColumns; col++ )
+            {
+                switch( board->state[row][col] )
+                {
+                case BLACK:
+                    fputs( "B|", output );
+                    break;
+                case WHITE:
+                    fputs( "W|", output );
+                    break;
+                default:
+                    fputs( " |", output );
+                    break;
+                }
+            }
+            fprintf( output, "%-2d\n", row + 1 );
+            printBoardRowSeparator( output, board->nColumns );
+        }
+        printBoardColumnName( output, board->nColumns );
+    }
+}
+
+
+void printBoardColumnName( FILE * output, int nColumns )
+{
+    int col;
+
+    assert( nColumns > 0 );
+    assert( nColumns < MAX_BOARD_COLUMNS );
+    fputs( "   ", output );
+    for( col = 0; col < nColumns; col++ )
+    {
+        fprintf( output, "%c ", 'a' + col );
+    }
+    fputs( "  \n", output );
+}
+
+
+void printBoardRowSeparator( FILE * output, int nColumns )
+{
+    int col;
+
+    assert( nColumns > 0 );
+    assert( nColumns < MAX_BOARD_COLUMNS );
+    fputs( "  +", output );
+    for( col = 0; col < nColumns; col++ )
+    {
+        fputs( "-+", output );
+    }
+    fputs( "\n", output );
+}
+
+
+boolean parseOptions( int argc, char * argv[], Options * options )
+{
+    int i;
+    boolean success = true;
+
+    memset( options, 0, sizeof( Options ) );
+    options->mode = MODE_BATCH;
+    options->nThreads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+    options->chunkSize = DEFAULT_CHUNK_SIZE;
+    options->cacheRecords = DEFAULT_CACHE_RECORDS;
+    options->bookNodes = DEFAULT_BOOK_NODES;
+    options->bookDepth = DEFAULT_BOOK_DEPTH;
+    options->tablebaseSize = DEFAULT_TABLEBASE_SIZE;
+    options->searchDepth = DEFAULT_SEARCH_DEPTH;
+    parseEngineSpec( GREEDY_ENGINE_CONFIG, &options->engine );
+    options->randomPlies = DEFAULT_RANDOM_PLIES;
+    options->tableEntries = DEFAULT_TABLE_ENTRIES;
+    options->epochs = DEFAULT_EPOCHS;
+    options->learningRate = DEFAULT_LEARNING_RATE;
+    options->matchGames = DEFAULT_MATCH_GAMES;
+    options->sprtElo0 = DEFAULT_SPRT_ELO0;
+    options->sprtElo1 = DEFAULT_SPRT_ELO1;
+    options->heartbeat = DEFAULT_HEARTBEAT;
+    options->heartbeatTimeout = DEFAULT_HEARTBEAT_TIMEOUT;
+    strcpy( options->farmHost, DEFAULT_FARM_HOST );
+    for( i = 1; success && i < argc; i++ )
+    {
+        if( 0 == strcmp( argv[i], "-j" ) && i + 1 < argc )
+        {
+            options->nThreads = atoi( argv[++i] );
+        }
+        else if( 0 == strcmp( argv[i], "-o" ) && i + 1 < argc )
+        {
+            options->outputDir = argv[++i];
+        }
+        else if( 0 == strcmp( argv[i], "--output" ) && i + 1 < argc )
+        {
+            options->outputFile = argv[++i];
+        }
+        else if( 0 == strcmp( argv[i], "--cache" ) && i + 1 < argc )
+        {
+            options->cacheFile = argv[++i];
+        }
+        else if( 0 == strcmp( argv[i], "--cache-records" ) && i + 1 < argc )
+        {
+            options->cacheRecords = atoi( argv[++i] );
+            success = 0 < options->cacheRecords;
+        }
+        else if( 0 == strcmp( argv[i], "--top" ) && i + 1 < argc )
+        {
+            i++;
+            options->topMoves = 0 == strcmp( argv[i], "all" ) ? MAX_MOVES : atoi( argv[i] );
+            success = 0 < options->topMoves;
+        }
+        else if( 0 == strcmp( argv[i], "--dedup" ) )
+        {
+            options->dedup = true;
+        }
+        else if( 0 == strcmp( argv[i], "--dedup-symmetric" ) )
+        {
+            options->dedupSymmetric = true;
+        }
+        else if( 0 == strcmp( argv[i], "--book" ) && i + 1 < argc )
+        {
+            options->bookFile = argv[++i];
+        }
+        else if( 0 == strcmp( argv[i], "--self-play" ) && i + 1 < argc )
+        {
+            options->mode = MODE_SELF_PLAY;
+            options->selfPlayGames = atol( argv[++i] );
+            success = 0 < options->selfPlayGames;
+        }
+        else if( 0 == strcmp( argv[i], "--replay" ) )
+        {
+            options->mode = MODE_REPLAY;
+        }
+        else if( 0 == strcmp( argv[i], "--export-dataset" ) && i + 1 < argc )
+        {
+            options->mode = MODE_EXPORT_DATASET;
+            options->datasetFile = argv[++i];
+        }
+        else if( 0 == strcmp( argv[i], "--match" ) && i + 2 < argc )
+        {
+            options->mode = MODE_MATCH;
+            success = parseEngineSpec( argv[i + 1], &options->players[0] )
+                && parseEngineSpec( argv[i + 2], &options->players[1] );
+            i += 2;
+        }
+        else if( 0 == strcmp( argv[i], "--play" ) )
+        {
+            options->mode = MODE_PLAY;
+        }
+        else if( 0 == strcmp( argv[i], "--clock" ) && i + 1 < argc )
+        {
+            options->clock.increment = 0;
+            success = 1 <= sscanf( argv[++i], "%lf+%lf", &options->clock.remaining, &options->clock.increment )
+                && 0 < options->clock.remaining && 0 <= options->clock.increment;
+        }
+        else if( 0 == strcmp( argv[i], "--nboard" ) )
+        {
+            options->mode = MODE_NBOARD;
+        }
+        else if( 0 == strcmp( argv[i], "--ponder" ) )
+        {
+            options->ponder = true;
+        }
+        else if( 0 == strcmp( argv[i], "--info-interval" ) && i + 1 < argc )
+        {
+            options->infoInterval = atof( argv[++i] ) / 1000;
+            options->info = true;
+        }
+        else if( 0 == strcmp( argv[i], "--games" ) && i + 1 < argc )
+        {
+            options->matchGames = atol( argv[++i] );
+            success = 0 < options->matchGames;
+        }
+        else if( 0 == strcmp( argv[i], "--sprt" ) && i + 1 < argc )
+        {
+            if( 2 != sscanf( argv[++i], "%lf,%lf", &options->sprtElo0, &options->sprtElo1 )
+                || options->sprtElo0 >= options->sprtElo1 )
+            {
+                fprintf( stderr, "reversi: --sprt needs ELO0,ELO1 with ELO0 < ELO1\n" );
+                success = false;
+            }
+        }
+        else if( 0 == strcmp( argv[i], "--weights" ) && i + 1 < argc )
+        {
+            options->weightsFile = argv[++i];
+        }
+        else if( 0 == strcmp( argv[i], "--train" ) && i + 1 < argc )
+        {
+            options->mode = MODE_TRAIN;
+            options->trainFile = argv[++i];
+        }
+        else if( 0 == strcmp( argv[i], "--epochs" ) && i + 1 < argc )
+        {
+            options->epochs = atoi( argv[++i] );
+            success = 0 < options->epochs;
+        }
+        else if( 0 == strcmp( argv[i], "--learning-rate" ) && i + 1 < argc )
+        {
+            options->learningRate = atof( argv[++i] );
+        }
+        else if( 0 == strcmp( argv[i], "--logistic" ) )
+        {
+            options->logistic = true;
+        }
+        else if( 0 == strcmp( argv[i], "--train-on-score" ) )
+        {
+            options->trainOnScore = true;
+        }
+        else if( 0 == strcmp( argv[i], "--import-wthor" ) )
+        {
+            options->mode = MODE_IMPORT_WTHOR;
+        }
+        else if( 0 == strcmp( argv[i], "--annotate" ) )
+        {
+            options->mode = MODE_ANNOTATE;
+        }
+        else if( 0 == strcmp( argv[i], "--tt-entries" ) && i + 1 < argc )
+        {
+            options->tableEntries = strtoull( argv[++i], NULL, 0 );
+        }
+        else if( 0 == strcmp( argv[i], "--engine" ) && i + 1 < argc )
+        {
+            freePatternWeights( options->engine.weights );
+            success = parseEngineSpec( argv[++i], &options->engine );
+        }
+        else if( 0 == strcmp( argv[i], "--depth" ) && i + 1 < argc )
+        {
+            options->searchDepth = atoi( argv[++i] );
+            success = 0 < options->searchDepth && options->searchDepth <= MAX_MOVES;
+        }
+        else if( 0 == strcmp( argv[i], "--random-plies" ) && i + 1 < argc )
+        {
+            options->randomPlies = atoi( argv[++i] );
+        }
+        else if( 0 == strcmp( argv[i], "--seed" ) && i + 1 < argc )
+        {
+            options->seed = strtoull( argv[++i], NULL, 0 );
+        }
+        else if( 0 == strcmp( argv[i], "--tablebase" ) && i + 1 < argc )
+        {
+            options->tablebaseFile = argv[++i];
+        }
+        else if( 0 == strcmp( argv[i], "--make-tablebase" ) && i + 1 < argc )
+        {
+            options->mode = MODE_MAKE_TABLEBASE;
+            options->makeTablebaseFile = argv[++i];
+        }
+        else if( 0 == strcmp( argv[i], "--tablebase-size" ) && i + 1 < argc )
+        {
+            options->tablebaseSize = atoi( argv[++i] );
+            if( options->tablebaseSize < 4 || 0 != options->tablebaseSize % 2
+                || options->tablebaseSize * options->tablebaseSize > TABLEBASE_MAX_CELLS )
+            {
+                fprintf( stderr, "reversi: tablebases are limited to %d cells; %dx%d cannot be solved completely\n",
+                    TABLEBASE_MAX_CELLS, options->tablebaseSize, options->tablebaseSize );
+                success = false;
+            }
+        }
+        else if( 0 == strcmp( argv[i], "--make-book" ) && i + 1 < argc )
+        {
+            options->makeBookFile = argv[++i];
+        }
+        else if( 0 == strcmp( argv[i], "--build-book" ) && i + 1 < argc )
+        {
+            options->mode = MODE_BUILD_BOOK;
+            options->buildBookFile = argv[++i];
+        }
+        else if( 0 == strcmp( argv[i], "--book-nodes" ) && i + 1 < argc )
+        {
+            options->bookNodes = atoi( argv[++i] );
+        }
+        else if( 0 == strcmp( argv[i], "--book-depth" ) && i + 1 < argc )
+        {
+            options->bookDepth = atoi( argv[++i] );
+            if( options->bookDepth < 1 || options->bookDepth > MAX_BOOK_DEPTH )
+            {
+                fprintf( stderr, "reversi: --book-depth must be between 1 and %d\n", MAX_BOOK_DEPTH );
+                success = false;
+            }
+        }
+        else if( 0 == strcmp( argv[i], "--cache-symmetric" ) )
+        {
+            options->cacheSymmetric = true;
+        }
+        else if( 0 == strcmp( argv[i], "--checkpoint-every" ) && i + 1 < argc )
+        {
+            options->checkpointEvery = atoi( argv[++i] );
+        }
+        else if( 0 == strcmp( argv[i], "--resume" ) )
+        {
+            options->resume = true;
+        }
+        else if( 0 == strcmp( argv[i], "--shard" ) && i + 1 < argc )
+        {
+            if( 2 != sscanf( argv[++i], "%d/%d", &options->shardIndex, &options->nShards )
+                || options->nShards < 1 || options->shardIndex < 0 || options->shardIndex >= options->nShards )
+            {
+                fprintf( stderr, "reversi: --shard expects i/N with 0 <= i < N\n" );
+                success = false;
+            }
+        }
+        else if( 0 == strcmp( argv[i], "--shard-by" ) && i + 1 < argc )
+        {
+            i++;
+            options->shardByChunk = 0 == strcmp( argv[i], "chunk" );
+            if( !options->shardByChunk && 0 != strcmp( argv[i], "board" ) )
+            {
+                fprintf( stderr, "reversi: --shard-by expects 'board' or 'chunk'\n" );
+                success = false;
+            }
+        }
+        else if( 0 == strcmp( argv[i], "--chunk-size" ) && i + 1 < argc )
+        {
+            options->chunkSize = atoi( argv[++i] );
+            if( options->chunkSize < 1 )
+            {
+                fprintf( stderr, "reversi: --chunk-size must be positive\n" );
+                success = false;
+            }
+        }
+        else if( 0 == strcmp( argv[i], "--merge" ) )
+        {
+            options->mode = MODE_MERGE;
+        }
+        else if( ( 0 == strcmp( argv[i], "--coordinator" ) || 0 == strcmp( argv[i], "--worker" ) ) && i + 1 < argc )
+        {
+            options->mode = 0 == strcmp( argv[i], "--worker" ) ? MODE_WORKER : MODE_COORDINATOR;
+            if( !parseHostPort( argv[++i], options->farmHost, &options->farmPort ) )
+            {
+                fprintf( stderr, "reversi: bad address '%s', expected [HOST:]PORT\n", argv[i] );
+                success = false;
+            }
+        }
+        else if( 0 == strcmp( argv[i], "--spawn-workers" ) && i + 1 < argc )
+        {
+            options->nSpawnWorkers = atoi( argv[++i] );
+        }
+        else if( 0 == strcmp( argv[i], "--heartbeat" ) && i + 1 < argc )
+        {
+            options->heartbeat = atof( argv[++i] );
+        }
+        else if( 0 == strcmp( argv[i], "--heartbeat-timeout" ) && i + 1 < argc )
+        {
+            options->heartbeatTimeout = atof( argv[++i] );
+        }
+        else if( 0 == strcmp( argv[i], "-h" ) || 0 == strcmp( argv[i], "--help" ) )
+        {
+            success = false;
+        }
+        else if( '-' == argv[i][0] && '\0' != argv[i][1] )
+        {
+            fprintf( stderr, "reversi: unknown option '%s'\n", argv[i] );
+            success = false;
+        }
+        else if( !addInputPath( &options->inputs, argv[i] ) )
+        {
+            fprintf( stderr, "reversi: cannot read '%s': %s\n", argv[i], strerror( errno ) );
+            success = false;
+        }
+    }
+    if( options->nThreads < 1 )
+    {
+        options->nThreads = 1;
+    }
+    else if( options->nThreads > MAX_WORKER_THREADS )
+    {
+        options->nThreads = MAX_WORKER_THREADS;
+    }
+    if( success && ( options->heartbeat <= 0 || options->heartbeatTimeout <= options->heartbeat
+        || options->nSpawnWorkers < 0 || options->nSpawnWorkers > MAX_FARM_WORKERS ) )
+    {
+        fprintf( stderr, "reversi: heartbeat timeout must exceed the heartbeat, and at most %d workers can be spawned\n",
+            MAX_FARM_WORKERS );
+        success = false;
+    }
+    if( success && ( 0 < options->checkpointEvery || options->resume )
+        && ( ( NULL == options->outputDir && NULL == options->outputFile ) || 0 >= options->checkpointEvery ) )
+    {
+        fprintf( stderr, "reversi: checkpoints need --checkpoint-every N and an output file (--output FILE or -o DIR)\n" );
+        success = false;
+    }
+    if( success && 0 == options->inputs.nPaths
+        && ( MODE_BATCH == options->mode || MODE_MERGE == options->mode || MODE_COORDINATOR == options->mode
+            || MODE_REPLAY == options->mode || MODE_ANNOTATE == options->mode
+            || MODE_EXPORT_DATASET == options->mode || MODE_TRAIN == options->mode ) )
+    {   // no input given: behave as a filter on standard input
+        success = addInputPath( &options->inputs, "-" );
+    }
+    if( !success )
+    {
+        printUsage( );
+    }
+    if( success && NULL != options->weightsFile )
+    {   // searches evaluate with the fitted weights from here on
+        options->weights = loadPatternWeights( options->weightsFile );
+        success = NULL != options->weights;
+    }
+    return success;
+}
+
+
+void printUsage( void )
+{
+    fprintf( stderr,
+        "usage: reversi [options] [FILE|DIR|-]...\n"
+        "  Reads boards from every FILE, every file below DIR, or standard input (default),\n"
+        "  and prints the best move of each board.\n"
+        "  -j N          number of worker threads (default: number of CPUs)\n"
+        "  -o DIR        write one DIR/<input>.out per input instead of standard output\n"
+        "  --output FILE write the combined results to FILE instead of standard output\n"
+        "  --cache FILE  look results up in, and add them to, a persistent position cache\n"
+        "  --cache-records N  capacity of a new cache file (default: 1048576)\n"
+        "  --top K|all   also list the K best moves with their reverses, reversed cells and,\n"
+        "                under search engines, scores\n"
+        "  --dedup       compute repeated boards of the run once and reuse the result\n"
+        "  --dedup-symmetric  also count symmetric images of a board as repeats, where its\n"
+        "                best move is certain not to be tied (greedy, book and tablebase)\n"
+        "  --book FILE   answer positions found in an opening book without computing them\n"
+        "  --make-book FILE  write the results of the run as an opening book\n"
+        "  --tablebase FILE  answer small boards from a perfect-play tablebase\n"
+        "  --make-tablebase FILE  solve every position reachable from the start of a small board\n"
+        "  --tablebase-size N  rows and columns of the generated tablebase (default: 4)\n"
+        "  --self-play N     play N games from the standard start, or from the input boards;\n"
+        "                    with --output FILE the games are appended to FILE in binary\n"
+        "  --replay          replay the games of binary game file inputs and print them as text\n"
+        "  --annotate        print the best move at every ply of the input games (game files\n"
+        "                    or lines of moves from the 8x8 start), searched to --depth\n"
+        "  --tt-entries N    transposition table entries per search thread (default: 1048576)\n"
+        "  --import-wthor    convert the games of WTHOR file inputs: appended to the game file\n"
+        "                    --output FILE, or else every position as a board on standard output\n"
+        "  --export-dataset FILE  write the unique positions of the input games with their result,\n"
+        "                    score and best move at --depth as a NumPy record array\n"
+        "  --train FILE      fit pattern weights to the input datasets and write them to FILE\n"
+        "  --epochs N, --learning-rate R  training passes and step size (default: 30, 1)\n"
+        "  --logistic        fit the win probability rather than the final disc difference\n"
+        "  --train-on-score  fit the search score labels rather than the game results\n"
+        "  --weights FILE    evaluate search leaves with trained pattern weights\n"
+        "  --match A B       play engine A against engine B, given as for --engine, in colour-\n"
+        "                    swapped pairs from the input openings (or random ones) until the\n"
+        "                    SPRT decides\n"
+        "  --games N         most games of a match (default: 2000)\n"
+        "  --play            play a game against the --engine through commands on standard\n"
+        "                    input: new, move CELL, pass, go, analyze, stop, board, quit\n"
+        "  --info-interval MS  in --play, stream the progress of go commands too: a line per\n"
+        "                    search iteration and, within one, every MS milliseconds\n"
+        "  --nboard          speak the NBoard protocol on standard input and output, for\n"
+        "                    Othello GUIs and tournament managers, with the --engine\n"
+        "  --clock S[+INC]   give each side S seconds per game, plus INC after each move, in\n"
+        "                    --self-play, --match, --play and --nboard games; the engines\n"
+        "                    budget every move from it, and lose on time in a match; clocks\n"
+        "                    run on wall time, so keep -j within the cores\n"
+        "  --ponder          in --play, think about the predicted reply (every reply under\n"
+        "                    mcts) while the opponent is to move\n"
+        "  --sprt ELO0,ELO1  hypotheses of the SPRT on A's Elo advantage (default: 0,10)\n"
+        "  --engine SPEC     engine of the boards and of self-play (default: greedy): greedy,\n"
+        "                    search, mcts or endgame, then any of ,depth=D ,time=SECONDS\n"
+        "                    ,playouts=N ,empties=N ,pvs=0 (plain alpha-beta) ,weights=FILE;\n"
+        "                    a board may name its own engine after the player on its size\n"
+        "                    line, as in '8 8 B mcts'\n"
+        "  --depth D         search depth of the search engines (default: 4)\n"
+        "  --random-plies K  open each self-play game with K random moves (default: 8)\n"
+        "  --seed S          self-play random seed (default: 0)\n"
+        "  --build-book FILE grow an 8x8 opening book from the start by drop-out expansion\n"
+        "  --book-nodes N    positions to add to the book per run (default: 1000)\n"
+        "  --book-depth D    search depth of the book leaves (default: 6)\n"
+        "  --cache-symmetric  also answer the symmetric images of cached positions; tied best\n"
+        "                moves may then come back as the image of another board's choice\n"
+        "  --checkpoint-every N\n"
+        "                commit the output and save progress to <output>.ckpt every N boards\n"
+        "                (a checkpointed --output FILE reads its inputs one after another)\n"
+        "  --resume      continue from the last checkpoint instead of starting over\n"
+        "  --shard i/N   process only the boards owned by shard i of N (0 <= i < N)\n"
+        "  --shard-by board|chunk\n"
+        "                deal single boards (default) or chunks of boards to the shards\n"
+        "  --chunk-size N  boards per chunk (default: 64)\n"
+        "  --merge       merge shard outputs given as inputs into a single-process result\n"
+        "  --coordinator [HOST:]PORT\n"
+        "                hand chunks of the inputs to worker processes over TCP\n"
+        "                (listens on 127.0.0.1 unless HOST is given)\n"
+        "  --spawn-workers N  start N local worker processes for the coordinator\n"
+        "  --worker [HOST:]PORT  process chunks sent by a coordinator\n"
+        "  --heartbeat S, --heartbeat-timeout S\n"
+        "                worker heartbeat period and silence before reassignment (default: 1, 10)\n"
+        "  -h, --help    show this help\n" );
+}
+
+
+boolean addInputPath( InputList * inputs, const char * path )
+{
+    struct stat info;
+    struct dirent ** entries = NULL;
+    char child[MAX_INPUT_PATH];
+    char ** paths;
+    int nEntries, i;
+    boolean success = false;
+
+    if( 0 == strcmp( path, "-" ) || ( 0 == stat( path, &info ) && !S_ISDIR( info.st_mode ) ) )
+    {
+        if( inputs->nPaths == inputs->capacity )
+        {
+            inputs->capacity = 0 == inputs->capacity ? 16 : inputs->capacity * 2;
+            paths = realloc( inputs->paths, inputs->capacity * sizeof( char * ) );
+            assert( NULL != paths );
+            inputs->paths = paths;
+        }
+        inputs->paths[inputs->nPaths] = strdup( path );
+        inputs->nPaths++;
+        success = true;
+    }
+    else if( 0 == stat( path, &info ) )
+    {
+        nEntries = scandir( path, &entries, NULL, alphasort );
+        success = nEntries >= 0;
+        for( i = 0; i < nEntries; i++ )
+        {
+            if( '.' != entries[i]->d_name[0] )
+            {
+                snprintf( child, sizeof( child ), "%s/%s", path, entries[i]->d_name );
+                success = addInputPath( inputs, child ) && success;
+            }
+            free( entries[i] );
+        }
+        free( entries );
+    }
+    return success;
+}
+
+
+void freeInputList( InputList * inputs )
+{
+    int i;
+
+    for( i = 0; i < inputs->nPaths; i++ )
+    {
+        free( inputs->paths[i] );
+    }
+    free( inputs->paths );
+    memset( inputs, 0, sizeof( InputList ) );
+}
+
+
+void * workerPoolThread( void * argument )
+{
+    WorkerPool * pool = argument;
+    int index, thread;
+
+    pthread_mutex_lock( &pool->lock );
+    thread = pool->nextThread++;
+    pthread_mutex_unlock( &pool->lock );
+    for( ;; )
+    {
+        pthread_mutex_lock( &pool->lock );
+        index = pool->nextJob++;
+        pthread_mutex_unlock( &pool->lock );
+        if( index >= pool->nJobs )
+        {
+            break;
+        }
+        pool->job( pool->context, index, thread );
+    }
+    return NULL;
+}
+
+
+boolean runWorkerPool( int nThreads, int nJobs, WorkerJob job, void * context )
+{
+    WorkerPool pool;
+    pthread_t threads[MAX_WORKER_THREADS];
+    int nStarted = 0;
+    int i;
+
+    memset( &pool, 0, sizeof( WorkerPool ) );
+    pool.job = job;
+    pool.context = context;
+    pool.nJobs = nJobs;
+    pthread_mutex_init( &pool.lock, NULL );
+    if( nThreads > nJobs )
+    {
+        nThreads = nJobs;
+    }
+    if( nThreads > MAX_WORKER_THREADS )
+    {
+        nThreads = MAX_WORKER_THREADS;
+    }
+    if( nThreads <= 1 )
+    {
+        workerPoolThread( &pool );
+    }
+    else
+    {
+        for( i = 0; i < nThreads; i++ )
+        {
+            if( 0 == pthread_create( &threads[nStarted], NULL, workerPoolThread, &pool ) )
+            {
+                nStarted++;
+            }
+        }
+        if( 0 == nStarted )
+        {   // no thread at all: do the work here rather than fail
+            workerPoolThread( &pool );
+        }
+        for( i = 0; i < nStarted; i++ )
+        {
+            pthread_join( threads[i], NULL );
+        }
+    }
+    pthread_mutex_destroy( &pool.lock );
+    return pool.nextJob >= nJobs;
+}
+
+
+boolean initOrderedOutput( OrderedOutput * ordered, FILE * output, int nItems )
+{
+    memset( ordered, 0, sizeof( OrderedOutput ) );
+    ordered->output = output;
+    ordered->nItems = nItems;
+    ordered->buffers = calloc( nItems + 1, sizeof( char * ) );
+    ordered->sizes = calloc( nItems + 1, sizeof( size_t ) );
+    ordered->ready = calloc( nItems + 1, sizeof( boolean ) );
+    pthread_mutex_init( &ordered->lock, NULL );
+    pthread_cond_init( &ordered->turn, NULL );
+    return NULL != ordered->buffers && NULL != ordered->sizes && NULL != ordered->ready;
+}
+
+
+void submitOrderedOutput( OrderedOutput * ordered, int index, char * buffer, size_t size )
+{
+    assert( 0 <= index && index < ordered->nItems );
+    pthread_mutex_lock( &ordered->lock );
+    ordered->buffers[index] = buffer;
+    ordered->sizes[index] = size;
+    ordered->ready[index] = true;
+    while( ordered->nextItem < ordered->nItems && ordered->ready[ordered->nextItem] )
+    {
+        if( NULL != ordered->buffers[ordered->nextItem] )
+        {
+            fwrite( ordered->buffers[ordered->nextItem], 1, ordered->sizes[ordered->nextItem], ordered->output );
+            free( ordered->buffers[ordered->nextItem] );
+            ordered->buffers[ordered->nextItem] = NULL;
+        }
+        ordered->nextItem++;
+    }
+    pthread_cond_broadcast( &ordered->turn );
+    pthread_mutex_unlock( &ordered->lock );
+}
+
+
+FILE * openOrderedItem( OrderedOutput * ordered, int index )
+{
+    assert( 0 <= index && index < ordered->nItems );
+    return open_memstream( &ordered->buffers[index], &ordered->sizes[index] );
+}
+
+
+FILE * spillOrderedItem( OrderedOutput * ordered, int index, FILE * output )
+{
+    if( ordered->output == output || ORDERED_ITEM_LIMIT > ftell( output ) )
+    {
+        return output;
+    }
+    pthread_mutex_lock( &ordered->lock );
+    while( ordered->nextItem != index )
+    {
+        pthread_cond_wait( &ordered->turn, &ordered->lock );
+    }
+    pthread_mutex_unlock( &ordered->lock );
+    // at the head of the order, and not ready: nobody else writes the output until the item is closed
+    fclose( output );
+    fwrite( ordered->buffers[index], 1, ordered->sizes[index], ordered->output );
+    free( ordered->buffers[index] );
+    ordered->buffers[index] = NULL;
+    return ordered->output;
+}
+
+
+boolean closeOrderedItem( OrderedOutput * ordered, int index, FILE * output )
+{
+    boolean success = ordered->output == output ? !ferror( output ) : 0 == fclose( output );
+
+    submitOrderedOutput( ordered, index, ordered->buffers[index], ordered->sizes[index] );
+    return success;
+}
+
+
+void freeOrderedOutput( OrderedOutput * ordered )
+{
+    int i;
+
+    if( NULL != ordered->buffers )
+    {
+        for( i = 0; i < ordered->nItems; i++ )
+        {
+            free( ordered->buffers[i] );
+        }
+    }
+    free( ordered->buffers );
+    free( ordered->sizes );
+    free( ordered->ready );
+    pthread_mutex_destroy( &ordered->lock );
+    pthread_cond_destroy( &ordered->turn );
+    memset( ordered, 0, sizeof( OrderedOutput ) );
+}
+
+
+FILE * processStream( const Options * options, AnalysisContext * analysis, int inputIndex, FILE * input, FILE * output,
+    StreamStats * stats, Checkpoint * checkpoint, OrderedOutput * ordered )
+{
+    GameBoard board;
+    FILE * record;
+    char * text;
+    size_t size;
+    boolean owned;
+    int ordinal = NULL != checkpoint ? checkpoint->ordinal : 0;
+    double start = currentSeconds( );
+
+    stats->nBoards = 0;
+    for( ; readGameBoard( input, &board ); ordinal++ )
+    {
+        owned = isShardOwned( options, ordinal );
+        if( owned )
+        {
+            if( 0 < options->nShards )
+            {   // the tag gives the length of the record, so no board text can pass for a tag
+                record = open_memstream( &text, &size );
+                assert( NULL != record );
+                computeBestMove( analysis, &board, record );
+                fprintf( record, RECORD_SEPARATOR );
+                fprintf( record, "\n" );
+                fclose( record );
+                fprintf( output, "%s %d/%d %d %d %zu\n", SHARD_RECORD_TAG, options->shardIndex, options->nShards,
+                    inputIndex, ordinal, size );
+                fwrite( text, 1, size, output );
+                free( text );
+            }
+            else
+            {
+                computeBestMove( analysis, &board, output );
+                fprintf( output, RECORD_SEPARATOR );
+                fprintf( output, "\n" );
+            }
+            stats->nBoards++;
+            if( NULL != ordered )
+            {
+                output = spillOrderedItem( ordered, inputIndex, output );
+            }
+        }
+        if( NULL != checkpoint )
+        {
+            checkpoint->ordinal = ordinal + 1;
+            if( owned )
+            {
+                checkpoint->nBoards++;
+                checkpoint->sinceSaved++;
+            }
+            if( checkpoint->sinceSaved >= checkpoint->every )
+            {
+                checkpoint->offset = ftell( input );
+                saveCheckpoint( checkpoint, output );
+            }
+        }
+    }
+    if( 0 < options->nShards )
+    {   // lets mergeShards() tell the last boards of a missing shard from the end of the input
+        fprintf( output, "%s %d/%d %d %d\n", SHARD_END_TAG, options->shardIndex, options->nShards, inputIndex, ordinal );
+    }
+    stats->seconds = currentSeconds( ) - start;
+    return output;
+}
+
+
+boolean processSink( const Options * options, AnalysisContext * analysis, int firstInput, int endInput,
+    const char * outputPath, StreamStats * stats )
+{
+    const InputList * inputs = &options->inputs;
+    Checkpoint checkpoint;
+    FILE * output = NULL;
+    FILE * input;
+    boolean checkpointing = 0 < options->checkpointEvery;
+    boolean resumed = false;
+    boolean success = true;
+    int i;
+
+    memset( &checkpoint, 0, sizeof( Checkpoint ) );
+    snprintf( checkpoint.path, sizeof( checkpoint.path ), "%.*s.ckpt", MAX_INPUT_PATH - 6, outputPath );
+    checkpoint.every = options->checkpointEvery;
+    checkpoint.input = firstInput;
+    if( checkpointing && options->resume && loadCheckpoint( &checkpoint ) )
+    {
+        if( checkpoint.input < firstInput || checkpoint.input > endInput
+            || ( checkpoint.input < endInput && 0 != strcmp( checkpoint.inputPath, inputs->paths[checkpoint.input] ) ) )
+        {
+            fprintf( stderr, "reversi: checkpoint '%s' does not match the inputs\n", checkpoint.path );
+            success = false;
+        }
+        else
+        {
+            output = fopen( outputPath, "r+" );
+            if( NULL == output || 0 != ftruncate( fileno( output ), checkpoint.outputSize ) || 0 != fseek( output, 0, SEEK_END ) )
+            {
+                fprintf( stderr, "reversi: cannot resume '%s': %s\n", outputPath, strerror( errno ) );
+                success = false;
+            }
+            else
+            {
+                resumed = true;
+                fprintf( stderr, "%s: resuming after %d board(s)\n", outputPath, checkpoint.nBoards );
+            }
+        }
+    }
+    else
+    {
+        output = fopen( outputPath, "w" );
+        if( NULL == output )
+        {
+            fprintf( stderr, "reversi: cannot create '%s': %s\n", outputPath, strerror( errno ) );
+            success = false;
+        }
+    }
+
+    if( success && !( resumed && checkpoint.input == endInput ) )
+    {   // a finished run has nothing left to do, not even the trailer
+        for( i = checkpoint.input; success && i < endInput; i++ )
+        {
+            input = 0 == strcmp( inputs->paths[i], "-" ) ? stdin : fopen( inputs->paths[i], "r" );
+            if( NULL == input )
+            {
+                fprintf( stderr, "reversi: cannot open '%s': %s\n", inputs->paths[i], strerror( errno ) );
+                success = false;
+                break;
+            }
+            if( !resumed || i != checkpoint.input )
+            {
+                checkpoint.input = i;
+                checkpoint.offset = 0;
+                checkpoint.ordinal = 0;
+            }
+            snprintf( checkpoint.inputPath, sizeof( checkpoint.inputPath ), "%s", inputs->paths[i] );
+            if( checkpointing && ( ftell( input ) < 0 || 0 != fseek( input, checkpoint.offset, SEEK_SET ) ) )
+            {
+                fprintf( stderr, "reversi: checkpoints need a seekable input, '%s' is not\n", inputs->paths[i] );
+                success = false;
+            }
+            else
+            {
+                processStream( options, analysis, i, input, output, &stats[i], checkpointing ? &checkpoint : NULL, NULL );
+            }
+            if( stdin != input )
+            {
+                fclose( input );
+            }
+        }
+        if( success && 0 == options->nShards )
+        {   // shard outputs get their trailer back from mergeShards()
+            fprintf( output, END_OF_PROCESSING );
+        }
+        if( success && checkpointing )
+        {
+            checkpoint.input = endInput;
+            checkpoint.offset = 0;
+            checkpoint.ordinal = 0;
+            checkpoint.inputPath[0] = '\0';
+            success = saveCheckpoint( &checkpoint, output );
+        }
+    }
+    if( NULL != output && 0 != fclose( output ) )
+    {
+        success = false;
+    }
+    return success;
+}
+
+
+boolean saveCheckpoint( Checkpoint * checkpoint, FILE * output )
+{
+    char temporary[MAX_INPUT_PATH + 8];
+    FILE * file;
+    boolean success = false;
+
+    checkpoint->sinceSaved = 0;
+    if( 0 == fflush( output ) && 0 == fsync( fileno( output ) ) && 0 <= ( checkpoint->outputSize = ftell( output ) ) )
+    {
+        snprintf( temporary, sizeof( temporary ), "%s.tmp", checkpoint->path );
+        file = fopen( temporary, "w" );
+        if( NULL != file )
+        {
+            fprintf( file, "%s\ninput %d\noffset %ld\nordinal %d\nboards %d\noutput %ld\npath %s\n",
+                CHECKPOINT_MAGIC,
+                checkpoint->input,
+                checkpoint->offset,
+                checkpoint->ordinal,
+                checkpoint->nBoards,
+                checkpoint->outputSize,
+                checkpoint->inputPath );
+            success = 0 == fflush( file ) && 0 == fsync( fileno( file ) );
+            success = 0 == fclose( file ) && success;
+            success = success && 0 == rename( temporary, checkpoint->path );
+        }
+    }
+    if( !success )
+    {
+        fprintf( stderr, "reversi: cannot save checkpoint '%s': %s\n", checkpoint->path, strerror( errno ) );
+    }
+    return success;
+}
+
+
+boolean loadCheckpoint( Checkpoint * checkpoint )
+{
+    char line[MAX_INPUT_PATH + 16];
+    FILE * file = fopen( checkpoint->path, "r" );
+    int length;
+    int nFields = 0;
+
+    if( NULL != file )
+    {
+        if( NULL != fgets( line, sizeof( line ), file ) && 0 == strncmp( line, CHECKPOINT_MAGIC, strlen( CHECKPOINT_MAGIC ) ) )
+        {
+            nFields += 1 == fscanf( file, " input %d", &checkpoint->input );
+            nFields += 1 == fscanf( file, " offset %ld", &checkpoint->offset );
+            nFields += 1 == fscanf( file, " ordinal %d", &checkpoint->ordinal );
+            nFields += 1 == fscanf( file, " boards %d", &checkpoint->nBoards );
+            nFields += 1 == fscanf( file, " output %ld\n", &checkpoint->outputSize );
+            if( NULL != fgets( line, sizeof( line ), file ) && 0 == strncmp( line, "path ", 5 ) )
+            {
+                length = strlen( line );
+                if( length > 0 && '\n' == line[length - 1] )
+                {
+                    line[length - 1] = '\0';
+                }
+                snprintf( checkpoint->inputPath, sizeof( checkpoint->inputPath ), "%.*s", MAX_INPUT_PATH - 1, line + 5 );
+                nFields++;
+            }
+        }
+        fclose( file );
+    }
+    return 6 == nFields;
+}
+
+
+boolean isShardOwned( const Options * options, int ordinal )
+{
+    int unit = options->shardByChunk ? ordinal / options->chunkSize : ordinal;
+
+    return 0 == options->nShards || options->shardIndex == unit % options->nShards;
+}
+
+
+void readShardRecord( ShardReader * reader )
+{
+    size_t tagLength = strlen( SHARD_RECORD_TAG );
+    size_t endLength = strlen( SHARD_END_TAG );
+    char * grown;
+    int * grownBoards;
+    int shard, nShards, input, nBoards;
+
+    reader->hasRecord = false;
+    while( 0 <= getline( &reader->line, &reader->lineCapacity, reader->file ) )
+    {   // skip anything before the next tag
+        if( 0 == strncmp( reader->line, SHARD_END_TAG, endLength )
+            && 4 == sscanf( reader->line + endLength, "%d/%d %d %d", &shard, &nShards, &input, &nBoards )
+            && 0 <= input )
+        {
+            reader->mismatched = reader->mismatched || ( 0 < reader->nShards
+                && ( shard != reader->shard || nShards != reader->nShards ) );
+            reader->shard = shard;
+            reader->nShards = nShards;
+            if( input >= reader->nInputs )
+            {
+                grownBoards = realloc( reader->inputBoards, ( input + 1 ) * sizeof( int ) );
+                assert( NULL != grownBoards );
+                reader->inputBoards = grownBoards;
+                for( ; reader->nInputs <= input; reader->nInputs++ )
+                {
+                    reader->inputBoards[reader->nInputs] = -1;
+                }
+            }
+            reader->inputBoards[input] = nBoards;
+            continue;
+        }
+        if( 0 == strncmp( reader->line, SHARD_RECORD_TAG, tagLength )
+            && 5 == sscanf( reader->line + tagLength, "%d/%d %d %d %zu", &shard, &nShards, &reader->input,
+                &reader->ordinal, &reader->length ) )
+        {
+            reader->mismatched = reader->mismatched || ( 0 < reader->nShards
+                && ( shard != reader->shard || nShards != reader->nShards ) );
+            reader->shard = shard;
+            reader->nShards = nShards;
+            if( reader->length > reader->capacity )
+            {
+                reader->capacity = 2 * reader->length;
+                grown = realloc( reader->body, reader->capacity );
+                assert( NULL != grown );
+                reader->body = grown;
+            }
+            reader->hasRecord = reader->length == fread( reader->body, 1, reader->length, reader->file );
+            reader->truncated = !reader->hasRecord;
+            if( reader->truncated )
+            {
+                fprintf( stderr, "reversi: record %d of input %d is truncated\n", reader->ordinal, reader->input );
+            }
+            break;
+        }
+    }
+}
+
+
+boolean mergeShards( const Options * options )
+{
+    const InputList * inputs = &options->inputs;
+    ShardReader * readers = calloc( inputs->nPaths, sizeof( ShardReader ) );
+    ShardReader * next;
+    boolean * seenShards = NULL;
+    int * nMerged = NULL;   // records merged per input
+    int * grown;
+    int lastInput = -1;
+    int lastOrdinal = -1;
+    int nRecords = 0;
+    int nInputs = 0;
+    int i, input, nBoards, other;
+    boolean success = NULL != readers;
+
+    for( i = 0; success && i < inputs->nPaths; i++ )
+    {
+        readers[i].file = 0 == strcmp( inputs->paths[i], "-" ) ? stdin : fopen( inputs->paths[i], "r" );
+        if( NULL == readers[i].file )
+        {
+            fprintf( stderr, "reversi: cannot open '%s': %s\n", inputs->paths[i], strerror( errno ) );
+            success = false;
+        }
+        else
+        {
+            readShardRecord( &readers[i] );
+        }
+    }
+    while( success )
+    {
+        next = NULL;
+        for( i = 0; i < inputs->nPaths; i++ )
+        {
+            if( readers[i].hasRecord && ( NULL == next || readers[i].input < next->input
+                || ( readers[i].input == next->input && readers[i].ordinal < next->ordinal ) ) )
+            {
+                next = &readers[i];
+            }
+        }
+        if( NULL == next )
+        {
+            for( i = 0; i < inputs->nPaths; i++ )
+            {
+                success = success && !readers[i].truncated;
+            }
+            break;
+        }
+        if( next->input < lastInput || ( next->input == lastInput && next->ordinal <= lastOrdinal ) )
+        {
+            fprintf( stderr, "reversi: record %d of input %d appears twice or out of order\n", next->ordinal, next->input );
+            success = false;
+        }
+        else if( next->ordinal != ( next->input == lastInput ? lastOrdinal + 1 : 0 ) )
+        {
+            fprintf( stderr, "reversi: record %d of input %d is missing\n",
+                next->input == lastInput ? lastOrdinal + 1 : 0, next->input );
+            success = false;
+        }
+        else
+        {
+            fwrite( next->body, 1, next->length, stdout );
+            if( next->input >= nInputs )
+            {
+                grown = realloc( nMerged, ( next->input + 1 ) * sizeof( int ) );
+                assert( NULL != grown );
+                nMerged = grown;
+                memset( nMerged + nInputs, 0, ( next->input + 1 - nInputs ) * sizeof( int ) );
+                nInputs = next->input + 1;
+            }
+            nMerged[next->input]++;
+            lastInput = next->input;
+            lastOrdinal = next->ordinal;
+            nRecords++;
+            readShardRecord( next );
+        }
+    }
+
+    // every shard of the run once, and every input complete according to all of them
+    if( success && ( 0 >= readers[0].nShards || inputs->nPaths != readers[0].nShards ) )
+    {
+        fprintf( stderr, "reversi: %d shard output(s) given, the run had %d shard(s)\n",
+            inputs->nPaths, readers[0].nShards );
+        success = false;
+    }
+    if( success )
+    {
+        seenShards = calloc( readers[0].nShards, sizeof( boolean ) );
+        assert( NULL != seenShards );
+    }
+    for( i = 0; success && i < inputs->nPaths; i++ )
+    {
+        if( readers[i].mismatched || readers[i].nShards != readers[0].nShards
+            || readers[i].shard < 0 || readers[i].shard >= readers[0].nShards || seenShards[readers[i].shard] )
+        {
+            fprintf( stderr, "reversi: '%s' is not the output of another shard of the same run\n", inputs->paths[i] );
+            success = false;
+        }
+        else
+        {
+            seenShards[readers[i].shard] = true;
+        }
+        if( readers[i].nInputs > nInputs )
+        {   // inputs without boards merge nothing
+            grown = realloc( nMerged, readers[i].nInputs * sizeof( int ) );
+            assert( NULL != grown );
+            nMerged = grown;
+            memset( nMerged + nInputs, 0, ( readers[i].nInputs - nInputs ) * sizeof( int ) );
+            nInputs = readers[i].nInputs;
+        }
+    }
+    for( input = 0; success && input < nInputs; input++ )
+    {
+        nBoards = input < readers[0].nInputs ? readers[0].inputBoards[input] : -1;
+        for( i = 1; success && i < inputs->nPaths; i++ )
+        {
+            other = input < readers[i].nInputs ? readers[i].inputBoards[input] : -1;
+            if( other != nBoards )
+            {
+                fprintf( stderr, "reversi: '%s' and '%s' disagree on the boards of input %d; is one unfinished?\n",
+                    inputs->paths[0], inputs->paths[i], input );
+                success = false;
+            }
+        }
+        if( success && ( nBoards < 0 ? 0 < nMerged[input] : nMerged[input] != nBoards ) )
+        {
+            fprintf( stderr, "reversi: %d of %d record(s) of input %d merged\n", nMerged[input], nBoards, input );
+            success = false;
+        }
+    }
+    if( success )
+    {
+        printf( END_OF_PROCESSING );
+        fprintf( stderr, "merged %d record(s) from %d shard output(s)\n", nRecords, inputs->nPaths );
+    }
+    for( i = 0; NULL != readers && i < inputs->nPaths; i++ )
+    {
+        if( NULL != readers[i].file && stdin != readers[i].file )
+        {
+            fclose( readers[i].file );
+        }
+        free( readers[i].body );
+        free( readers[i].line );
+        free( readers[i].inputBoards );
+    }
+    free( readers );
+    free( seenShards );
+    free( nMerged );
+    return success;
+}
+
+
+void processInputJob( void * context, int index, int thread )
+{
+    BatchContext * batch = context;
+    const Options * options = batch->options;
+    const char * path = options->inputs.paths[index];
+    char outputPath[MAX_INPUT_PATH];
+    FILE * input;
+    FILE * output = NULL;
+
+    (void)thread;
+    if( NULL != options->outputDir )
+    {
+        makeOutputPath( options->outputDir, path, ".out", outputPath );
+        batch->succeeded[index] = processSink( options, &batch->analysis, index, index + 1, outputPath, batch->stats );
+    }
+    else
+    {
+        input = 0 == strcmp( path, "-" ) ? stdin : fopen( path, "r" );
+        if( NULL == input )
+        {
+            fprintf( stderr, "reversi: cannot open '%s': %s\n", path, strerror( errno ) );
+        }
+        else if( 1 == options->inputs.nPaths )
+        {   // a single input streams straight through
+            processStream( options, &batch->analysis, index, input, batch->output, &batch->stats[index], NULL, NULL );
+            batch->succeeded[index] = true;
+        }
+        else
+        {   // buffered while earlier inputs are still being written, then streamed
+            output = openOrderedItem( &batch->combined, index );
+            if( NULL != output )
+            {
+                output = processStream( options, &batch->analysis, index, input, output, &batch->stats[index], NULL,
+                    &batch->combined );
+                batch->succeeded[index] = closeOrderedItem( &batch->combined, index, output );
+            }
+        }
+        if( NULL != input && stdin != input )
+        {
+            fclose( input );
+        }
+        if( 1 < options->inputs.nPaths && NULL == output )
+        {   // always submit, even on failure, so later inputs are not held back
+            submitOrderedOutput( &batch->combined, index, NULL, 0 );
+        }
+    }
+}
+
+
+boolean runBatch( const Options * options )
+{
+    BatchContext batch;
+    const InputList * inputs = &options->inputs;
+    boolean success = true;
+    boolean reportStats;
+    int nBoards = 0;
+    double seconds, start = currentSeconds( );
+    int i;
+
+    memset( &batch, 0, sizeof( BatchContext ) );
+    batch.options = options;
+    batch.stats = calloc( inputs->nPaths, sizeof( StreamStats ) );
+    batch.succeeded = calloc( inputs->nPaths, sizeof( boolean ) );
+    assert( NULL != batch.stats && NULL != batch.succeeded );
+    batch.output = stdout;
+    if( !openAnalysis( options, &batch.analysis ) )
+    {
+        success = false;
+    }
+    else if( NULL != options->outputDir && !checkOutputPaths( options ) )
+    {
+        success = false;
+    }
+    else if( NULL != options->outputDir && 0 != mkdir( options->outputDir, 0777 ) && EEXIST != errno )
+    {
+        fprintf( stderr, "reversi: cannot create '%s': %s\n", options->outputDir, strerror( errno ) );
+        success = false;
+    }
+    else if( NULL == options->outputDir && NULL != options->outputFile && 0 < options->checkpointEvery )
+    {   // one checkpointed stream: the inputs have to be read one after another
+        success = processSink( options, &batch.analysis, 0, inputs->nPaths, options->outputFile, batch.stats );
+        for( i = 0; i < inputs->nPaths; i++ )
+        {
+            batch.succeeded[i] = success;
+        }
+    }
+    else if( NULL == options->outputDir && NULL != options->outputFile
+        && NULL == ( batch.output = fopen( options->outputFile, "w" ) ) )
+    {
+        fprintf( stderr, "reversi: cannot create '%s': %s\n", options->outputFile, strerror( errno ) );
+        success = false;
+    }
+    else
+    {
+        success = initOrderedOutput( &batch.combined, batch.output, inputs->nPaths )
+            && runWorkerPool( options->nThreads, inputs->nPaths, processInputJob, &batch );
+        freeOrderedOutput( &batch.combined );
+        if( NULL == options->outputDir && 0 == options->nShards )
+        {
+            fprintf( batch.output, END_OF_PROCESSING );
+        }
+        if( stdout != batch.output && 0 != fclose( batch.output ) )
+        {
+            success = false;
+        }
+    }
+    if( success )
+    {
+        // per-input statistics go to standard error so they never mix with results
+        reportStats = 1 < inputs->nPaths || 0 != strcmp( inputs->paths[0], "-" );
+        for( i = 0; i < inputs->nPaths; i++ )
+        {
+            success = success && batch.succeeded[i];
+            nBoards += batch.stats[i].nBoards;
+            if( reportStats )
+            {
+                fprintf( stderr, "%s: %d board(s) in %.3f s (%.1f boards/s)\n",
+                    inputs->paths[i],
+                    batch.stats[i].nBoards,
+                    batch.stats[i].seconds,
+                    batch.stats[i].seconds > 0 ? batch.stats[i].nBoards / batch.stats[i].seconds : 0.0 );
+            }
+        }
+        if( 1 < inputs->nPaths )
+        {
+            seconds = currentSeconds( ) - start;
+            fprintf( stderr, "total: %d board(s) from %d input(s) in %.3f s (%.1f boards/s)\n",
+                nBoards, inputs->nPaths, seconds, seconds > 0 ? nBoards / seconds : 0.0 );
+        }
+    }
+    closeAnalysis( &batch.analysis );
+    free( batch.stats );
+    free( batch.succeeded );
+    return success;
+}
+
+
+void makeOutputPath( const char * outputDir, const char * inputPath, const char * suffix, char * path )
+{
+    int length;
+
+    if( 0 == strcmp( inputPath, "-" ) )
+    {
+        inputPath = "stdin";
+    }
+    while( '.' == inputPath[0] && '/' == inputPath[1] )
+    {   // drop leading "./"
+        inputPath += 2;
+    }
+    while( '/' == inputPath[0] )
+    {
+        inputPath++;
+    }
+    length = snprintf( path, MAX_INPUT_PATH, "%s/", outputDir );
+    for( ; '\0' != *inputPath && length < MAX_INPUT_PATH - 1; inputPath++ )
+    {
+        path[length++] = '/' == *inputPath ? '_' : *inputPath;
+    }
+    path[length] = '\0';
+    strncat( path, suffix, MAX_INPUT_PATH - length - 1 );
+}
+
+
+int compareOutputNames( const void * left, const void * right )
+{
+    const OutputName * a = left;
+    const OutputName * b = right;
+    int order = strcmp( a->path, b->path );
+
+    return 0 != order ? order : a->input - b->input;
+}
+
+
+boolean checkOutputPaths( const Options * options )
+{
+    const InputList * inputs = &options->inputs;
+    OutputName * names = calloc( inputs->nPaths, sizeof( OutputName ) );
+    int i;
+    boolean success = true;
+
+    assert( NULL != names );
+    for( i = 0; i < inputs->nPaths; i++ )
+    {
+        names[i].path = malloc( MAX_INPUT_PATH );
+        assert( NULL != names[i].path );
+        makeOutputPath( options->outputDir, inputs->paths[i], ".out", names[i].path );
+        names[i].input = i;
+    }
+    qsort( names, inputs->nPaths, sizeof( OutputName ), compareOutputNames );
+    for( i = 1; i < inputs->nPaths; i++ )
+    {
+        if( 0 == strcmp( names[i - 1].path, names[i].path ) )
+        {
+            fprintf( stderr, "reversi: '%s' and '%s' would both be written to '%s'\n",
+                inputs->paths[names[i - 1].input], inputs->paths[names[i].input], names[i].path );
+            success = false;
+        }
+    }
+    for( i = 0; i < inputs->nPaths; i++ )
+    {
+        free( names[i].path );
+    }
+    free( names );
+    return success;
+}
+
+
+double currentSeconds( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+void writeGameBoard( FILE * output, const GameBoard * board )
+{
+    int col, row;
+
+    fprintf( output, "%s\n", board->title );
+    fprintf( output, "%d %d %c\n", board->nColumns, board->nRows, WHITE == board->player ? 'W' : 'B' );
+    for( row = 0; row < board->nRows; row++ )
+    {
+        for( col = 0; col < board->nColumns; col++ )
+        {
+            fputc( BLACK == board->state[row][col] ? 'B' : WHITE == board->state[row][col] ? 'W' : ' ', output );
+        }
+        fputc( '\n', output );
+    }
+    fputc( '\n', output );
+}
+
+
+boolean parseHostPort( const char * argument, char * host, int * port )
+{
+    const char * colon = strrchr( argument, ':' );
+    int length;
+
+    if( NULL != colon )
+    {
+        length = colon - argument;
+        if( length >= LINE_MAX )
+        {
+            length = LINE_MAX - 1;
+        }
+        memcpy( host, argument, length );
+        host[length] = '\0';
+        argument = colon + 1;
+    }
+    *port = atoi( argument );
+    return 0 < *port && *port < 65536;
+}
+
+
+boolean sendAll( int fd, const void * data, size_t size )
+{
+    const char * bytes = data;
+    ssize_t sent;
+
+    while( size > 0 )
+    {
+        sent = send( fd, bytes, size, MSG_NOSIGNAL );
+        if( sent < 0 && EINTR == errno )
+        {
+            continue;
+        }
+        if( sent <= 0 )
+        {
+            return false;
+        }
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+
+boolean readFarmChunk( const Options * options, int * inputIndex, FILE ** input, FarmChunk * chunk )
+{
+    const InputList * inputs = &options->inputs;
+    GameBoard board;
+    FILE * text;
+
+    memset( chunk, 0, sizeof( FarmChunk ) );
+    text = open_memstream( &chunk->text, &chunk->size );
+    assert( NULL != text );
+    while( chunk->nBoards < options->chunkSize && *inputIndex < inputs->nPaths )
+    {
+        if( NULL == *input )
+        {
+            *input = 0 == strcmp( inputs->paths[*inputIndex], "-" ) ? stdin : fopen( inputs->paths[*inputIndex], "r" );
+            if( NULL == *input )
+            {
+                fprintf( stderr, "reversi: cannot open '%s': %s\n", inputs->paths[*inputIndex], strerror( errno ) );
+                ( *inputIndex )++;
+                continue;
+            }
+        }
+        if( readGameBoard( *input, &board ) )
+        {
+            writeGameBoard( text, &board );
+            chunk->nBoards++;
+        }
+        else
+        {   // this input is exhausted; carry on with the next one
+            if( stdin != *input )
+            {
+                fclose( *input );
+            }
+            *input = NULL;
+            ( *inputIndex )++;
+        }
+    }
+    fclose( text );
+    if( 0 == chunk->nBoards )
+    {
+        free( chunk->text );
+        chunk->text = NULL;
+    }
+    return 0 < chunk->nBoards;
+}
+
+
+boolean receiveFarmMessages( FarmWorker * worker, FarmChunk * chunks, int nChunks )
+{
+    char * newline;
+    size_t headerLength, payloadSize;
+    int id, nBoards;
+    boolean success = true;
+
+    while( success && NULL != ( newline = memchr( worker->buffer, '\n', worker->length ) ) )
+    {
+        headerLength = newline - worker->buffer + 1;
+        if( 0 == strncmp( worker->buffer, "HEARTBEAT\n", headerLength ) )
+        {
+            payloadSize = 0;
+        }
+        else if( 3 == sscanf( worker->buffer, "RESULT %d %d %zu", &id, &nBoards, &payloadSize ) && 0 <= id && id < nChunks )
+        {
+            if( worker->length < headerLength + payloadSize )
+            {
+                break; // wait for the rest of the payload
+            }
+            if( !chunks[id].done )
+            {
+                chunks[id].result = malloc( payloadSize + 1 );
+                assert( NULL != chunks[id].result );
+                memcpy( chunks[id].result, worker->buffer + headerLength, payloadSize );
+                chunks[id].resultSize = payloadSize;
+                chunks[id].done = true;
+                free( chunks[id].text );
+                chunks[id].text = NULL;
+            }
+            if( worker->chunk == id )
+            {
+                worker->chunk = -1;
+            }
+        }
+        else
+        {
+            success = false;
+            break;
+        }
+        memmove( worker->buffer, worker->buffer + headerLength + payloadSize, worker->length - headerLength - payloadSize );
+        worker->length -= headerLength + payloadSize;
+    }
+    return success;
+}
+
+
+boolean runCoordinator( const Options * options )
+{
+    FarmWorker workers[MAX_FARM_WORKERS];
+    struct pollfd fds[MAX_FARM_WORKERS + 1];
+    pid_t children[MAX_FARM_WORKERS];
+    struct sockaddr_in address;
+    FarmChunk * chunks = NULL;
+    FarmChunk * grown;
+    FILE * input = NULL;
+    Options workerOptions;
+    char header[LINE_MAX];
+    char * grownBuffer;
+    ssize_t received;
+    int inputIndex = 0;
+    int nChunks = 0, chunkCapacity = 0, nextToWrite = 0;
+    int nWorkers = 0, nChildren = 0, nLiveChildren;
+    int nBoards = 0, nReassigned = 0, nStolen = 0;
+    int listener, fd, i, j, id, oldest;
+    int yes = 1;
+    int * pending = NULL;
+    int nPending = 0;
+    boolean inputDone = false;
+    boolean success = false;
+    double now, start = currentSeconds( );
+
+    listener = socket( AF_INET, SOCK_STREAM, 0 );
+    memset( &address, 0, sizeof( address ) );
+    address.sin_family = AF_INET;
+    address.sin_port = htons( options->farmPort );
+    if( 1 != inet_pton( AF_INET, options->farmHost, &address.sin_addr ) )
+    {
+        fprintf( stderr, "reversi: coordinator needs a numeric IPv4 address, not '%s'\n", options->farmHost );
+    }
+    else if( listener < 0
+        || 0 != setsockopt( listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof( yes ) )
+        || 0 != bind( listener, (struct sockaddr *)&address, sizeof( address ) )
+        || 0 != listen( listener, MAX_FARM_WORKERS ) )
+    {
+        fprintf( stderr, "reversi: cannot listen on %s:%d: %s\n", options->farmHost, options->farmPort, strerror( errno ) );
+    }
+    else
+    {
+        success = true;
+        signal( SIGPIPE, SIG_IGN );
+        fprintf( stderr, "coordinator listening on %s:%d\n", options->farmHost, options->farmPort );
+    }
+
+    // local workers connect back over loopback
+    workerOptions = *options;
+    workerOptions.mode = MODE_WORKER;
+    if( 0 == strcmp( workerOptions.farmHost, "0.0.0.0" ) )
+    {
+        strcpy( workerOptions.farmHost, DEFAULT_FARM_HOST );
+    }
+    fflush( stdout );
+    fflush( stderr );
+    for( i = 0; success && i < options->nSpawnWorkers; i++ )
+    {
+        children[nChildren] = fork( );
+        if( 0 == children[nChildren] )
+        {
+            close( listener );
+            _exit( runWorker( &workerOptions ) ? EXIT_SUCCESS : EXIT_FAILURE );
+        }
+        if( children[nChildren] > 0 )
+        {
+            nChildren++;
+        }
+    }
+    nLiveChildren = nChildren;
+
+    while( success && ( !inputDone || nextToWrite < nChunks ) )
+    {
+        fds[0].fd = listener;
+        fds[0].events = nWorkers < MAX_FARM_WORKERS ? POLLIN : 0; // a full farm leaves connections queued
+        fds[0].revents = 0;
+        for( i = 0; i < nWorkers; i++ )
+        {
+            fds[i + 1].fd = workers[i].fd;
+            fds[i + 1].events = POLLIN;
+            fds[i + 1].revents = 0;
+        }
+        if( poll( fds, nWorkers + 1, 100 ) < 0 && EINTR != errno )
+        {
+            success = false;
+            break;
+        }
+        now = currentSeconds( );
+        for( i = 0; i < nChildren; i++ )
+        {
+            if( children[i] > 0 && waitpid( children[i], NULL, WNOHANG ) > 0 )
+            {
+                children[i] = -1;
+                nLiveChildren--;
+            }
+        }
+
+        if( ( fds[0].revents & POLLIN ) && nWorkers < MAX_FARM_WORKERS )
+        {
+            fd = accept( listener, NULL, NULL );
+            if( fd >= 0 )
+            {   // messages are small request/response pairs: do not let Nagle hold them back
+                setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof( yes ) );
+                memset( &workers[nWorkers], 0, sizeof( FarmWorker ) );
+                workers[nWorkers].fd = fd;
+                workers[nWorkers].chunk = -1;
+                workers[nWorkers].lastSeen = now;
+                fds[nWorkers + 1].fd = fd; // not polled this round: nothing to read yet
+                fds[nWorkers + 1].events = POLLIN;
+                fds[nWorkers + 1].revents = 0;
+                nWorkers++;
+            }
+        }
+
+        // read what the workers sent, and drop the ones which died or went silent
+        for( i = 0; i < nWorkers; i++ )
+        {
+            received = 1;
+            if( fds[i + 1].revents & ( POLLIN | POLLHUP | POLLERR ) )
+            {
+                if( workers[i].capacity - workers[i].length < LINE_MAX )
+                {
+                    workers[i].capacity = 2 * workers[i].capacity + LINE_MAX;
+                    grownBuffer = realloc( workers[i].buffer, workers[i].capacity );
+                    assert( NULL != grownBuffer );
+                    workers[i].buffer = grownBuffer;
+                }
+                received = recv( workers[i].fd, workers[i].buffer + workers[i].length,
+                    workers[i].capacity - workers[i].length, 0 );
+                if( received > 0 )
+                {
+                    workers[i].length += received;
+                    workers[i].lastSeen = now;
+                    if( !receiveFarmMessages( &workers[i], chunks, nChunks ) )
+                    {
+                        received = 0;
+                    }
+                }
+            }
+            if( received <= 0 || now - workers[i].lastSeen > options->heartbeatTimeout )
+            {
+                fprintf( stderr, "coordinator: worker %d lost%s\n", workers[i].fd,
+                    received <= 0 ? "" : " (no heartbeat)" );
+                id = workers[i].chunk;
+                if( 0 <= id && !chunks[id].done )
+                {
+                    chunks[id].nAssigned--;
+                    if( 0 == chunks[id].nAssigned )
+                    {   // nobody else holds it: give it to the next idle worker
+                        pending[nPending++] = id;
+                        nReassigned++;
+                    }
+                }
+                close( workers[i].fd );
+                free( workers[i].buffer );
+                workers[i] = workers[nWorkers - 1];
+                fds[i + 1] = fds[nWorkers];
+                nWorkers--;
+                i--;
+            }
+        }
+
+        // write finished chunks in their original order
+        while( nextToWrite < nChunks && chunks[nextToWrite].done )
+        {
+            fwrite( chunks[nextToWrite].result, 1, chunks[nextToWrite].resultSize, stdout );
+            free( chunks[nextToWrite].result );
+            chunks[nextToWrite].result = NULL;
+            nBoards += chunks[nextToWrite].nBoards;
+            nextToWrite++;
+        }
+        if( 0 == nWorkers && 0 < options->nSpawnWorkers && 0 == nLiveChildren
+            && ( !inputDone || nextToWrite < nChunks ) )
+        {   // a farm of spawned workers only: nobody is left to connect
+            fprintf( stderr, "reversi: every spawned worker exited with work left after %d chunk(s)\n", nextToWrite );
+            success = false;
+            break;
+        }
+
+        // hand out work: reassigned chunks first, then fresh ones, then steal
+        for( i = 0; i < nWorkers; i++ )
+        {
+            if( workers[i].chunk >= 0 )
+            {
+                continue;
+            }
+            id = -1;
+            while( 0 < nPending && id < 0 )
+            {
+                id = pending[--nPending];
+                if( chunks[id].done )
+                {
+                    id = -1;
+                }
+            }
+            if( id < 0 && !inputDone )
+            {
+                if( nChunks == chunkCapacity )
+                {
+                    chunkCapacity = 0 == chunkCapacity ? 64 : 2 * chunkCapacity;
+                    grown = realloc( chunks, chunkCapacity * sizeof( FarmChunk ) );
+                    assert( NULL != grown );
+                    chunks = grown;
+                    pending = realloc( pending, chunkCapacity * sizeof( int ) );
+                    assert( NULL != pending );
+                }
+                if( readFarmChunk( options, &inputIndex, &input, &chunks[nChunks] ) )
+                {
+                    id = nChunks++;
+                }
+                else
+                {
+                    inputDone = true;
+                }
+            }
+            if( id < 0 )
+            {
+                oldest = -1;
+                for( j = nextToWrite; j < nChunks; j++ )
+                {
+                    if( !chunks[j].done && 1 == chunks[j].nAssigned
+                        && ( oldest < 0 || chunks[j].assignedAt < chunks[oldest].assignedAt ) )
+                    {
+                        oldest = j;
+                    }
+                }
+                if( oldest >= 0 )
+                {
+                    id = oldest;
+                    nStolen++;
+                }
+            }
+            if( id >= 0 )
+            {
+                snprintf( header, sizeof( header ), "CHUNK %d %zu\n", id, chunks[id].size );
+                workers[i].chunk = id;
+                chunks[id].nAssigned++;
+                chunks[id].assignedAt = now;
+                if( !sendAll( workers[i].fd, header, strlen( header ) )
+                    || !sendAll( workers[i].fd, chunks[id].text, chunks[id].size ) )
+                {   // the worker is dropped by the next poll round
+                    workers[i].lastSeen = 0;
+                }
+            }
+        }
+    }
+
+    if( success )
+    {
+        printf( END_OF_PROCESSING );
+        fflush( stdout );
+        now = currentSeconds( ) - start;
+        fprintf( stderr, "coordinator: %d board(s) in %d chunk(s) in %.3f s (%.1f boards/s), %d reassigned, %d stolen\n",
+            nBoards, nChunks, now, now > 0 ? nBoards / now : 0.0, nReassigned, nStolen );
+    }
+    for( i = 0; i < nWorkers; i++ )
+    {
+        sendAll( workers[i].fd, "QUIT\n", 5 );
+        close( workers[i].fd );
+        free( workers[i].buffer );
+    }
+    for( i = 0; i < nChildren; i++ )
+    {
+        if( children[i] > 0 )
+        {
+            waitpid( children[i], NULL, 0 );
+        }
+    }
+    for( i = 0; i < nChunks; i++ )
+    {
+        free( chunks[i].text );
+        free( chunks[i].result );
+    }
+    free( chunks );
+    free( pending );
+    if( NULL != input && stdin != input )
+    {
+        fclose( input );
+    }
+    if( listener >= 0 )
+    {
+        close( listener );
+    }
+    return success;
+}
+
+
+void * heartbeatThread( void * argument )
+{
+    HeartbeatContext * heartbeat = argument;
+    struct timespec pause;
+    double next = currentSeconds( ) + heartbeat->interval;
+
+    pause.tv_sec = 0;
+    pause.tv_nsec = 20 * 1000 * 1000;
+    while( !heartbeat->stop )
+    {
+        nanosleep( &pause, NULL );
+        if( currentSeconds( ) >= next )
+        {
+            pthread_mutex_lock( heartbeat->writeLock );
+            sendAll( heartbeat->fd, "HEARTBEAT\n", 10 );
+            pthread_mutex_unlock( heartbeat->writeLock );
+            next += heartbeat->interval;
+        }
+    }
+    return NULL;
+}
+
+
+boolean runWorker( const Options * options )
+{
+    struct addrinfo hints;
+    struct addrinfo * found = NULL;
+    pthread_mutex_t writeLock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_t beater;
+    HeartbeatContext heartbeat;
+    AnalysisContext analysis;
+    StreamStats stats;
+    Options streamOptions = *options;
+    FILE * connection = NULL;
+    FILE * input;
+    FILE * output;
+    char service[16];
+    char header[LINE_MAX];
+    char * text = NULL;
+    char * result = NULL;
+    size_t size, resultSize;
+    int fd = -1, readFd, id;
+    int yes = 1;
+    boolean analyzing = false;
+    boolean beating = false;
+    boolean success = false;
+
+    memset( &hints, 0, sizeof( hints ) );
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf( service, sizeof( service ), "%d", options->farmPort );
+    if( 0 == getaddrinfo( options->farmHost, service, &hints, &found ) )
+    {
+        fd = socket( found->ai_family, found->ai_socktype, found->ai_protocol );
+        if( fd >= 0 && 0 != connect( fd, found->ai_addr, found->ai_addrlen ) )
+        {
+            close( fd );
+            fd = -1;
+        }
+        freeaddrinfo( found );
+    }
+    if( fd < 0 )
+    {
+        fprintf( stderr, "reversi: cannot reach coordinator %s:%d\n", options->farmHost, options->farmPort );
+    }
+    else if( !openAnalysis( options, &analysis ) )
+    {
+        close( fd );
+        fd = -1;
+    }
+    else
+    {
+        analyzing = true;
+        readFd = dup( fd );
+        connection = readFd >= 0 ? fdopen( readFd, "r" ) : NULL;
+    }
+    if( analyzing && NULL == connection )
+    {
+        fprintf( stderr, "reversi: cannot read from coordinator %s:%d: %s\n", options->farmHost, options->farmPort,
+            strerror( errno ) );
+        if( readFd >= 0 )
+        {
+            close( readFd );
+        }
+    }
+    else if( analyzing )
+    {
+        signal( SIGPIPE, SIG_IGN );
+        setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof( yes ) );
+        heartbeat.fd = fd;
+        heartbeat.stop = false;
+        heartbeat.interval = options->heartbeat;
+        heartbeat.writeLock = &writeLock;
+        beating = 0 == pthread_create( &beater, NULL, heartbeatThread, &heartbeat );
+        streamOptions.nShards = 0;
+    }
+
+    while( NULL != connection && NULL != fgets( header, sizeof( header ), connection ) )
+    {
+        if( 0 == strcmp( header, "QUIT\n" ) )
+        {
+            success = true;
+            break;
+        }
+        if( 2 != sscanf( header, "CHUNK %d %zu", &id, &size ) || NULL == ( text = malloc( size + 1 ) )
+            || size != fread( text, 1, size, connection ) )
+        {
+            break;
+        }
+        input = fmemopen( text, size, "r" );
+        output = open_memstream( &result, &resultSize );
+        assert( NULL != input && NULL != output );
+        processStream( &streamOptions, &analysis, 0, input, output, &stats, NULL, NULL );
+        fclose( input );
+        fclose( output );
+        snprintf( header, sizeof( header ), "RESULT %d %d %zu\n", id, stats.nBoards, resultSize );
+        pthread_mutex_lock( &writeLock );
+        success = sendAll( fd, header, strlen( header ) ) && sendAll( fd, result, resultSize );
+        pthread_mutex_unlock( &writeLock );
+        free( text );
+        free( result );
+        text = NULL;
+        result = NULL;
+        if( !success )
+        {
+            break;
+        }
+        success = false;
+    }
+    free( text );
+    if( beating )
+    {
+        heartbeat.stop = true;
+        pthread_join( beater, NULL );
+    }
+    if( NULL != connection )
+    {
+        fclose( connection );
+    }
+    if( analyzing )
+    {
+        closeAnalysis( &analysis );
+    }
+    if( fd >= 0 )
+    {
+        close( fd );
+    }
+    return success;
+}
+
+
+boolean openAnalysis( const Options * options, AnalysisContext * analysis )
+{
+    boolean success = true;
+
+    memset( analysis, 0, sizeof( AnalysisContext ) );
+    analysis->options = options;
+    pthread_mutex_init( &analysis->engineLock, NULL );
+    analysis->symmetry = options->cacheSymmetric;
+    if( options->dedup || options->dedupSymmetric )
+    {
+        analysis->dedup = createDedupTable( options->dedupSymmetric );
+    }
+    if( success && NULL != options->bookFile )
+    {
+        analysis->book = openOpeningBook( options->bookFile );
+        success = NULL != analysis->book;
+    }
+    if( success && NULL != options->tablebaseFile )
+    {
+        analysis->tablebase = openTablebase( options->tablebaseFile );
+        success = NULL != analysis->tablebase;
+    }
+    if( NULL != options->makeBookFile )
+    {
+        analysis->bookOut = createBookCollector( );
+        analysis->bookOutPath = options->makeBookFile;
+    }
+    if( NULL != options->cacheFile )
+    {
+        analysis->cache = openPositionCache( options->cacheFile, options->cacheRecords );
+        success = NULL != analysis->cache;
+    }
+    return success;
+}
+
+
+void closeAnalysis( AnalysisContext * analysis )
+{
+    Engine total;
+    int i, j;
+
+    for( i = 0; i < analysis->nEngines; i++ )
+    {   // one line per configuration, over the engines of every thread
+        if( NULL == analysis->engines[i] )
+        {
+            continue;
+        }
+        total = *analysis->engines[i];
+        for( j = i + 1; j < analysis->nEngines; j++ )
+        {
+            if( NULL != analysis->engines[j] && 0 == strcmp( total.spec.name, analysis->engines[j]->spec.name ) )
+            {
+                mergeEngineStats( &total, analysis->engines[j] );
+                freeEngine( analysis->engines[j] );
+                free( analysis->engines[j] );
+                analysis->engines[j] = NULL;
+            }
+        }
+        if( ENGINE_GREEDY != total.spec.kind )
+        {
+            printEngineStats( &total, stderr );
+        }
+        freeEngine( analysis->engines[i] );
+        free( analysis->engines[i] );
+    }
+    free( analysis->engines );
+    if( NULL != analysis->options )
+    {
+        pthread_mutex_destroy( &analysis->engineLock );
+    }
+    closePositionCache( analysis->cache );
+    freeDedupTable( analysis->dedup );
+    closeOpeningBook( analysis->book );
+    closeTablebase( analysis->tablebase );
+    if( NULL != analysis->bookOut )
+    {
+        if( writeOpeningBook( analysis->bookOutPath, analysis->bookOut->records, analysis->bookOut->nRecords ) )
+        {
+            fprintf( stderr, "book: wrote '%s'\n", analysis->bookOutPath );
+        }
+        freeBookCollector( analysis->bookOut );
+    }
+    memset( analysis, 0, sizeof( AnalysisContext ) );
+}
+
+
+uint64_t mixHash( uint64_t value )
+{
+    value += 0x9E3779B97F4A7C15ULL;
+    value = ( value ^ ( value >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+    value = ( value ^ ( value >> 27 ) ) * 0x94D049BB133111EBULL;
+    return value ^ ( value >> 31 );
+}
+
+
+uint64_t hashGameBoard( const GameBoard * board )
+{
+    uint64_t hash = mixHash( ( (uint64_t)board->nColumns << 16 ) | ( (uint64_t)board->nRows << 8 ) | board->player );
+    int col, row;
+
+    for( row = 0; row < board->nRows; row++ )
+    {
+        for( col = 0; col < board->nColumns; col++ )
+        {
+            if( NONE != board->state[row][col] )
+            {
+                hash ^= mixHash( ( (uint64_t)( row * board->nColumns + col ) << 2 ) | board->state[row][col] );
+            }
+        }
+    }
+    return hash;
+}
+
+
+unsigned int engineConfigId( const Engine * engine, const GameClock * clock )
+{
+    const PatternWeights * weights = engine->weights;
+    uint64_t settings[9];
+    uint32_t bits;
+    uint64_t hash = 0;
+    int i;
+
+    // the effective settings, not the spec text: "search" means another search under another --depth
+    settings[0] = engine->spec.kind;
+    settings[1] = (uint64_t)engine->depth;
+    settings[2] = (uint64_t)engine->spec.playouts;
+    settings[3] = (uint64_t)engine->spec.endgameEmpties;
+    settings[4] = engine->spec.plainSearch;
+    settings[5] = engine->tableEntries;
+    memcpy( &settings[6], &engine->spec.moveTime, sizeof( double ) );
+    memcpy( &settings[7], &clock->remaining, sizeof( double ) );
+    memcpy( &settings[8], &clock->increment, sizeof( double ) );
+    for( i = 0; i < 9; i++ )
+    {
+        hash = mixHash( hash ^ settings[i] );
+    }
+    if( NULL != weights )
+    {   // identified by content, so a rewritten weights file is another configuration
+        memcpy( &bits, &weights->scale, sizeof( bits ) );
+        hash = mixHash( hash ^ bits );
+        for( i = 0; i < WEIGHT_PHASES * weights->patterns.nPhaseWeights; i++ )
+        {
+            memcpy( &bits, &weights->weights[i], sizeof( bits ) );
+            hash = mixHash( hash ^ bits );
+        }
+    }
+    return (unsigned int)( hash & 0xFFFF );
+}
+
+
+PositionCache * openPositionCache( const char * path, int nRecords )
+{
+    PositionCache * cache = calloc( 1, sizeof( PositionCache ) );
+    PositionCacheHeader header;
+    struct stat info;
+    uint32_t nBuckets = 1;
+    boolean success = false;
+
+    assert( NULL != cache );
+    while( nBuckets * CACHE_WAYS < (uint32_t)nRecords && nBuckets < ( 1u << 28 ) )
+    {
+        nBuckets *= 2;
+    }
+    cache->fd = open( path, O_RDWR | O_CREAT, 0666 );
+    if( cache->fd >= 0 && 0 == flock( cache->fd, LOCK_EX ) && 0 == fstat( cache->fd, &info ) )
+    {   // the lock makes sure only one of several starting processes lays out a new file
+        if( 0 == info.st_size )
+        {
+            memset( &header, 0, sizeof( header ) );
+            memcpy( header.magic, CACHE_MAGIC, sizeof( header.magic ) );
+            header.version = CACHE_VERSION;
+            header.nBuckets = nBuckets;
+            header.nWays = CACHE_WAYS;
+            header.recordSize = sizeof( CacheRecord );
+            success = sizeof( header ) == write( cache->fd, &header, sizeof( header ) )
+                && 0 == ftruncate( cache->fd, sizeof( header ) + (off_t)nBuckets * CACHE_WAYS * sizeof( CacheRecord ) );
+        }
+        else
+        {
+            success = sizeof( header ) == pread( cache->fd, &header, sizeof( header ), 0 )
+                && 0 == memcmp( header.magic, CACHE_MAGIC, sizeof( header.magic ) )
+                && CACHE_VERSION == header.version && CACHE_WAYS == header.nWays
+                && sizeof( CacheRecord ) == header.recordSize
+                && 0 != header.nBuckets && 0 == ( header.nBuckets & ( header.nBuckets - 1 ) )
+                && (off_t)( sizeof( header ) + (uint64_t)header.nBuckets * CACHE_WAYS * sizeof( CacheRecord ) ) <= info.st_size;
+            if( !success )
+            {
+                fprintf( stderr, "reversi: '%s' is not a compatible position cache\n", path );
+            }
+        }
+        if( success )
+        {
+            cache->mappedSize = sizeof( header ) + (size_t)header.nBuckets * CACHE_WAYS * sizeof( CacheRecord );
+            cache->header = mmap( NULL, cache->mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, cache->fd, 0 );
+            success = MAP_FAILED != cache->header;
+        }
+        if( success )
+        {
+            cache->records = (CacheRecord *)( cache->header + 1 );
+            cache->generation = ++cache->header->generation & 0xFF;
+        }
+        flock( cache->fd, LOCK_UN );
+    }
+    if( !success )
+    {
+        fprintf( stderr, "reversi: cannot open position cache '%s': %s\n", path, strerror( errno ) );
+        if( NULL != cache->header && MAP_FAILED != cache->header )
+        {
+            munmap( cache->header, cache->mappedSize );
+        }
+        if( cache->fd >= 0 )
+        {
+            close( cache->fd );
+        }
+        free( cache );
+        cache = NULL;
+    }
+    return cache;
+}
+
+
+void closePositionCache( PositionCache * cache )
+{
+    unsigned long nLookups;
+
+    if( NULL != cache )
+    {
+        nLookups = cache->nHits + cache->nMisses;
+        fprintf( stderr, "cache: %lu hit(s), %lu miss(es), %lu store(s), hit rate %.1f%%\n",
+            cache->nHits, cache->nMisses, cache->nStores, nLookups > 0 ? 100.0 * cache->nHits / nLookups : 0.0 );
+        munmap( cache->header, cache->mappedSize );
+        close( cache->fd );
+        free( cache );
+    }
+}
+
+
+boolean lookupPositionCache( PositionCache * cache, uint64_t key, unsigned int config, BoardMove * move )
+{
+    CacheRecord * bucket;
+    uint64_t check, data;
+    int way;
+    boolean found = false;
+
+    key ^= mixHash( config ); // different configurations of one position use different buckets
+    bucket = cache->records + ( key & ( cache->header->nBuckets - 1 ) ) * CACHE_WAYS;
+    for( way = 0; !found && way < CACHE_WAYS; way++ )
+    {
+        check = __atomic_load_n( &bucket[way].check, __ATOMIC_RELAXED );
+        data = __atomic_load_n( &bucket[way].data, __ATOMIC_RELAXED );
+        if( 0 != data && key == ( check ^ data ) && config == ( data >> 48 ) )
+        {
+            move->score = (int16_t)( data & 0xFFFF );
+            move->depth = (int)( ( data >> 16 ) & 0xFF );
+            move->row = (int)( ( data >> 24 ) & 0xFF ) - 1;
+            move->col = (int)( ( data >> 32 ) & 0xFF ) - 1;
+            move->source = SOURCE_ENGINE; // only engine results are stored
+            found = true;
+        }
+    }
+    __atomic_fetch_add( found ? &cache->nHits : &cache->nMisses, 1, __ATOMIC_RELAXED );
+    return found;
+}
+
+
+void storePositionCache( PositionCache * cache, uint64_t key, unsigned int config, const BoardMove * move )
+{
+    CacheRecord * bucket;
+    uint64_t data, victimData;
+    int way, victim = 0;
+    int age, victimAge = -1;
+
+    key ^= mixHash( config );
+    bucket = cache->records + ( key & ( cache->header->nBuckets - 1 ) ) * CACHE_WAYS;
+    data = (uint64_t)( move->score & 0xFFFF )
+        | (uint64_t)( move->depth & 0xFF ) << 16
+        | (uint64_t)( ( move->row + 1 ) & 0xFF ) << 24
+        | (uint64_t)( ( move->col + 1 ) & 0xFF ) << 32
+        | (uint64_t)( cache->generation & 0xFF ) << 40
+        | (uint64_t)( config & 0xFFFF ) << 48;
+    for( way = 0; way < CACHE_WAYS; way++ )
+    {
+        victimData = __atomic_load_n( &bucket[way].data, __ATOMIC_RELAXED );
+        if( 0 == victimData || key == ( __atomic_load_n( &bucket[way].check, __ATOMIC_RELAXED ) ^ victimData ) )
+        {   // empty, or the same position: take it
+            victim = way;
+            break;
+        }
+        // older runs first, then shallower results
+        age = ( ( cache->generation - ( victimData >> 40 ) ) & 0xFF ) * 256 + 255 - (int)( ( victimData >> 16 ) & 0xFF );
+        if( age > victimAge )
+        {
+            victim = way;
+            victimAge = age;
+        }
+    }
+    __atomic_store_n( &bucket[victim].data, data, __ATOMIC_RELAXED );
+    __atomic_store_n( &bucket[victim].check, key ^ data, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &cache->nStores, 1, __ATOMIC_RELAXED );
+}
+
+
+int countTransforms( const GameBoard * board )
+{
+    return board->nRows == board->nColumns ? N_SQUARE_TRANSFORMS : N_RECTANGLE_TRANSFORMS;
+}
+
+
+void transformCell( int transform, int nRows, int nColumns, int * row, int * col )
+{
+    int swap;
+
+    if( *row >= 0 )
+    {
+        if( transform & TRANSFORM_TRANSPOSE )
+        {
+            swap = *row;
+            *row = *col;
+            *col = swap;
+        }
+        if( transform & TRANSFORM_FLIP )
+        {
+            *row = nRows - 1 - *row;
+        }
+        if( transform & TRANSFORM_MIRROR )
+        {
+            *col = nColumns - 1 - *col;
+        }
+    }
+}
+
+
+void inverseTransformCell( int transform, int nRows, int nColumns, int * row, int * col )
+{
+    int swap;
+
+    if( *row >= 0 )
+    {   // undo the steps of transformCell() in reverse order
+        if( transform & TRANSFORM_MIRROR )
+        {
+            *col = nColumns - 1 - *col;
+        }
+        if( transform & TRANSFORM_FLIP )
+        {
+            *row = nRows - 1 - *row;
+        }
+        if( transform & TRANSFORM_TRANSPOSE )
+        {
+            swap = *row;
+            *row = *col;
+            *col = swap;
+        }
+    }
+}
+
+
+void transformGameBoard( const GameBoard * board, int transform, GameBoard * result )
+{
+    int col, row, toRow, toCol;
+
+    assert( board != result );
+    memcpy( result, board, sizeof( GameBoard ) );
+    for( row = 0; row < board->nRows; row++ )
+    {
+        for( col = 0; col < board->nColumns; col++ )
+        {
+            toRow = row;
+            toCol = col;
+            transformCell( transform, board->nRows, board->nColumns, &toRow, &toCol );
+            result->state[toRow][toCol] = board->state[row][col];
+        }
+    }
+}
+
+
+void packBitboards( const GameBoard * board, uint64_t * black, uint64_t * white )
+{
+    int col, row;
+
+    assert( 8 == board->nRows && 8 == board->nColumns );
+    *black = 0;
+    *white = 0;
+    for( row = 0; row < 8; row++ )
+    {
+        for( col = 0; col < 8; col++ )
+        {
+            if( BLACK == board->state[row][col] )
+            {
+                *black |= 1ULL << ( row * 8 + col );
+            }
+            else if( WHITE == board->state[row][col] )
+            {
+                *white |= 1ULL << ( row * 8 + col );
+            }
+        }
+    }
+}
+
+
+uint64_t transformBitboard( uint64_t bits, int transform )
+{
+    uint64_t t;
+
+    if( transform & TRANSFORM_TRANSPOSE )
+    {   // flip about the a1-h8 diagonal: swap 4x4, then 2x2, then 1x1 blocks
+        t = 0x0F0F0F0F00000000ULL & ( bits ^ ( bits << 28 ) );
+        bits ^= t ^ ( t >> 28 );
+        t = 0x3333000033330000ULL & ( bits ^ ( bits << 14 ) );
+        bits ^= t ^ ( t >> 14 );
+        t = 0x5500550055005500ULL & ( bits ^ ( bits << 7 ) );
+        bits ^= t ^ ( t >> 7 );
+    }
+    if( transform & TRANSFORM_FLIP )
+    {   // one byte per row
+        bits = __builtin_bswap64( bits );
+    }
+    if( transform & TRANSFORM_MIRROR )
+    {
+        bits = ( ( bits >> 1 ) & 0x5555555555555555ULL ) | ( ( bits & 0x5555555555555555ULL ) << 1 );
+        bits = ( ( bits >> 2 ) & 0x3333333333333333ULL ) | ( ( bits & 0x3333333333333333ULL ) << 2 );
+        bits = ( ( bits >> 4 ) & 0x0F0F0F0F0F0F0F0FULL ) | ( ( bits & 0x0F0F0F0F0F0F0F0FULL ) << 4 );
+    }
+    return bits;
+}
+
+
+uint64_t hashBitboards( uint64_t black, uint64_t white, GameBoardCell player )
+{
+    uint64_t hash = mixHash( ( 8ULL << 16 ) | ( 8ULL << 8 ) | player );
+
+    for( ; 0 != black; black &= black - 1 )
+    {
+        hash ^= mixHash( ( (uint64_t)__builtin_ctzll( black ) << 2 ) | BLACK );
+    }
+    for( ; 0 != white; white &= white - 1 )
+    {
+        hash ^= mixHash( ( (uint64_t)__builtin_ctzll( white ) << 2 ) | WHITE );
+    }
+    return hash;
+}
+
+
+uint64_t canonicalHash( const GameBoard * board, int * transform )
+{
+    GameBoard image;
+    uint64_t black, white, hash, best = 0;
+    int t, bestTransform = 0;
+    int nTransforms = countTransforms( board );
+
+    if( 8 == board->nRows && 8 == board->nColumns )
+    {
+        packBitboards( board, &black, &white );
+        for( t = 0; t < nTransforms; t++ )
+        {
+            hash = hashBitboards( transformBitboard( black, t ), transformBitboard( white, t ), board->player );
+            if( 0 == t || hash < best )
+            {
+                best = hash;
+                bestTransform = t;
+            }
+        }
+    }
+    else
+    {
+        for( t = 0; t < nTransforms; t++ )
+        {
+            transformGameBoard( board, t, &image );
+            hash = hashGameBoard( &image );
+            if( 0 == t || hash < best )
+            {
+                best = hash;
+                bestTransform = t;
+            }
+        }
+    }
+    if( NULL != transform )
+    {
+        *transform = bestTransform;
+    }
+    return best;
+}
+
+
+uint64_t positionKey( const AnalysisContext * analysis, const GameBoard * board, int * transform )
+{
+    *transform = 0;
+    // the two kinds of keys never share records: an exact board must not get an image's tie-break
+    return analysis->symmetry ? canonicalHash( board, transform ) ^ SYMMETRIC_KEY_SALT : hashGameBoard( board );
+}
+
+
+DedupTable * createDedupTable( boolean symmetric )
+{
+    DedupTable * table = calloc( 1, sizeof( DedupTable ) );
+
+    assert( NULL != table );
+    table->capacity = DEDUP_INITIAL_CAPACITY;
+    table->entries = calloc( table->capacity, sizeof( DedupEntry ) );
+    assert( NULL != table->entries );
+    table->symmetric = symmetric;
+    pthread_mutex_init( &table->lock, NULL );
+    pthread_cond_init( &table->ready, NULL );
+    return table;
+}
+
+
+void freeDedupTable( DedupTable * table )
+{
+    if( NULL != table )
+    {
+        fprintf( stderr, "dedup: %lu unique, %lu duplicate board(s)", table->nUnique, table->nDuplicates );
+        if( table->symmetric )
+        {
+            fprintf( stderr, " (symmetric), %lu image(s) computed again", table->nRecomputed );
+        }
+        fprintf( stderr, "\n" );
+        pthread_mutex_destroy( &table->lock );
+        pthread_cond_destroy( &table->ready );
+        free( table->entries );
+        free( table );
+    }
+}
+
+
+DedupEntry * findDedupEntry( DedupEntry * entries, size_t capacity, uint64_t key )
+{
+    size_t slot = key & ( capacity - 1 );
+
+    while( DEDUP_EMPTY != entries[slot].state && key != entries[slot].key )
+    {
+        slot = ( slot + 1 ) & ( capacity - 1 );
+    }
+    return &entries[slot];
+}
+
+
+boolean reserveDuplicate( DedupTable * table, uint64_t key, uint64_t exact, BoardMove * move )
+{
+    DedupEntry * entries;
+    DedupEntry * entry;
+    size_t i;
+    boolean duplicate = false;
+
+    pthread_mutex_lock( &table->lock );
+    entry = findDedupEntry( table->entries, table->capacity, key );
+    if( DEDUP_EMPTY == entry->state )
+    {
+        if( 2 * ( table->nUsed + 1 ) > table->capacity )
+        {   // keep the load under one half
+            entries = calloc( 2 * table->capacity, sizeof( DedupEntry ) );
+            assert( NULL != entries );
+            for( i = 0; i < table->capacity; i++ )
+            {
+                if( DEDUP_EMPTY != table->entries[i].state )
+                {
+                    *findDedupEntry( entries, 2 * table->capacity, table->entries[i].key ) = table->entries[i];
+                }
+            }
+            free( table->entries );
+            table->entries = entries;
+            table->capacity *= 2;
+            entry = findDedupEntry( table->entries, table->capacity, key );
+        }
+        entry->key = key;
+        entry->state = DEDUP_PENDING;
+        table->nUsed++;
+        table->nUnique++;
+    }
+    else
+    {
+        while( DEDUP_PENDING == ( entry = findDedupEntry( table->entries, table->capacity, key ) )->state )
+        {
+            pthread_cond_wait( &table->ready, &table->lock );
+        }
+        if( exact == entry->exact || entry->invariant )
+        {
+            *move = entry->move;
+            table->nDuplicates++;
+            duplicate = true;
+        }
+        else
+        {
+            table->nRecomputed++;
+        }
+    }
+    pthread_mutex_unlock( &table->lock );
+    return duplicate;
+}
+
+
+void publishDuplicate( DedupTable * table, uint64_t key, uint64_t exact, const BoardMove * move, boolean invariant )
+{
+    DedupEntry * entry;
+
+    pthread_mutex_lock( &table->lock );
+    entry = findDedupEntry( table->entries, table->capacity, key );
+    assert( DEDUP_EMPTY != entry->state );
+    if( DEDUP_PENDING == entry->state )
+    {   // a ready entry is the earlier result a tied image was computed beside
+        entry->exact = exact;
+        entry->move = *move;
+        entry->invariant = invariant;
+        entry->state = DEDUP_READY;
+        pthread_cond_broadcast( &table->ready );
+    }
+    pthread_mutex_unlock( &table->lock );
+}
+
+
+void initKeyIndex( KeyIndex * index )
+{
+    size_t i;
+
+    index->capacity = KEY_INDEX_INITIAL_CAPACITY;
+    index->nUsed = 0;
+    index->entries = malloc( index->capacity * sizeof( KeyIndexEntry ) );
+    assert( NULL != index->entries );
+    for( i = 0; i < index->capacity; i++ )
+    {
+        index->entries[i].value = -1;
+    }
+}
+
+
+KeyIndexEntry * findKeyIndexEntry( KeyIndexEntry * entries, size_t capacity, uint64_t key )
+{
+    size_t slot = key & ( capacity - 1 );
+
+    while( 0 <= entries[slot].value && key != entries[slot].key )
+    {
+        slot = ( slot + 1 ) & ( capacity - 1 );
+    }
+    return &entries[slot];
+}
+
+
+int lookupKeyIndex( const KeyIndex * index, uint64_t key )
+{
+    return findKeyIndexEntry( index->entries, index->capacity, key )->value;
+}
+
+
+boolean insertKeyIndex( KeyIndex * index, uint64_t key, int value )
+{
+    KeyIndexEntry * entries;
+    KeyIndexEntry * entry;
+    size_t i;
+
+    if( 2 * ( index->nUsed + 1 ) > index->capacity )
+    {   // keep the load under one half
+        entries = malloc( 2 * index->capacity * sizeof( KeyIndexEntry ) );
+        assert( NULL != entries );
+        for( i = 0; i < 2 * index->capacity; i++ )
+        {
+            entries[i].value = -1;
+        }
+        for( i = 0; i < index->capacity; i++ )
+        {
+            if( 0 <= index->entries[i].value )
+            {
+                *findKeyIndexEntry( entries, 2 * index->capacity, index->entries[i].key ) = index->entries[i];
+            }
+        }
+        free( index->entries );
+        index->entries = entries;
+        index->capacity *= 2;
+    }
+    entry = findKeyIndexEntry( index->entries, index->capacity, key );
+    if( 0 <= entry->value )
+    {
+        return false;
+    }
+    entry->key = key;
+    entry->value = value;
+    index->nUsed++;
+    return true;
+}
+
+
+void freeKeyIndex( KeyIndex * index )
+{
+    free( index->entries );
+    memset( index, 0, sizeof( KeyIndex ) );
+}
+
+
+int countReverses( GameBoard * board, int row, int col )
+{
+    int count = 0;
+
+    if( 0 <= row && row < board->nRows && 0 <= col && col < board->nColumns && NONE == board->state[row][col] )
+    {
+        board->state[row][col] = board->player;
+        count = numAllReverse( board, row, col );
+        board->state[row][col] = NONE;
+    }
+    return count;
+}
+
+
+boolean isOnlyBestMove( const Engine * engine, GameBoard * board, const BoardMove * best )
+{
+    int row, col, reverses;
+    int nBest = 0;
+
+    if( 0 > best->row || SOURCE_BOOK == best->source || SOURCE_TABLEBASE == best->source )
+    {   // books and tablebases answer every image with the image of one move
+        return true;
+    }
+    if( ENGINE_GREEDY != engine->spec.kind )
+    {
+        return false;
+    }
+    reverses = countReverses( board, best->row, best->col );
+    for( row = 0; row < board->nRows && nBest < 2; row++ )
+    {
+        for( col = 0; col < board->nColumns && nBest < 2; col++ )
+        {
+            if( canPlayAt( board, row, col ) && reverses == countReverses( board, row, col ) )
+            {
+                nBest++;
+            }
+        }
+    }
+    return 1 == nBest;
+}
+
+
+OpeningBook * openOpeningBook( const char * path )
+{
+    OpeningBook * book = calloc( 1, sizeof( OpeningBook ) );
+    struct stat info;
+    void * mapped = MAP_FAILED;
+    int fd = open( path, O_RDONLY );
+    boolean success = false;
+
+    assert( NULL != book );
+    if( fd >= 0 && 0 == fstat( fd, &info ) && info.st_size >= (off_t)sizeof( BookHeader ) )
+    {
+        mapped = mmap( NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    }
+    if( MAP_FAILED != mapped )
+    {
+        book->header = mapped;
+        book->records = (const BookRecord *)( book->header + 1 );
+        book->mappedSize = info.st_size;
+        success = 0 == memcmp( book->header->magic, BOOK_MAGIC, sizeof( BOOK_MAGIC ) )
+            && BOOK_VERSION == book->header->version
+            && sizeof( BookRecord ) == book->header->recordSize
+            && sizeof( BookHeader ) + book->header->nRecords * sizeof( BookRecord ) <= (uint64_t)info.st_size;
+        if( success )
+        {   // lookups jump around the whole file
+            madvise( mapped, info.st_size, MADV_RANDOM );
+        }
+    }
+    if( fd >= 0 )
+    {
+        close( fd );
+    }
+    if( !success )
+    {
+        fprintf( stderr, "reversi: '%s' is not a readable opening book\n", path );
+        if( MAP_FAILED != mapped )
+        {
+            munmap( mapped, info.st_size );
+        }
+        free( book );
+        book = NULL;
+    }
+    return book;
+}
+
+
+void closeOpeningBook( OpeningBook * book )
+{
+    if( NULL != book )
+    {
+        fprintf( stderr, "book: %lu of %lu lookup(s) found in %lu position(s)\n",
+            book->nHits, book->nLookups, (unsigned long)book->header->nRecords );
+        munmap( (void *)book->header, book->mappedSize );
+        free( book );
+    }
+}
+
+
+const BookRecord * lookupOpeningBook( OpeningBook * book, uint64_t key )
+{
+    const BookRecord * records = book->records;
+    const BookRecord * found = NULL;
+    size_t low = 0;
+    size_t high = book->header->nRecords; // search [low, high)
+    size_t probe;
+    int nInterpolations = 0;
+    long double fraction;
+
+    while( low < high && NULL == found )
+    {
+        if( nInterpolations < 4 && key >= records[low].key && key <= records[high - 1].key
+            && records[high - 1].key > records[low].key )
+        {
+            fraction = (long double)( key - records[low].key ) / (long double)( records[high - 1].key - records[low].key );
+            probe = low + (size_t)( fraction * ( high - 1 - low ) );
+            nInterpolations++;
+        }
+        else
+        {
+            probe = low + ( high - low ) / 2;
+        }
+        if( records[probe].key == key )
+        {
+            found = &records[probe];
+        }
+        else if( records[probe].key < key )
+        {
+            low = probe + 1;
+        }
+        else
+        {
+            high = probe;
+        }
+    }
+    __atomic_fetch_add( &book->nLookups, 1, __ATOMIC_RELAXED );
+    if( NULL != found )
+    {
+        __atomic_fetch_add( &book->nHits, 1, __ATOMIC_RELAXED );
+    }
+    return found;
+}
+
+
+BookCollector * createBookCollector( void )
+{
+    BookCollector * collector = calloc( 1, sizeof( BookCollector ) );
+
+    assert( NULL != collector );
+    pthread_mutex_init( &collector->lock, NULL );
+    return collector;
+}
+
+
+void addBookRecord( BookCollector * collector, uint64_t key, const BoardMove * move )
+{
+    BookRecord * records;
+    BookRecord * record;
+
+    pthread_mutex_lock( &collector->lock );
+    if( collector->nRecords == collector->capacity )
+    {
+        collector->capacity = 0 == collector->capacity ? 1024 : 2 * collector->capacity;
+        records = realloc( collector->records, collector->capacity * sizeof( BookRecord ) );
+        assert( NULL != records );
+        collector->records = records;
+    }
+    record = &collector->records[collector->nRecords++];
+    memset( record, 0, sizeof( BookRecord ) );
+    record->key = key;
+    record->score = (int16_t)move->score;
+    record->row = (int8_t)move->row;
+    record->col = (int8_t)move->col;
+    record->depth = (uint8_t)move->depth;
+    pthread_mutex_unlock( &collector->lock );
+}
+
+
+void freeBookCollector( BookCollector * collector )
+{
+    if( NULL != collector )
+    {
+        pthread_mutex_destroy( &collector->lock );
+        free( collector->records );
+        free( collector );
+    }
+}
+
+
+int compareBookRecords( const void * left, const void * right )
+{
+    const BookRecord * a = left;
+    const BookRecord * b = right;
+
+    if( a->key != b->key )
+    {
+        return a->key < b->key ? -1 : 1;
+    }
+    return (int)b->depth - (int)a->depth;
+}
+
+
+boolean writeOpeningBook( const char * path, BookRecord * records, size_t nRecords )
+{
+    char temporary[MAX_INPUT_PATH + 8];
+    BookHeader header;
+    FILE * file;
+    size_t i, nUnique = 0;
+    boolean success = false;
+
+    qsort( records, nRecords, sizeof( BookRecord ), compareBookRecords );
+    for( i = 0; i < nRecords; i++ )
+    {   // keep the first, deepest record of each key
+        if( 0 == nUnique || records[i].key != records[nUnique - 1].key )
+        {
+            records[nUnique++] = records[i];
+        }
+    }
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, BOOK_MAGIC, sizeof( BOOK_MAGIC ) );
+    header.version = BOOK_VERSION;
+    header.recordSize = sizeof( BookRecord );
+    header.nRecords = nUnique;
+    snprintf( temporary, sizeof( temporary ), "%s.tmp", path );
+    file = fopen( temporary, "wb" );
+    if( NULL != file )
+    {
+        success = 1 == fwrite( &header, sizeof( header ), 1, file )
+            && nUnique == fwrite( records, sizeof( BookRecord ), nUnique, file );
+        success = 0 == fclose( file ) && success;
+        success = success && 0 == rename( temporary, path );
+    }
+    if( !success )
+    {
+        fprintf( stderr, "reversi: cannot write opening book '%s': %s\n", path, strerror( errno ) );
+    }
+    return success;
+}
+
+
+GameBoardCell opponentOf( GameBoardCell player )
+{
+    return WHITE == player ? BLACK : WHITE;
+}
+
+
+void initStartBoard( GameBoard * board, int nRows, int nColumns )
+{
+    int row = nRows / 2 - 1;
+    int col = nColumns / 2 - 1;
+
+    memset( board, 0, sizeof( GameBoard ) );
+    board->nRows = nRows;
+    board->nColumns = nColumns;
+    board->player = BLACK;
+    board->state[row][col] = WHITE;
+    board->state[row][col + 1] = BLACK;
+    board->state[row + 1][col] = BLACK;
+    board->state[row + 1][col + 1] = WHITE;
+    snprintf( board->title, sizeof( board->title ), "START %dx%d", nColumns, nRows );
+}
+
+
+void unpackBitboards( uint64_t black, uint64_t white, GameBoardCell player, GameBoard * board )
+{
+    int cell;
+
+    memset( board, 0, sizeof( GameBoard ) );
+    board->nRows = 8;
+    board->nColumns = 8;
+    board->player = player;
+    for( cell = 0; cell < 64; cell++ )
+    {
+        if( black & ( 1ULL << cell ) )
+        {
+            board->state[cell / 8][cell % 8] = BLACK;
+        }
+        else if( white & ( 1ULL << cell ) )
+        {
+            board->state[cell / 8][cell % 8] = WHITE;
+        }
+    }
+}
+
+
+int playMove( GameBoard * board, int row, int col, MoveUndo * undo )
+{
+    static const int directions[8][2] = { { -1, -1 }, { -1, 0 }, { -1, 1 }, { 0, -1 }, { 0, 1 }, { 1, -1 }, { 1, 0 }, { 1, 1 } };
+    GameBoardCell player = board->player;
+    int nFlips = 0;
+    int direction, count, step;
+
+    if( 0 <= row && row < board->nRows && 0 <= col && col < board->nColumns && NONE == board->state[row][col] )
+    {
+        board->state[row][col] = player; // play the piece
+        for( direction = 0; direction < 8; direction++ )
+        {
+            count = numReverseDirection( board, row, col, directions[direction][0], directions[direction][1] );
+            for( step = 1; step <= count; step++ )
+            {
+                board->state[row + step * directions[direction][0]][col + step * directions[direction][1]] = player;
+                if( NULL != undo )
+                {
+                    undo->flips[nFlips] = (short)( ( row + step * directions[direction][0] ) * MAX_BOARD_COLUMNS
+                        + col + step * directions[direction][1] );
+                }
+                nFlips++;
+            }
+        }
+        if( 0 == nFlips )
+        {   // nothing outflanked: not a legal move
+            board->state[row][col] = NONE;
+        }
+        else
+        {
+            board->player = opponentOf( player );
+            if( NULL != undo )
+            {
+                undo->row = row;
+                undo->col = col;
+                undo->player = player;
+                undo->nFlips = nFlips;
+            }
+        }
+    }
+    return nFlips;
+}
+
+
+void passMove( GameBoard * board, MoveUndo * undo )
+{
+    if( NULL != undo )
+    {
+        undo->row = -1;
+        undo->col = -1;
+        undo->player = board->player;
+        undo->nFlips = 0;
+    }
+    board->player = opponentOf( board->player );
+}
+
+
+void undoMove( GameBoard * board, const MoveUndo * undo )
+{
+    GameBoardCell opponent = opponentOf( undo->player );
+    int i;
+
+    for( i = 0; i < undo->nFlips; i++ )
+    {
+        board->state[undo->flips[i] / MAX_BOARD_COLUMNS][undo->flips[i] % MAX_BOARD_COLUMNS] = opponent;
+    }
+    if( undo->row >= 0 )
+    {
+        board->state[undo->row][undo->col] = NONE;
+    }
+    board->player = undo->player;
+}
+
+
+boolean isLegalMove( GameBoard * board, int row, int col )
+{
+    boolean legal = false;
+
+    if( 0 <= row && row < board->nRows && 0 <= col && col < board->nColumns && NONE == board->state[row][col] )
+    {
+        board->state[row][col] = board->player;
+        legal = 0 < numReverseDirection( board, row, col, -1, -1 )
+            || 0 < numReverseDirection( board, row, col, -1, 0 )
+            || 0 < numReverseDirection( board, row, col, -1, 1 )
+            || 0 < numReverseDirection( board, row, col, 0, -1 )
+            || 0 < numReverseDirection( board, row, col, 0, 1 )
+            || 0 < numReverseDirection( board, row, col, 1, -1 )
+            || 0 < numReverseDirection( board, row, col, 1, 0 )
+            || 0 < numReverseDirection( board, row, col, 1, 1 );
+        board->state[row][col] = NONE;
+    }
+    return legal;
+}
+
+
+int generateMoves( GameBoard * board, int * cells )
+{
+    int col, row;
+    int nMoves = 0;
+
+    for( row = 0; row < board->nRows; row++ )
+    {
+        for( col = 0; col < board->nColumns; col++ )
+        {
+            if( isLegalMove( board, row, col ) )
+            {
+                if( NULL != cells )
+                {
+                    cells[nMoves] = row * MAX_BOARD_COLUMNS + col;
+                }
+                nMoves++;
+            }
+        }
+    }
+    return nMoves;
+}
+
+
+int discDifference( const GameBoard * board )
+{
+    int col, row;
+    int difference = 0;
+
+    for( row = 0; row < board->nRows; row++ )
+    {
+        for( col = 0; col < board->nColumns; col++ )
+        {
+            if( NONE != board->state[row][col] )
+            {
+                difference += board->state[row][col] == board->player ? 1 : -1;
+            }
+        }
+    }
+    return difference;
+}
+
+
+int finalScore( const GameBoard * board )
+{
+    int difference = discDifference( board );
+
+    return 0 == difference ? 0 : difference > 0 ? SEARCH_WIN + difference : -SEARCH_WIN + difference;
+}
+
+
+int evaluateBoard( GameBoard * board )
+{
+    int corners[4][2];
+    int corner, nOwn, nOpponent;
+    int score = discDifference( board );
+
+    corners[0][0] = 0;
+    corners[0][1] = 0;
+    corners[1][0] = 0;
+    corners[1][1] = board->nColumns - 1;
+    corners[2][0] = board->nRows - 1;
+    corners[2][1] = 0;
+    corners[3][0] = board->nRows - 1;
+    corners[3][1] = board->nColumns - 1;
+    for( corner = 0; corner < 4; corner++ )
+    {
+        if( NONE != board->state[corners[corner][0]][corners[corner][1]] )
+        {
+            score += board->state[corners[corner][0]][corners[corner][1]] == board->player ? 25 : -25;
+        }
+    }
+
+    // mobility: how many moves each side has
+    nOwn = generateMoves( board, NULL );
+    board->player = opponentOf( board->player );
+    nOpponent = generateMoves( board, NULL );
+    board->player = opponentOf( board->player );
+    return score + 5 * ( nOwn - nOpponent );
+}
+
+
+int searchPosition( SearchContext * search, GameBoard * board, int depth, int alpha, int beta )
+{
+    const TranspositionEntry * entry = NULL;
+    int cells[MAX_MOVES];
+    MoveUndo undo;
+    uint64_t key = 0;
+    int nMoves, i, score, floor;
+    int best = -SEARCH_INFINITY;
+    int bestMove = -1;
+    int hintMove = -1;
+    int originalAlpha = alpha;
+
+    search->nodes++;
+    if( 0 == ( search->nodes & 1023 ) && ( search->stopRequest || 0 < search->deadline || NULL != search->info ) )
+    {
+        pollSearch( search );
+    }
+    if( search->stopped )
+    {
+        return 0;
+    }
+    if( NULL != search->table )
+    {
+        key = hashGameBoard( board );
+        entry = &search->table[key & search->tableMask];
+        if( entry->key == key && entry->generation == search->generation )
+        {
+            hintMove = entry->move;
+            if( entry->depth >= depth
+                && ( BOUND_EXACT == entry->bound
+                    || ( BOUND_LOWER == entry->bound && entry->score >= beta )
+                    || ( BOUND_UPPER == entry->bound && entry->score <= alpha ) ) )
+            {
+                search->tableHits++;
+                return entry->score;
+            }
+        }
+    }
+    nMoves = generateMoves( board, cells );
+    if( 0 == nMoves )
+    {
+        passMove( board, &undo );
+        if( 0 == generateMoves( board, NULL ) )
+        {   // neither side can move: the game is over
+            undoMove( board, &undo );
+            return finalScore( board );
+        }
+        best = -searchPosition( search, board, depth, -beta, -alpha );
+        undoMove( board, &undo );
+        return best;
+    }
+    if( depth <= 0 )
+    {
+        return NULL != search->weights && 8 == board->nRows && 8 == board->nColumns
+            ? evaluatePatterns( search->weights, board ) : evaluateBoard( board );
+    }
+    orderMoves( search, board, cells, nMoves, hintMove, depth );
+    for( i = 0; i < nMoves && best < beta; i++ )
+    {
+        floor = best > alpha ? best : alpha;
+        playMove( board, cells[i] / MAX_BOARD_COLUMNS, cells[i] % MAX_BOARD_COLUMNS, &undo );
+        if( 0 == i || search->plain )
+        {
+            score = -searchPosition( search, board, depth - 1, -beta, -floor );
+        }
+        else
+        {   // the first move is taken for the best: a null window proves the others worse
+            score = -searchPosition( search, board, depth - 1, -floor - 1, -floor );
+            if( score > floor && score < beta && !search->stopped )
+            {   // it is better: search it again for its score
+                search->researches++;
+                score = -searchPosition( search, board, depth - 1, -beta, -floor );
+            }
+        }
+        undoMove( board, &undo );
+        if( search->stopped )
+        {
+            return 0;
+        }
+        if( score > best )
+        {
+            best = score;
+            bestMove = cells[i];
+        }
+        if( best >= beta )
+        {
+            recordCutoff( search, cells[i], depth, i );
+        }
+    }
+    storeTransposition( search, key, depth, best,
+        best <= originalAlpha ? BOUND_UPPER : best >= beta ? BOUND_LOWER : BOUND_EXACT, bestMove );
+    return best;
+}
+
+
+int searchBestMove( SearchContext * search, GameBoard * board, int depth, BoardMove * best )
+{
+    return searchRoot( search, board, depth, -SEARCH_INFINITY, SEARCH_INFINITY, best );
+}
+
+
+int searchRoot( SearchContext * search, GameBoard * board, int depth, int alpha, int beta, BoardMove * best )
+{
+    const TranspositionEntry * entry;
+    int cells[MAX_MOVES];
+    MoveUndo undo;
+    uint64_t key = 0;
+    int nMoves, i, score, floor;
+    int hintMove = -1;
+    int result = -SEARCH_INFINITY;
+
+    best->row = -1;
+    best->col = -1;
+    best->depth = depth;
+    best->source = SOURCE_ENGINE;
+    nMoves = generateMoves( board, cells );
+    if( 0 == nMoves )
+    {   // pass, or the game is over
+        result = searchPosition( search, board, depth, alpha, beta );
+    }
+    if( NULL != search->table && 0 < nMoves )
+    {   // the previous iteration's best move first
+        key = hashGameBoard( board );
+        entry = &search->table[key & search->tableMask];
+        hintMove = entry->key == key && entry->generation == search->generation ? entry->move : -1;
+    }
+    orderMoves( search, board, cells, nMoves, hintMove, depth );
+    for( i = 0; i < nMoves && result < beta; i++ )
+    {
+        floor = result > alpha ? result : alpha;
+        playMove( board, cells[i] / MAX_BOARD_COLUMNS, cells[i] % MAX_BOARD_COLUMNS, &undo );
+        if( 0 == i || search->plain )
+        {
+            score = -searchPosition( search, board, depth - 1, -beta, -floor );
+        }
+        else
+        {
+            score = -searchPosition( search, board, depth - 1, -floor - 1, -floor );
+            if( score > floor && score < beta && !search->stopped )
+            {
+                search->researches++;
+                score = -searchPosition( search, board, depth - 1, -beta, -floor );
+            }
+        }
+        undoMove( board, &undo );
+        if( search->stopped )
+        {
+            break;
+        }
+        if( score > result )
+        {
+            result = score;
+            best->row = cells[i] / MAX_BOARD_COLUMNS;
+            best->col = cells[i] % MAX_BOARD_COLUMNS;
+        }
+    }
+    if( 0 < nMoves && !search->stopped )
+    {
+        storeTransposition( search, key, depth, result,
+            result <= alpha ? BOUND_UPPER : result >= beta ? BOUND_LOWER : BOUND_EXACT,
+            best->row * MAX_BOARD_COLUMNS + best->col );
+    }
+    best->score = result;
+    return result;
+}
+
+
+int addBookNode( BookBuildContext * build, const GameBoard * board )
+{
+    BookNode * grown;
+    BookNode * node;
+    uint64_t key = canonicalHash( board, NULL );
+    int found = lookupKeyIndex( &build->index, key );
+
+    if( 0 <= found )
+    {
+        return found;
+    }
+    if( build->nNodes == build->nodeCapacity )
+    {
+        build->nodeCapacity = 0 == build->nodeCapacity ? 1024 : 2 * build->nodeCapacity;
+        grown = realloc( build->nodes, build->nodeCapacity * sizeof( BookNode ) );
+        assert( NULL != grown );
+        build->nodes = grown;
+    }
+    node = &build->nodes[build->nNodes];
+    memset( node, 0, sizeof( BookNode ) );
+    packBitboards( board, &node->black, &node->white );
+    node->player = board->player;
+    node->key = key;
+    node->bestRow = -1;
+    node->bestCol = -1;
+    node->firstParent = -1;
+    node->dropout = SEARCH_INFINITY;
+    insertKeyIndex( &build->index, key, build->nNodes );
+    return build->nNodes++;
+}
+
+
+void addBookChild( BookBuildContext * build, int parent, int child, int cell )
+{
+    int * grownChildren;
+    int * grownCells;
+    BookLink * grownLinks;
+
+    if( build->nChildren == build->childCapacity )
+    {
+        build->childCapacity = 2 * build->childCapacity + 1024;
+        grownChildren = realloc( build->children, build->childCapacity * sizeof( int ) );
+        grownCells = realloc( build->childCells, build->childCapacity * sizeof( int ) );
+        assert( NULL != grownChildren && NULL != grownCells );
+        build->children = grownChildren;
+        build->childCells = grownCells;
+    }
+    if( build->nLinks == build->linkCapacity )
+    {
+        build->linkCapacity = 2 * build->linkCapacity + 1024;
+        grownLinks = realloc( build->links, build->linkCapacity * sizeof( BookLink ) );
+        assert( NULL != grownLinks );
+        build->links = grownLinks;
+    }
+    if( 0 == build->nodes[parent].nChildren )
+    {   // the children of a node are added one after another
+        build->nodes[parent].firstChild = build->nChildren;
+    }
+    build->children[build->nChildren] = child;
+    build->childCells[build->nChildren] = cell;
+    build->nChildren++;
+    build->nodes[parent].nChildren++;
+    build->links[build->nLinks].parent = parent;
+    build->links[build->nLinks].next = build->nodes[child].firstParent;
+    build->nodes[child].firstParent = build->nLinks++;
+}
+
+
+void markBookNode( BookBuildContext * build, int node )
+{
+    int * grown;
+
+    if( build->nodes[node].dirty )
+    {
+        return;
+    }
+    if( build->nDirty == build->dirtyCapacity )
+    {
+        build->dirtyCapacity = 2 * build->dirtyCapacity + 1024;
+        grown = realloc( build->dirty, build->dirtyCapacity * sizeof( int ) );
+        assert( NULL != grown );
+        build->dirty = grown;
+    }
+    build->nodes[node].dirty = true;
+    build->dirty[build->nDirty++] = node;
+}
+
+
+void evaluateBookLeafJob( void * context, int index, int thread )
+{
+    BookBuildContext * build = context;
+    BookNode * node = &build->nodes[build->leaves[index]];
+    SearchContext search;
+    GameBoard board;
+    BoardMove best;
+
+    (void)thread;
+    memset( &search, 0, sizeof( SearchContext ) );
+    search.weights = build->options->weights;
+    unpackBitboards( node->black, node->white, node->player, &board );
+    node->score = searchBestMove( &search, &board, build->options->bookDepth, &best );
+    node->depth = build->options->bookDepth;
+    node->bestRow = best.row;
+    node->bestCol = best.col;
+    node->evaluated = true;
+    __atomic_fetch_add( &build->nodesSearched, search.nodes, __ATOMIC_RELAXED );
+}
+
+
+void backUpBookNodes( BookBuildContext * build, const int * seeds, int nSeeds )
+{
+    BookNode * nodes = build->nodes;
+    BookNode * node;
+    BookNode * child;
+    int head = 0, nQueued = 0;
+    int i, x, link, score, depth, cell;
+
+    for( i = 0; i < nSeeds; i++ )
+    {
+        if( !nodes[seeds[i]].queued )
+        {
+            nodes[seeds[i]].queued = true;
+            build->work[( head + nQueued++ ) % build->nNodes] = seeds[i];
+        }
+    }
+    while( 0 < nQueued )
+    {
+        x = build->work[head];
+        head = ( head + 1 ) % build->nNodes;
+        nQueued--;
+        node = &nodes[x];
+        node->queued = false;
+        if( !node->expanded || node->terminal )
+        {
+            continue;
+        }
+        score = -SEARCH_INFINITY;
+        depth = 0;
+        cell = -1;
+        for( i = 0; i < node->nChildren; i++ )
+        {
+            child = &nodes[build->children[node->firstChild + i]];
+            if( -child->score > score )
+            {
+                score = -child->score;
+                depth = child->depth < 255 ? child->depth + 1 : 255;
+                cell = build->childCells[node->firstChild + i];
+            }
+        }
+        if( score == node->score && depth == node->depth
+            && ( 0 > cell ? -1 : cell / MAX_BOARD_COLUMNS ) == node->bestRow
+            && ( 0 > cell ? -1 : cell % MAX_BOARD_COLUMNS ) == node->bestCol )
+        {
+            continue;
+        }
+        markBookNode( build, x );
+        for( link = node->firstParent; ( score != node->score || depth != node->depth ) && 0 <= link;
+            link = build->links[link].next )
+        {   // a new value travels up to every parent
+            if( !nodes[build->links[link].parent].queued )
+            {
+                nodes[build->links[link].parent].queued = true;
+                build->work[( head + nQueued++ ) % build->nNodes] = build->links[link].parent;
+            }
+        }
+        node->score = score;
+        node->depth = depth;
+        node->bestRow = 0 > cell ? -1 : cell / MAX_BOARD_COLUMNS;
+        node->bestCol = 0 > cell ? -1 : cell % MAX_BOARD_COLUMNS;
+    }
+}
+
+
+void updateBookDropouts( BookBuildContext * build, const int * seeds, int nSeeds )
+{
+    BookNode * nodes = build->nodes;
+    BookNode * node;
+    BookNode * parent;
+    int heads[65];          // nodes to update by number of discs: parents always come first
+    int i, b, x, link, dropout;
+
+    for( b = 0; b < 65; b++ )
+    {
+        heads[b] = -1;
+    }
+    for( i = 0; i < nSeeds; i++ )
+    {   // a new score changes the losses into the node and out of it
+        pushBookDropout( build, heads, seeds[i] );
+        for( b = 0; nodes[seeds[i]].expanded && b < nodes[seeds[i]].nChildren; b++ )
+        {
+            pushBookDropout( build, heads, build->children[nodes[seeds[i]].firstChild + b] );
+        }
+    }
+    for( b = 0; b < 65; b++ )
+    {
+        while( 0 <= heads[b] )
+        {   // a pass child has as many discs as its parent, and is pushed onto the same list
+            x = heads[b];
+            node = &nodes[x];
+            heads[b] = build->work[x];
+            node->queued = false;
+            dropout = 0 == x ? 0 : SEARCH_INFINITY;
+            for( link = node->firstParent; 0 <= link; link = build->links[link].next )
+            {
+                parent = &nodes[build->links[link].parent];
+                if( parent->expanded && parent->dropout < SEARCH_INFINITY
+                    && parent->dropout + parent->score + node->score < dropout )
+                {
+                    dropout = parent->dropout + parent->score + node->score;
+                }
+            }
+            if( dropout == node->dropout )
+            {
+                continue;
+            }
+            node->dropout = dropout;
+            for( i = 0; node->expanded && i < node->nChildren; i++ )
+            {
+                pushBookDropout( build, heads, build->children[node->firstChild + i] );
+            }
+            if( !node->expanded && !node->terminal && node->evaluated && dropout < SEARCH_INFINITY )
+            {
+                pushBookLeaf( build, x );
+            }
+        }
+    }
+}
+
+
+void pushBookDropout( BookBuildContext * build, int * heads, int node )
+{
+    int discs = __builtin_popcountll( build->nodes[node].black | build->nodes[node].white );
+
+    if( !build->nodes[node].queued )
+    {
+        build->nodes[node].queued = true;
+        build->work[node] = heads[discs];
+        heads[discs] = node;
+    }
+}
+
+
+void pushBookLeaf( BookBuildContext * build, int node )
+{
+    BookLeaf * grown;
+    BookLeaf leaf;
+    int i = build->nHeap;
+
+    if( build->nHeap == build->heapCapacity )
+    {
+        build->heapCapacity = 2 * build->heapCapacity + 1024;
+        grown = realloc( build->heap, build->heapCapacity * sizeof( BookLeaf ) );
+        assert( NULL != grown );
+        build->heap = grown;
+    }
+    leaf.dropout = build->nodes[node].dropout;
+    leaf.node = node;
+    for( ; 0 < i && build->heap[( i - 1 ) / 2].dropout > leaf.dropout; i = ( i - 1 ) / 2 )
+    {
+        build->heap[i] = build->heap[( i - 1 ) / 2];
+    }
+    build->heap[i] = leaf;
+    build->nHeap++;
+}
+
+
+int popBookLeaf( BookBuildContext * build )
+{
+    BookLeaf top, last;
+    const BookNode * node;
+    int i, child;
+
+    while( 0 < build->nHeap )
+    {
+        top = build->heap[0];
+        last = build->heap[--build->nHeap];
+        for( i = 0; ( child = 2 * i + 1 ) < build->nHeap; i = child )
+        {
+            if( child + 1 < build->nHeap && build->heap[child + 1].dropout < build->heap[child].dropout )
+            {
+                child++;
+            }
+            if( build->heap[child].dropout >= last.dropout )
+            {
+                break;
+            }
+            build->heap[i] = build->heap[child];
+        }
+        build->heap[i] = last;
+        node = &build->nodes[top.node];
+        if( !node->expanded && !node->terminal && top.dropout == node->dropout )
+        {   // entries of leaves whose drop-out has changed since are stale
+            return top.node;
+        }
+    }
+    return -1;
+}
+
+
+void makeBookRecord( const BookNode * node, BookRecord * record )
+{
+    GameBoard board;
+    int transform, row = node->bestRow, col = node->bestCol;
+
+    memset( record, 0, sizeof( BookRecord ) );
+    unpackBitboards( node->black, node->white, node->player, &board );
+    record->key = canonicalHash( &board, &transform );
+    transformCell( transform, 8, 8, &row, &col );
+    record->row = (int8_t)row;
+    record->col = (int8_t)col;
+    record->score = (int16_t)node->score;
+    record->depth = (uint8_t)( node->depth < 255 ? node->depth : 255 );
+}
+
+
+boolean mergeBookJournal( const char * path )
+{
+    char journalPath[MAX_INPUT_PATH + 8];
+    FILE * journal;
+    OpeningBook * book = NULL;
+    BookRecord * records = NULL;
+    BookRecord * grown;
+    KeyIndex index;
+    size_t nRecords = 0, nBook = 0, capacity = 0, nUnique = 0, i;
+    int found;
+    boolean success = true;
+
+    snprintf( journalPath, sizeof( journalPath ), "%s.journal", path );
+    journal = fopen( journalPath, "rb" );
+    if( NULL == journal )
+    {   // the last run finished cleanly
+        return true;
+    }
+    if( 0 == access( path, F_OK ) )
+    {
+        book = openOpeningBook( path );
+        success = NULL != book;
+    }
+    if( NULL != book )
+    {
+        capacity = book->header->nRecords + 1024;
+        records = malloc( capacity * sizeof( BookRecord ) );
+        assert( NULL != records );
+        memcpy( records, book->records, book->header->nRecords * sizeof( BookRecord ) );
+        nRecords = book->header->nRecords;
+        closeOpeningBook( book );
+    }
+    nBook = nRecords;
+    while( success )
+    {   // a record torn by an interrupted write is left out
+        if( nRecords == capacity )
+        {
+            capacity = 2 * capacity + 1024;
+            grown = realloc( records, capacity * sizeof( BookRecord ) );
+            assert( NULL != grown );
+            records = grown;
+        }
+        if( 1 != fread( &records[nRecords], sizeof( BookRecord ), 1, journal ) )
+        {
+            break;
+        }
+        nRecords++;
+    }
+    fclose( journal );
+
+    // the journal holds the later values: the last record of a key wins
+    initKeyIndex( &index );
+    for( i = 0; success && i < nRecords; i++ )
+    {
+        found = lookupKeyIndex( &index, records[i].key );
+        if( 0 <= found )
+        {
+            records[found] = records[i];
+        }
+        else
+        {
+            insertKeyIndex( &index, records[i].key, (int)nUnique );
+            records[nUnique++] = records[i];
+        }
+    }
+    freeKeyIndex( &index );
+    if( success )
+    {
+        fprintf( stderr, "book: %zu journal record(s) of an interrupted run merged into '%s'\n", nRecords - nBook, path );
+        success = writeOpeningBook( path, records, nUnique ) && 0 == unlink( journalPath );
+    }
+    free( records );
+    return success;
+}
+
+
+boolean runBookBuilder( const Options * options )
+{
+    BookBuildContext build;
+    BookRecord * records;
+    BookRecord written;
+    OpeningBook * book = NULL;
+    const BookRecord * record;
+    FILE * journal = NULL;
+    char journalPath[MAX_INPUT_PATH + 8];
+    GameBoard board;
+    MoveUndo undo;
+    int * expanded = NULL;  // nodes expanded in the last round, whose values are to be backed up
+    int * all;
+    int * grown;
+    int cells[MAX_MOVES];
+    int nExpanded = 0, nEvaluated = 0, nAdded = 0, batch;
+    int i, j, k, head, node, nRecords, transform;
+    int nStart, nBefore;
+    boolean first = true;
+    boolean success;
+    double start = currentSeconds( );
+
+    memset( &build, 0, sizeof( BookBuildContext ) );
+    build.options = options;
+    initKeyIndex( &build.index );
+    snprintf( journalPath, sizeof( journalPath ), "%s.journal", options->buildBookFile );
+    success = mergeBookJournal( options->buildBookFile );
+    if( success && 0 == access( options->buildBookFile, F_OK ) )
+    {   // resume or grow an earlier book
+        book = openOpeningBook( options->buildBookFile );
+        success = NULL != book;
+    }
+    initStartBoard( &board, 8, 8 );
+    addBookNode( &build, &board );
+
+    // rebuild the tree of the existing book: a node whose children are in the book was expanded
+    for( head = 0; success && NULL != book && head < build.nNodes; head++ )
+    {
+        record = lookupOpeningBook( book, build.nodes[head].key );
+        if( NULL == record )
+        {
+            continue;
+        }
+        build.nodes[head].evaluated = true;
+        build.nodes[head].score = record->score;
+        build.nodes[head].depth = record->depth;
+        build.nodes[head].bestRow = record->row;
+        build.nodes[head].bestCol = record->col;
+        unpackBitboards( build.nodes[head].black, build.nodes[head].white, build.nodes[head].player, &board );
+        canonicalHash( &board, &transform );
+        inverseTransformCell( transform, 8, 8, &build.nodes[head].bestRow, &build.nodes[head].bestCol );
+        k = generateMoves( &board, cells );
+        if( 0 == k )
+        {   // the only way on is a pass, whose child was added when the node was expanded
+            passMove( &board, &undo );
+            build.nodes[head].terminal = 0 == generateMoves( &board, NULL );
+            undoMove( &board, &undo );
+            cells[0] = -1;
+            k = build.nodes[head].terminal ? 0 : 1;
+        }
+        build.nodes[head].expanded = 0 < k;
+        for( i = 0; i < k; i++ )
+        {
+            if( cells[i] < 0 )
+            {
+                passMove( &board, &undo );
+            }
+            else
+            {
+                playMove( &board, cells[i] / MAX_BOARD_COLUMNS, cells[i] % MAX_BOARD_COLUMNS, &undo );
+            }
+            if( NULL == lookupOpeningBook( book, canonicalHash( &board, NULL ) ) )
+            {   // reached by transposition only: still a leaf
+                build.nodes[head].expanded = false;
+            }
+            undoMove( &board, &undo );
+        }
+        for( i = 0; build.nodes[head].expanded && i < k; i++ )
+        {
+            if( cells[i] < 0 )
+            {
+                passMove( &board, &undo );
+            }
+            else
+            {
+                playMove( &board, cells[i] / MAX_BOARD_COLUMNS, cells[i] % MAX_BOARD_COLUMNS, &undo );
+            }
+            node = addBookNode( &build, &board );
+            addBookChild( &build, head, node, cells[i] );
+            undoMove( &board, &undo );
+        }
+    }
+    if( NULL != book )
+    {
+        fprintf( stderr, "book: resumed %d position(s) from '%s'\n", build.nNodes, options->buildBookFile );
+        closeOpeningBook( book );
+    }
+    nStart = build.nNodes;
+    if( success && NULL == ( journal = fopen( journalPath, "wb" ) ) )
+    {
+        fprintf( stderr, "reversi: cannot create '%s': %s\n", journalPath, strerror( errno ) );
+        success = false;
+    }
+
+    // every round only touches what changed: the new leaves, the values they change
+    // on their way up, and the drop-outs below those
+    batch = options->nThreads > 1 ? options->nThreads : 1;
+    expanded = malloc( batch * sizeof( int ) );
+    assert( NULL != expanded );
+    while( success )
+    {
+        // worklists are indexed by node
+        if( build.workCapacity < build.nNodes )
+        {
+            build.workCapacity = 2 * build.nNodes;
+            grown = realloc( build.work, build.workCapacity * sizeof( int ) );
+            assert( NULL != grown );
+            build.work = grown;
+        }
+
+        // evaluate the nodes added since the last round, the root of a new book included;
+        // a finished game is scored exactly by the search
+        build.leaves = realloc( build.leaves, ( build.nNodes - nEvaluated + 1 ) * sizeof( int ) );
+        assert( NULL != build.leaves );
+        build.nLeaves = 0;
+        for( i = nEvaluated; i < build.nNodes; i++ )
+        {
+            if( !build.nodes[i].evaluated )
+            {
+                build.leaves[build.nLeaves++] = i;
+            }
+        }
+        nEvaluated = build.nNodes;
+        runWorkerPool( options->nThreads, build.nLeaves, evaluateBookLeafJob, &build );
+        for( i = 0; i < build.nLeaves; i++ )
+        {
+            markBookNode( &build, build.leaves[i] );
+        }
+
+        // minimax back-up from the nodes expanded last round (from every expanded node
+        // of a resumed book), then the drop-out of every node whose line changed: how much
+        // worse than best play the cheapest line from the start to it is
+        if( first )
+        {
+            all = malloc( build.nNodes * sizeof( int ) );
+            assert( NULL != all );
+            for( i = 0; i < build.nNodes; i++ )
+            {
+                all[i] = i;
+            }
+            backUpBookNodes( &build, all, build.nNodes );
+            updateBookDropouts( &build, all, build.nNodes );
+            free( all );
+            first = false;
+        }
+        else
+        {
+            backUpBookNodes( &build, expanded, nExpanded );
+            updateBookDropouts( &build, build.dirty, build.nDirty );
+        }
+
+        // journal what changed, so an interrupted build loses at most one round
+        for( i = 0; i < build.nDirty; i++ )
+        {
+            node = build.dirty[i];
+            build.nodes[node].dirty = false;
+            if( build.nodes[node].evaluated || build.nodes[node].expanded )
+            {
+                makeBookRecord( &build.nodes[node], &written );
+                success = success && 1 == fwrite( &written, sizeof( BookRecord ), 1, journal );
+            }
+        }
+        build.nDirty = 0;
+        success = success && 0 == fflush( journal ) && 0 == fsync( fileno( journal ) );
+        if( !success || nAdded >= options->bookNodes )
+        {
+            break;
+        }
+
+        // expand the leaves with the smallest drop-out
+        nExpanded = 0;
+        while( nExpanded < batch && nAdded < options->bookNodes && 0 <= ( node = popBookLeaf( &build ) ) )
+        {
+            nBefore = build.nNodes;
+            unpackBitboards( build.nodes[node].black, build.nodes[node].white, build.nodes[node].player, &board );
+            j = generateMoves( &board, cells );
+            if( 0 == j )
+            {   // the only way on is a pass
+                passMove( &board, &undo );
+                if( 0 == generateMoves( &board, NULL ) )
+                {
+                    build.nodes[node].terminal = true;
+                    continue;
+                }
+                cells[0] = -1;
+                j = 1;
+                undoMove( &board, &undo );
+            }
+            for( i = 0; i < j; i++ )
+            {
+                if( cells[i] < 0 )
+                {
+                    passMove( &board, &undo );
+                }
+                else
+                {
+                    playMove( &board, cells[i] / MAX_BOARD_COLUMNS, cells[i] % MAX_BOARD_COLUMNS, &undo );
+                }
+                k = addBookNode( &build, &board );
+                addBookChild( &build, node, k, cells[i] );
+                undoMove( &board, &undo );
+            }
+            build.nodes[node].expanded = true;
+            expanded[nExpanded++] = node;
+            nAdded += build.nNodes - nBefore; // transposed children are in the book already
+        }
+        if( 0 == nExpanded )
+        {
+            break;
+        }
+    }
+    if( NULL != journal && 0 != fclose( journal ) )
+    {
+        success = false;
+    }
+
+    // the full book is written once, at the end; the journal is then no longer needed
+    if( success )
+    {
+        records = malloc( ( build.nNodes + 1 ) * sizeof( BookRecord ) );
+        assert( NULL != records );
+        for( i = 0, nRecords = 0; i < build.nNodes; i++ )
+        {
+            if( build.nodes[i].evaluated || build.nodes[i].expanded )
+            {
+                makeBookRecord( &build.nodes[i], &records[nRecords++] );
+            }
+        }
+        success = writeOpeningBook( options->buildBookFile, records, nRecords ) && 0 == unlink( journalPath );
+        free( records );
+    }
+    if( success )
+    {
+        fprintf( stderr, "book: %d position(s) (%d new), %lu node(s) searched in %.3f s\n",
+            build.nNodes, build.nNodes - nStart, build.nodesSearched, currentSeconds( ) - start );
+    }
+    free( expanded );
+    free( build.leaves );
+    free( build.work );
+    free( build.dirty );
+    free( build.heap );
+    free( build.links );
+    free( build.children );
+    free( build.childCells );
+    free( build.nodes );
+    freeKeyIndex( &build.index );
+    return success;
+}
+
+
+Tablebase * openTablebase( const char * path )
+{
+    Tablebase * tablebase = calloc( 1, sizeof( Tablebase ) );
+    struct stat info;
+    void * mapped = MAP_FAILED;
+    int fd = open( path, O_RDONLY );
+    boolean success = false;
+
+    assert( NULL != tablebase );
+    if( fd >= 0 && 0 == fstat( fd, &info ) && info.st_size >= (off_t)sizeof( TablebaseHeader ) )
+    {
+        mapped = mmap( NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    }
+    if( MAP_FAILED != mapped )
+    {
+        tablebase->header = mapped;
+        tablebase->records = (const TablebaseRecord *)( tablebase->header + 1 );
+        tablebase->mappedSize = info.st_size;
+        success = 0 == memcmp( tablebase->header->magic, TABLEBASE_MAGIC, sizeof( TABLEBASE_MAGIC ) )
+            && TABLEBASE_VERSION == tablebase->header->version
+            && sizeof( TablebaseRecord ) == tablebase->header->recordSize
+            && 0 != tablebase->header->capacity
+            && 0 == ( tablebase->header->capacity & ( tablebase->header->capacity - 1 ) )
+            && tablebase->header->nRecords < tablebase->header->capacity
+            && sizeof( TablebaseHeader ) + tablebase->header->capacity * sizeof( TablebaseRecord ) <= (uint64_t)info.st_size;
+        if( success )
+        {
+            madvise( mapped, info.st_size, MADV_RANDOM );
+        }
+    }
+    if( fd >= 0 )
+    {
+        close( fd );
+    }
+    if( !success )
+    {
+        fprintf( stderr, "reversi: '%s' is not a readable tablebase\n", path );
+        if( MAP_FAILED != mapped )
+        {
+            munmap( mapped, info.st_size );
+        }
+        free( tablebase );
+        tablebase = NULL;
+    }
+    return tablebase;
+}
+
+
+void closeTablebase( Tablebase * tablebase )
+{
+    if( NULL != tablebase )
+    {
+        fprintf( stderr, "tablebase: %lu of %lu lookup(s) found in %llu %ux%u position(s)\n",
+            tablebase->nHits, tablebase->nLookups, (unsigned long long)tablebase->header->nRecords,
+            tablebase->header->nColumns, tablebase->header->nRows );
+        munmap( (void *)tablebase->header, tablebase->mappedSize );
+        free( tablebase );
+    }
+}
+
+
+TablebaseRecord * findTablebaseSlot( const TablebaseRecord * records, uint64_t capacity, uint64_t key )
+{
+    uint64_t slot = key & ( capacity - 1 );
+
+    while( records[slot].used && records[slot].key != key )
+    {
+        slot = ( slot + 1 ) & ( capacity - 1 );
+    }
+    return (TablebaseRecord *)&records[slot];
+}
+
+
+const TablebaseRecord * lookupTablebase( Tablebase * tablebase, const GameBoard * board, int * transform )
+{
+    const TablebaseRecord * found = NULL;
+
+    if( (uint32_t)board->nRows == tablebase->header->nRows && (uint32_t)board->nColumns == tablebase->header->nColumns )
+    {
+        found = findTablebaseSlot( tablebase->records, tablebase->header->capacity, canonicalHash( board, transform ) );
+        if( !found->used )
+        {
+            found = NULL;
+        }
+        __atomic_fetch_add( &tablebase->nLookups, 1, __ATOMIC_RELAXED );
+        if( NULL != found )
+        {
+            __atomic_fetch_add( &tablebase->nHits, 1, __ATOMIC_RELAXED );
+        }
+    }
+    return found;
+}
+
+
+int solveTablebasePosition( TablebaseSolver * solver, GameBoard * board )
+{
+    TablebaseRecord * records;
+    TablebaseRecord * slot;
+    MoveUndo undo;
+    int cells[MAX_MOVES];
+    int nMoves, i, score, transform;
+    int best = -TABLEBASE_MAX_CELLS - 1;
+    int bestRow = -1;
+    int bestCol = -1;
+    uint64_t key = canonicalHash( board, &transform );
+    uint64_t j;
+
+    slot = findTablebaseSlot( solver->records, solver->capacity, key );
+    if( slot->used )
+    {
+        return slot->score;
+    }
+    solver->nodes++;
+    nMoves = generateMoves( board, cells );
+    for( i = 0; i < nMoves; i++ )
+    {
+        playMove( board, cells[i] / MAX_BOARD_COLUMNS, cells[i] % MAX_BOARD_COLUMNS, &undo );
+        score = -solveTablebasePosition( solver, board );
+        undoMove( board, &undo );
+        if( score > best )
+        {
+            best = score;
+            bestRow = cells[i] / MAX_BOARD_COLUMNS;
+            bestCol = cells[i] % MAX_BOARD_COLUMNS;
+        }
+    }
+    if( 0 == nMoves )
+    {
+        passMove( board, &undo );
+        if( 0 == generateMoves( board, NULL ) )
+        {   // neither side can move: the game is over
+            best = -discDifference( board );
+        }
+        else
+        {
+            best = -solveTablebasePosition( solver, board );
+        }
+        undoMove( board, &undo );
+    }
+
+    if( 2 * ( solver->nRecords + 1 ) > solver->capacity )
+    {   // keep the load under one half
+        records = calloc( 2 * solver->capacity, sizeof( TablebaseRecord ) );
+        assert( NULL != records );
+        for( j = 0; j < solver->capacity; j++ )
+        {
+            if( solver->records[j].used )
+            {
+                *findTablebaseSlot( records, 2 * solver->capacity, solver->records[j].key ) = solver->records[j];
+            }
+        }
+        free( solver->records );
+        solver->records = records;
+        solver->capacity *= 2;
+    }
+    slot = findTablebaseSlot( solver->records, solver->capacity, key );
+    transformCell( transform, board->nRows, board->nColumns, &bestRow, &bestCol );
+    slot->key = key;
+    slot->score = (int8_t)best;
+    slot->row = (int8_t)bestRow;
+    slot->col = (int8_t)bestCol;
+    slot->used = 1;
+    solver->nRecords++;
+    return best;
+}
+
+
+boolean makeTablebase( const Options * options )
+{
+    char temporary[MAX_INPUT_PATH + 8];
+    TablebaseSolver solver;
+    TablebaseHeader header;
+    GameBoard board;
+    FILE * file;
+    int score;
+    boolean success = false;
+    double start = currentSeconds( );
+
+    memset( &solver, 0, sizeof( TablebaseSolver ) );
+    solver.capacity = 1 << 16;
+    solver.records = calloc( solver.capacity, sizeof( TablebaseRecord ) );
+    assert( NULL != solver.records );
+    initStartBoard( &board, options->tablebaseSize, options->tablebaseSize );
+    score = solveTablebasePosition( &solver, &board );
+
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, TABLEBASE_MAGIC, sizeof( TABLEBASE_MAGIC ) );
+    header.version = TABLEBASE_VERSION;
+    header.recordSize = sizeof( TablebaseRecord );
+    header.nRows = board.nRows;
+    header.nColumns = board.nColumns;
+    header.nRecords = solver.nRecords;
+    header.capacity = solver.capacity;
+    snprintf( temporary, sizeof( temporary ), "%s.tmp", options->makeTablebaseFile );
+    file = fopen( temporary, "wb" );
+    if( NULL != file )
+    {
+        success = 1 == fwrite( &header, sizeof( header ), 1, file )
+            && solver.capacity == fwrite( solver.records, sizeof( TablebaseRecord ), solver.capacity, file );
+        success = 0 == fclose( file ) && success;
+        success = success && 0 == rename( temporary, options->makeTablebaseFile );
+    }
+    if( success )
+    {
+        fprintf( stderr, "tablebase: %llu %dx%d position(s) solved in %.3f s, BLACK %+d under perfect play\n",
+            (unsigned long long)solver.nRecords, board.nColumns, board.nRows, currentSeconds( ) - start, score );
+    }
+    else
+    {
+        fprintf( stderr, "reversi: cannot write tablebase '%s': %s\n", options->makeTablebaseFile, strerror( errno ) );
+    }
+    free( solver.records );
+    return success;
+}
+
+
+uint64_t nextRandom( uint64_t * state )
+{
+    return mixHash( ( *state )++ );
+}
+
+
+int playSelfPlayGame( const Options * options, Engine * engine, GameBoard * board, uint64_t * random, int * moves )
+{
+    BoardMove best;
+    GameClock clocks[2];    // of BLACK and WHITE
+    int cells[MAX_MOVES];
+    int nMoves = 0;
+    int nPasses = 0;
+    int nLegal, cell;
+
+    resetEngine( engine );
+    clocks[0] = options->clock;
+    clocks[1] = options->clock;
+    while( nPasses < 2 && nMoves < MAX_GAME_MOVES )
+    {
+        nLegal = generateMoves( board, cells );
+        if( 0 == nLegal )
+        {
+            passMove( board, NULL );
+            moves[nMoves++] = -1;
+            nPasses++;
+        }
+        else
+        {
+            if( nMoves < options->randomPlies )
+            {
+                cell = cells[nextRandom( random ) % nLegal];
+            }
+            else
+            {
+                engine->clock = 0 < options->clock.remaining ? &clocks[BLACK == board->player ? 0 : 1] : NULL;
+                chooseEngineMove( engine, board, &best );
+                engine->clock = NULL;
+                if( !isLegalMove( board, best.row, best.col ) )
+                {   // a record of moves the engine never chose would mislead whatever learns from it
+                    return -1;
+                }
+                cell = best.row * MAX_BOARD_COLUMNS + best.col;
+            }
+            playMove( board, cell / MAX_BOARD_COLUMNS, cell % MAX_BOARD_COLUMNS, NULL );
+            moves[nMoves++] = cell;
+            nPasses = 0;
+        }
+    }
+    return 2 == nPasses ? nMoves - 2 : nMoves; // the two passes which ended the game are implied
+}
+
+
+void selfPlayJob( void * context, int index, int thread )
+{
+    SelfPlayContext * selfPlay = context;
+    const Options * options = selfPlay->options;
+    GameRecord game;
+    GameBoard board;
+    uint64_t random;
+    long number = (long)index * options->chunkSize;
+    long endNumber = number + options->chunkSize;
+    unsigned long nPositions = 0;
+    char * buffer = NULL;
+    size_t size = 0;
+    FILE * output = open_memstream( &buffer, &size );
+    Engine * engine = &selfPlay->engines[thread];
+
+    if( !engine->initialized )
+    {
+        initEngine( engine, &options->engine, options );
+    }
+    if( endNumber > options->selfPlayGames )
+    {
+        endNumber = options->selfPlayGames;
+    }
+    for( ; NULL != output && number < endNumber; number++ )
+    {
+        game.start = selfPlay->starts[number % selfPlay->nStarts];
+        game.customStart = !isStandardStart( &game.start );
+        board = game.start;
+        random = mixHash( options->seed ) ^ mixHash( (uint64_t)number );
+        game.nMoves = playSelfPlayGame( options, engine, &board, &random, game.moves );
+        if( 0 > game.nMoves )
+        {
+            __atomic_fetch_add( &selfPlay->nDropped, 1, __ATOMIC_RELAXED );
+            continue;
+        }
+        board.player = BLACK;
+        game.result = discDifference( &board );
+        nPositions += game.nMoves + 1;
+        if( NULL != options->outputFile )
+        {
+            writeGameRecord( output, &game );
+        }
+        else
+        {
+            printGameRecord( output, number, &game );
+        }
+    }
+    if( NULL != output )
+    {
+        fclose( output );
+    }
+    __atomic_fetch_add( &selfPlay->nPositions, nPositions, __ATOMIC_RELAXED );
+    // always submit, even on failure, so later chunks are not held back
+    submitOrderedOutput( &selfPlay->output, index, buffer, size );
+}
+
+
+boolean runSelfPlay( const Options * options )
+{
+    SelfPlayContext selfPlay;
+    GameBoard * grown;
+    FILE * input;
+    FILE * output = stdout;
+    int capacity = 0;
+    int i;
+    boolean success = true;
+    double seconds, start = currentSeconds( );
+
+    memset( &selfPlay, 0, sizeof( SelfPlayContext ) );
+    selfPlay.options = options;
+    for( i = 0; success && i < options->inputs.nPaths; i++ )
+    {
+        input = 0 == strcmp( options->inputs.paths[i], "-" ) ? stdin : fopen( options->inputs.paths[i], "r" );
+        if( NULL == input )
+        {
+            fprintf( stderr, "reversi: cannot open '%s': %s\n", options->inputs.paths[i], strerror( errno ) );
+            success = false;
+            break;
+        }
+        for( ;; )
+        {
+            if( selfPlay.nStarts == capacity )
+            {
+                capacity = 0 == capacity ? 64 : 2 * capacity;
+                grown = realloc( selfPlay.starts, capacity * sizeof( GameBoard ) );
+                assert( NULL != grown );
+                selfPlay.starts = grown;
+            }
+            if( !readGameBoard( input, &selfPlay.starts[selfPlay.nStarts] ) )
+            {
+                break;
+            }
+            selfPlay.nStarts++;
+        }
+        if( stdin != input )
+        {
+            fclose( input );
+        }
+    }
+    if( success && 0 == options->inputs.nPaths )
+    {
+        selfPlay.starts = malloc( sizeof( GameBoard ) );
+        assert( NULL != selfPlay.starts );
+        initStartBoard( selfPlay.starts, 8, 8 );
+        selfPlay.nStarts = 1;
+    }
+    if( success && 0 == selfPlay.nStarts )
+    {
+        fprintf( stderr, "reversi: no start position for self-play\n" );
+        success = false;
+    }
+    if( success && NULL != options->outputFile && NULL == ( output = openGameFile( options->outputFile ) ) )
+    {
+        success = false;
+    }
+    if( success )
+    {
+        selfPlay.nChunks = ( options->selfPlayGames + options->chunkSize - 1 ) / options->chunkSize;
+        initOrderedOutput( &selfPlay.output, output, (int)selfPlay.nChunks );
+        runWorkerPool( options->nThreads, (int)selfPlay.nChunks, selfPlayJob, &selfPlay );
+        freeOrderedOutput( &selfPlay.output );
+        if( stdout != output && 0 != fclose( output ) )
+        {
+            success = false;
+        }
+        seconds = currentSeconds( ) - start;
+        fprintf( stderr, "self-play: %ld game(s), %lu position(s) in %.3f s (%.1f games/s, %.1f positions/s)\n",
+            options->selfPlayGames - selfPlay.nDropped, selfPlay.nPositions, seconds,
+            seconds > 0 ? ( options->selfPlayGames - selfPlay.nDropped ) / seconds : 0.0,
+            seconds > 0 ? selfPlay.nPositions / seconds : 0.0 );
+        if( 0 < selfPlay.nDropped )
+        {
+            fprintf( stderr, "self-play: %ld game(s) dropped, the engine chose an illegal move\n", selfPlay.nDropped );
+        }
+    }
+    for( i = 1; i < MAX_WORKER_THREADS; i++ )
+    {
+        mergeEngineStats( &selfPlay.engines[0], &selfPlay.engines[i] );
+        freeEngine( &selfPlay.engines[i] );
+    }
+    if( success && ENGINE_GREEDY != options->engine.kind )
+    {
+        printEngineStats( &selfPlay.engines[0], stderr );
+    }
+    freeEngine( &selfPlay.engines[0] );
+    free( selfPlay.starts );
+    return success;
+}
+
+
+boolean isStandardStart( const GameBoard * board )
+{
+    GameBoard start;
+
+    initStartBoard( &start, board->nRows, board->nColumns );
+    return start.player == board->player && 0 == memcmp( start.state, board->state, sizeof( start.state ) );
+}
+
+
+FILE * openGameFile( const char * path )
+{
+    GameFileHeader header;
+    FILE * output = fopen( path, "a+b" );
+    boolean success = NULL != output;
+
+    if( success && 0 == fseek( output, 0, SEEK_END ) && 0 == ftell( output ) )
+    {   // a new file
+        memset( &header, 0, sizeof( header ) );
+        memcpy( header.magic, GAME_FILE_MAGIC, sizeof( GAME_FILE_MAGIC ) );
+        header.version = GAME_FILE_VERSION;
+        success = 1 == fwrite( &header, sizeof( header ), 1, output ) && 0 == fflush( output );
+    }
+    else if( success )
+    {   // appending: only to a game file of this version
+        rewind( output );
+        success = readGameFileHeader( output ) && 0 == fseek( output, 0, SEEK_END );
+        if( !success )
+        {
+            errno = EINVAL;
+        }
+    }
+    if( !success )
+    {
+        fprintf( stderr, "reversi: cannot append games to '%s': %s\n", path, strerror( errno ) );
+        if( NULL != output )
+        {
+            fclose( output );
+            output = NULL;
+        }
+    }
+    return output;
+}
+
+
+boolean readGameFileHeader( FILE * input )
+{
+    GameFileHeader header;
+
+    return 1 == fread( &header, sizeof( header ), 1, input )
+        && 0 == memcmp( header.magic, GAME_FILE_MAGIC, sizeof( GAME_FILE_MAGIC ) )
+        && GAME_FILE_VERSION == header.version;
+}
+
+
+boolean writeGameRecord( FILE * output, const GameRecord * game )
+{
+    GameRecordHeader header;
+    unsigned char bytes[GAME_RECORD_MAX_BYTES];
+    int nCells = game->start.nRows * game->start.nColumns;
+    int entrySize = nCells < GAME_SHORT_MOVE_CELLS ? 1 : 2;
+    int i, cell, row, col;
+    size_t nBytes = 0;
+
+    memset( &header, 0, sizeof( header ) );
+    header.nMoves = (uint16_t)game->nMoves;
+    header.nRows = (uint8_t)game->start.nRows;
+    header.nColumns = (uint8_t)game->start.nColumns;
+    header.flags = game->customStart ? GAME_CUSTOM_START : 0;
+    header.result = (int16_t)game->result;
+    if( 1 != fwrite( &header, sizeof( header ), 1, output ) )
+    {
+        return false;
+    }
+    if( game->customStart )
+    {
+        memset( bytes, 0, ( nCells + 3 ) / 4 + 1 );
+        bytes[nBytes++] = (unsigned char)game->start.player;
+        for( cell = 0; cell < nCells; cell++ )
+        {
+            bytes[nBytes + cell / 4] |= game->start.state[cell / game->start.nColumns][cell % game->start.nColumns] << ( 2 * ( cell % 4 ) );
+        }
+        nBytes += ( nCells + 3 ) / 4;
+    }
+    for( i = 0; i < game->nMoves; i++ )
+    {
+        row = game->moves[i] / MAX_BOARD_COLUMNS;
+        col = game->moves[i] % MAX_BOARD_COLUMNS;
+        cell = game->moves[i] < 0 ? 0xFFFF : row * game->start.nColumns + col;
+        bytes[nBytes++] = (unsigned char)( cell & 0xFF );
+        if( 2 == entrySize )
+        {
+            bytes[nBytes++] = (unsigned char)( cell >> 8 );
+        }
+    }
+    return nBytes == fwrite( bytes, 1, nBytes, output );
+}
+
+
+boolean readGameRecord( FILE * input, GameRecord * game )
+{
+    GameRecordHeader header;
+    unsigned char bytes[GAME_RECORD_MAX_BYTES];
+    int nCells, entrySize, i, cell, value;
+    size_t nBytes, offset = 0;
+    boolean success;
+
+    success = 1 == fread( &header, sizeof( header ), 1, input )
+        && 0 < header.nRows && header.nRows <= MAX_BOARD_ROWS
+        && 0 < header.nColumns && header.nColumns <= MAX_BOARD_COLUMNS
+        && header.nMoves <= MAX_GAME_MOVES;
+    if( !success )
+    {
+        return false;
+    }
+    nCells = header.nRows * header.nColumns;
+    entrySize = nCells < GAME_SHORT_MOVE_CELLS ? 1 : 2;
+    game->customStart = 0 != ( header.flags & GAME_CUSTOM_START );
+    game->nMoves = header.nMoves;
+    game->result = header.result;
+    nBytes = (size_t)header.nMoves * entrySize + ( game->customStart ? 1 + ( nCells + 3 ) / 4 : 0 );
+    if( nBytes > sizeof( bytes ) || nBytes != fread( bytes, 1, nBytes, input ) )
+    {
+        return false;
+    }
+    if( game->customStart )
+    {
+        memset( &game->start, 0, sizeof( GameBoard ) );
+        game->start.nRows = header.nRows;
+        game->start.nColumns = header.nColumns;
+        game->start.player = WHITE == bytes[offset++] ? WHITE : BLACK;
+        for( cell = 0; cell < nCells; cell++ )
+        {
+            value = ( bytes[offset + cell / 4] >> ( 2 * ( cell % 4 ) ) ) & 3;
+            if( NONE != value && BLACK != value && WHITE != value )
+            {   // no GameBoardCell: a damaged record
+                return false;
+            }
+            game->start.state[cell / header.nColumns][cell % header.nColumns] = value;
+        }
+        offset += ( nCells + 3 ) / 4;
+        snprintf( game->start.title, sizeof( game->start.title ), "START %dx%d", header.nColumns, header.nRows );
+    }
+    else
+    {
+        initStartBoard( &game->start, header.nRows, header.nColumns );
+    }
+    for( i = 0; i < game->nMoves; i++ )
+    {
+        cell = bytes[offset++];
+        if( 2 == entrySize )
+        {
+            cell |= bytes[offset++] << 8;
+        }
+        if( ( 1 == entrySize ? 0xFF : 0xFFFF ) == cell )
+        {
+            game->moves[i] = -1;
+        }
+        else if( cell < nCells )
+        {
+            game->moves[i] = cell / header.nColumns * MAX_BOARD_COLUMNS + cell % header.nColumns;
+        }
+        else
+        {   // off the board: a damaged record
+            return false;
+        }
+    }
+    return true;
+}
+
+
+int replayGame( const GameRecord * game, GameBoard * board, GameVisitor visit, void * context )
+{
+    int ply;
+
+    *board = game->start;
+    for( ply = 0; ply < game->nMoves; ply++ )
+    {
+        if( NULL != visit )
+        {
+            visit( context, board, ply, game->moves[ply] );
+        }
+        if( game->moves[ply] < 0 )
+        {
+            if( 0 != generateMoves( board, NULL ) )
+            {   // a pass is only legal without moves
+                break;
+            }
+            passMove( board, NULL );
+        }
+        else if( 0 == playMove( board, game->moves[ply] / MAX_BOARD_COLUMNS, game->moves[ply] % MAX_BOARD_COLUMNS, NULL ) )
+        {
+            break;
+        }
+    }
+    return ply;
+}
+
+
+void printGameRecord( FILE * output, long number, const GameRecord * game )
+{
+    int i;
+
+    if( game->customStart )
+    {
+        writeGameBoard( output, &game->start );
+    }
+    fprintf( output, "%ld %+d", number, game->result );
+    for( i = 0; i < game->nMoves; i++ )
+    {
+        if( game->moves[i] < 0 )
+        {
+            fprintf( output, " --" );
+        }
+        else
+        {
+            fprintf( output, " %c%d", game->moves[i] % MAX_BOARD_COLUMNS + 'a', game->moves[i] / MAX_BOARD_COLUMNS + 1 );
+        }
+    }
+    fprintf( output, "\n" );
+}
+
+
+boolean runReplay( const Options * options )
+{
+    GameRecord * game = malloc( sizeof( GameRecord ) );
+    GameBoard board;
+    FILE * input;
+    long nGames = 0;
+    unsigned long nPositions = 0;
+    int i, nMoves;
+    boolean success = true;
+    double seconds, start = currentSeconds( );
+
+    assert( NULL != game );
+    for( i = 0; i < options->inputs.nPaths; i++ )
+    {
+        input = 0 == strcmp( options->inputs.paths[i], "-" ) ? stdin : fopen( options->inputs.paths[i], "rb" );
+        if( NULL == input )
+        {
+            fprintf( stderr, "reversi: cannot open '%s': %s\n", options->inputs.paths[i], strerror( errno ) );
+            success = false;
+            continue;
+        }
+        if( !readGameFileHeader( input ) )
+        {
+            fprintf( stderr, "reversi: '%s' is not a game file\n", options->inputs.paths[i] );
+            success = false;
+        }
+        else
+        {
+            while( readGameRecord( input, game ) )
+            {
+                nMoves = replayGame( game, &board, NULL, NULL );
+                board.player = BLACK;
+                if( nMoves < game->nMoves || discDifference( &board ) != game->result )
+                {
+                    fprintf( stderr, "reversi: %s: game %ld does not replay\n", options->inputs.paths[i], nGames );
+                    success = false;
+                }
+                printGameRecord( stdout, nGames++, game );
+                nPositions += game->nMoves + 1;
+            }
+            if( !feof( input ) )
+            {
+                fprintf( stderr, "reversi: %s: damaged game record after game %ld\n", options->inputs.paths[i], nGames );
+                success = false;
+            }
+        }
+        if( stdin != input )
+        {
+            fclose( input );
+        }
+    }
+    seconds = currentSeconds( ) - start;
+    fprintf( stderr, "replay: %ld game(s), %lu position(s) in %.3f s (%.1f games/s)\n",
+        nGames, nPositions, seconds, seconds > 0 ? nGames / seconds : 0.0 );
+    free( game );
+    return success;
+}
+
+
+void createTranspositionTable( SearchContext * search, uint64_t nEntries )
+{
+    uint64_t size = 1;
+
+    search->table = NULL;
+    search->tableMask = 0;
+    if( 0 < nEntries )
+    {
+        while( 2 * size <= nEntries )
+        {
+            size *= 2;
+        }
+        search->table = calloc( size, sizeof( TranspositionEntry ) );
+        assert( NULL != search->table );
+        search->tableMask = size - 1;
+    }
+}
+
+
+void clearTranspositionTable( SearchContext * search )
+{
+    if( NULL != search->table && 0 == ++search->generation )
+    {   // the entries of generation 0 may be as old as the table
+        memset( search->table, 0, ( search->tableMask + 1 ) * sizeof( TranspositionEntry ) );
+    }
+}
+
+
+void freeTranspositionTable( SearchContext * search )
+{
+    free( search->table );
+    search->table = NULL;
+    search->tableMask = 0;
+}
+
+
+void storeTransposition( SearchContext * search, uint64_t key, int depth, int score, ScoreBound bound, int move )
+{
+    TranspositionEntry * entry;
+
+    if( NULL != search->table )
+    {
+        entry = &search->table[key & search->tableMask];
+        if( entry->key != key || entry->generation != search->generation || depth >= entry->depth )
+        {   // a deeper result of the same position is worth more than a shallower one
+            entry->key = key;
+            entry->generation = search->generation;
+            entry->score = (int16_t)score;
+            entry->move = (int16_t)move;
+            entry->depth = (uint8_t)depth;
+            entry->bound = (uint8_t)bound;
+        }
+    }
+}
+
+
+int searchIterative( SearchContext * search, GameBoard * board, int depth, BoardMove * best )
+{
+    BoardMove current;
+    int score = 0;
+    int result = 0;
+    int iteration;
+    int stable = 0;
+    int scores[2] = { 0, 0 }; // of the last iterations of each parity
+    boolean changed = true;
+    double start = currentSeconds( );
+    double softTime = search->softTime;
+    double iterationStart, now;
+
+    clearMoveOrdering( search );
+    search->stopped = false;
+    for( iteration = 1; iteration <= depth && !search->stopped; iteration++ )
+    {
+        if( 1 < iteration )
+        {
+            ageMoveOrdering( search );
+        }
+        iterationStart = currentSeconds( );
+        if( 1 == iteration || search->plain )
+        {
+            score = searchBestMove( search, board, iteration, &current );
+        }
+        else
+        {   // scores swing with the side to move at the leaves: expect that of the same parity
+            score = searchAspiration( search, board, iteration, scores[iteration & 1], &current );
+        }
+        if( !search->stopped )
+        {
+            scores[iteration & 1] = score;
+            scores[0] = 1 == iteration ? score : scores[0]; // until iteration 2 has its own
+        }
+        if( !search->stopped || 1 == iteration )
+        {   // an interrupted iteration only counts when there is nothing better
+            changed = 1 == iteration || current.row != best->row || current.col != best->col;
+            *best = current;
+            result = score;
+        }
+        if( !search->stopped && NULL != search->info )
+        {
+            printSearchInfo( search, board, best );
+        }
+        if( 0 < softTime && !search->stopped )
+        {   // under a clock: stop between iterations rather than in one
+            stable = changed ? 0 : stable + 1;
+            if( changed && 1 < iteration )
+            {   // the best move is in doubt: worth more time, within the hard limit
+                softTime *= TIME_INSTABILITY_FACTOR;
+            }
+            now = currentSeconds( );
+            if( now - start >= softTime
+                || ( STABLE_ITERATIONS <= stable && now - start >= softTime / 2 )
+                || ( 0 < search->deadline && now + ( now - iterationStart ) * ITERATION_TIME_GROWTH > search->deadline ) )
+            {
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+
+int principalVariation( const SearchContext * search, GameBoard * board, int * moves, int maxMoves )
+{
+    MoveUndo undo[MAX_PV_LENGTH];
+    const TranspositionEntry * entry;
+    uint64_t key;
+    int nMoves = 0;
+    int i;
+
+    if( maxMoves > MAX_PV_LENGTH )
+    {
+        maxMoves = MAX_PV_LENGTH;
+    }
+    while( NULL != search->table && nMoves < maxMoves )
+    {
+        key = hashGameBoard( board );
+        entry = &search->table[key & search->tableMask];
+        if( entry->key != key || entry->generation != search->generation || entry->move < 0
+            || 0 == playMove( board, entry->move / MAX_BOARD_COLUMNS, entry->move % MAX_BOARD_COLUMNS, &undo[nMoves] ) )
+        {
+            break;
+        }
+        moves[nMoves++] = entry->move;
+    }
+    for( i = nMoves - 1; i >= 0; i-- )
+    {
+        undoMove( board, &undo[i] );
+    }
+    return nMoves;
+}
+
+
+boolean readMoveList( FILE * input, GameRecord * game )
+{
+    GameBoard board;
+    char line[LINE_MAX];
+    char * word;
+    char * save;
+    int length, i, row, col;
+    boolean replaying = true; // until a move does not fit, whose game is left to its reader to reject
+
+    initStartBoard( &game->start, 8, 8 );
+    game->customStart = false;
+    game->result = 0;
+    game->nMoves = 0;
+    board = game->start;
+    while( 0 == game->nMoves && NULL != fgets( line, sizeof( line ), input ) )
+    {
+        for( word = strtok_r( line, " \t\r\n", &save ); NULL != word; word = strtok_r( NULL, " \t\r\n", &save ) )
+        {
+            length = strlen( word );
+            if( 0 == strcmp( word, "--" ) && game->nMoves < MAX_GAME_MOVES )
+            {
+                game->moves[game->nMoves++] = -1;
+                passMove( &board, NULL );
+                continue;
+            }
+            for( i = 0; i + 1 < length; i += 2 )
+            {   // one or more moves run together, such as f5d6c3
+                if( 'a' > ( word[i] | 0x20 ) || ( word[i] | 0x20 ) > 'h' || '1' > word[i + 1] || word[i + 1] > '8' )
+                {
+                    break;
+                }
+            }
+            if( i != length )
+            {   // not a move: a game number, a result or a word of a board
+                continue;
+            }
+            for( i = 0; i < length && game->nMoves < MAX_GAME_MOVES; i += 2 )
+            {
+                row = word[i + 1] - '1';
+                col = ( word[i] | 0x20 ) - 'a';
+                if( replaying && !isLegalMove( &board, row, col ) && 0 == generateMoves( &board, NULL ) )
+                {   // the pass a transcript leaves out, as WTHOR does, when the move is the opponent's
+                    passMove( &board, NULL );
+                    if( isLegalMove( &board, row, col ) && game->nMoves + 1 < MAX_GAME_MOVES )
+                    {
+                        game->moves[game->nMoves++] = -1;
+                    }
+                    else
+                    {
+                        passMove( &board, NULL ); // back to the side to move; the move stays illegal
+                    }
+                }
+                replaying = replaying && 0 != playMove( &board, row, col, NULL );
+                game->moves[game->nMoves++] = row * MAX_BOARD_COLUMNS + col;
+            }
+        }
+    }
+    return 0 < game->nMoves;
+}
+
+
+void annotateGameJob( void * context, int index, int thread )
+{
+    AnnotateContext * annotate = context;
+    const Options * options = annotate->options;
+    const GameRecord * game = &annotate->games[index];
+    SearchContext * search = &annotate->searches[thread];
+    GameBoard board;
+    BoardMove best;
+    int variation[MAX_PV_LENGTH];
+    int nVariation, ply, i;
+    long number = annotate->firstNumber + index;
+    char * buffer = NULL;
+    size_t size = 0;
+    FILE * output = open_memstream( &buffer, &size );
+
+    if( NULL == search->table )
+    {
+        createTranspositionTable( search, options->tableEntries );
+    }
+    clearTranspositionTable( search );
+    search->weights = options->weights;
+    board = game->start;
+    for( ply = 0; NULL != output && ply < game->nMoves; ply++ )
+    {
+        fprintf( output, "%ld.%d %s ", number, ply + 1, WHITE == board.player ? "WHITE" : "BLACK" );
+        if( game->moves[ply] < 0 )
+        {
+            fprintf( output, "--: pass\n" );
+        }
+        else
+        {
+            searchIterative( search, &board, options->searchDepth, &best );
+            nVariation = principalVariation( search, &board, variation, MAX_PV_LENGTH );
+            fprintf( output, "%c%d: best %c%d, score %+d at depth %d, pv",
+                game->moves[ply] % MAX_BOARD_COLUMNS + 'a', game->moves[ply] / MAX_BOARD_COLUMNS + 1,
+                best.col + 'a', best.row + 1, best.score, best.depth );
+            for( i = 0; i < nVariation; i++ )
+            {
+                fprintf( output, " %c%d", variation[i] % MAX_BOARD_COLUMNS + 'a', variation[i] / MAX_BOARD_COLUMNS + 1 );
+            }
+            fprintf( output, "\n" );
+        }
+        __atomic_fetch_add( &annotate->nPositions, 1, __ATOMIC_RELAXED );
+
+        // on to the next position with the move actually played
+        if( game->moves[ply] < 0 ? 0 != generateMoves( &board, NULL )
+            : 0 == playMove( &board, game->moves[ply] / MAX_BOARD_COLUMNS, game->moves[ply] % MAX_BOARD_COLUMNS, NULL ) )
+        {
+            fprintf( stderr, "reversi: game %ld: illegal move at ply %d\n", number, ply + 1 );
+            __atomic_fetch_add( &annotate->nFailed, 1, __ATOMIC_RELAXED );
+            break;
+        }
+        if( game->moves[ply] < 0 )
+        {
+            passMove( &board, NULL );
+        }
+    }
+    if( NULL != output )
+    {
+        fclose( output );
+    }
+    // always submit, even on failure, so later games are not held back
+    submitOrderedOutput( &annotate->output, index, buffer, size );
+}
+
+
+boolean runAnnotate( const Options * options )
+{
+    AnnotateContext * annotate = calloc( 1, sizeof( AnnotateContext ) );
+    FILE * input;
+    unsigned long nNodes = 0, nHits = 0;
+    long nGames = 0;
+    int batchSize = 4 * ( options->nThreads > 1 ? options->nThreads : 1 );
+    int i;
+    boolean binary;
+    boolean success = true;
+    double seconds, start = currentSeconds( );
+
+    assert( NULL != annotate );
+    annotate->options = options;
+    annotate->games = malloc( batchSize * sizeof( GameRecord ) );
+    assert( NULL != annotate->games );
+    for( i = 0; i < options->inputs.nPaths; i++ )
+    {
+        input = 0 == strcmp( options->inputs.paths[i], "-" ) ? stdin : fopen( options->inputs.paths[i], "rb" );
+        if( NULL == input )
+        {
+            fprintf( stderr, "reversi: cannot open '%s': %s\n", options->inputs.paths[i], strerror( errno ) );
+            success = false;
+            continue;
+        }
+        // a game file, or else text: standard input can only be text as it cannot be rewound
+        binary = stdin != input && readGameFileHeader( input );
+        if( !binary && stdin != input )
+        {
+            rewind( input );
+        }
+        do
+        {   // a batch of games at a time, so inputs of any size stream through
+            annotate->nGames = 0;
+            while( annotate->nGames < batchSize
+                && ( binary ? readGameRecord( input, &annotate->games[annotate->nGames] )
+                    : readMoveList( input, &annotate->games[annotate->nGames] ) ) )
+            {
+                annotate->nGames++;
+            }
+            annotate->firstNumber = nGames;
+            initOrderedOutput( &annotate->output, stdout, annotate->nGames );
+            runWorkerPool( options->nThreads, annotate->nGames, annotateGameJob, annotate );
+            freeOrderedOutput( &annotate->output );
+            nGames += annotate->nGames;
+        }
+        while( annotate->nGames == batchSize );
+        if( binary && !feof( input ) )
+        {
+            fprintf( stderr, "reversi: %s: damaged game record after game %ld\n", options->inputs.paths[i], nGames );
+            success = false;
+        }
+        if( stdin != input )
+        {
+            fclose( input );
+        }
+    }
+    for( i = 0; i < MAX_WORKER_THREADS; i++ )
+    {
+        nNodes += annotate->searches[i].nodes;
+        nHits += annotate->searches[i].tableHits;
+        freeTranspositionTable( &annotate->searches[i] );
+    }
+    seconds = currentSeconds( ) - start;
+    fprintf( stderr, "annotate: %ld game(s), %lu position(s), %lu node(s) (%.0f per position), %lu table hit(s) in %.3f s\n",
+        nGames, annotate->nPositions, nNodes, annotate->nPositions > 0 ? (double)nNodes / annotate->nPositions : 0.0,
+        nHits, seconds );
+    if( 0 < annotate->nFailed )
+    {
+        fprintf( stderr, "annotate: %lu game(s) with an illegal move\n", annotate->nFailed );
+        success = false;
+    }
+    free( annotate->games );
+    free( annotate );
+    return success;
+}
+
+
+boolean openWthorFile( const char * path, WthorFile * file )
+{
+    unsigned char header[WTHOR_HEADER_SIZE];
+    struct stat info;
+    boolean success = false;
+
+    memset( file, 0, sizeof( WthorFile ) );
+    file->path = path;
+    file->fd = open( path, O_RDONLY );
+    if( file->fd < 0 )
+    {
+        fprintf( stderr, "reversi: cannot open '%s': %s\n", path, strerror( errno ) );
+    }
+    else if( WTHOR_HEADER_SIZE != pread( file->fd, header, WTHOR_HEADER_SIZE, 0 ) || 0 != fstat( file->fd, &info ) )
+    {
+        fprintf( stderr, "reversi: '%s' is not a WTHOR file\n", path );
+    }
+    else if( 0 != header[12] && 8 != header[12] )
+    {
+        fprintf( stderr, "reversi: '%s' holds %dx%d games; only 8x8 is supported\n", path, header[12], header[12] );
+    }
+    else
+    {
+        file->nGames = (long)( header[4] | header[5] << 8 | header[6] << 16 | (uint32_t)header[7] << 24 );
+        if( WTHOR_HEADER_SIZE + file->nGames * WTHOR_GAME_SIZE > info.st_size )
+        {   // a truncated file: keep the complete games
+            fprintf( stderr, "reversi: '%s' is truncated\n", path );
+            file->nGames = ( info.st_size - WTHOR_HEADER_SIZE ) / WTHOR_GAME_SIZE;
+        }
+        success = true;
+    }
+    if( !success && file->fd >= 0 )
+    {
+        close( file->fd );
+        file->fd = -1;
+    }
+    return success;
+}
+
+
+boolean decodeWthorGame( const unsigned char * record, GameRecord * game )
+{
+    GameBoard board;
+    int i, row, col;
+
+    initStartBoard( &game->start, 8, 8 );
+    game->customStart = false;
+    game->nMoves = 0;
+    board = game->start;
+    for( i = 0; i < WTHOR_MAX_MOVES && 0 != record[WTHOR_MOVES_OFFSET + i]; i++ )
+    {
+        row = record[WTHOR_MOVES_OFFSET + i] / 10 - 1;
+        col = record[WTHOR_MOVES_OFFSET + i] % 10 - 1;
+        if( 0 == generateMoves( &board, NULL ) )
+        {   // the pass WTHOR leaves out
+            passMove( &board, NULL );
+            game->moves[game->nMoves++] = -1;
+        }
+        if( row < 0 || row >= 8 || col < 0 || col >= 8 || 0 == playMove( &board, row, col, NULL ) )
+        {
+            return false;
+        }
+        game->moves[game->nMoves++] = row * MAX_BOARD_COLUMNS + col;
+    }
+    board.player = BLACK;
+    game->result = discDifference( &board );
+    return true;
+}
+
+
+void importWthorJob( void * context, int index, int thread )
+{
+    WthorContext * import = context;
+    const Options * options = import->options;
+    const WthorFile * file = import->files;
+    unsigned char * records;
+    GameRecord * game = malloc( sizeof( GameRecord ) );
+    GameBoard board;
+    long first, number, nGames;
+    int ply;
+    unsigned long nPositions = 0, nDecoded = 0, nRejected = 0;
+    char * buffer = NULL;
+    size_t size = 0;
+    FILE * output = open_memstream( &buffer, &size );
+
+    (void)thread;
+    while( file + 1 < import->files + import->nFiles && file[1].firstJob <= index )
+    {
+        file++;
+    }
+    first = (long)( index - file->firstJob ) * options->chunkSize;
+    nGames = file->nGames - first < options->chunkSize ? file->nGames - first : options->chunkSize;
+    records = malloc( nGames * WTHOR_GAME_SIZE );
+    assert( NULL != game && NULL != records );
+    if( nGames * WTHOR_GAME_SIZE != pread( file->fd, records, nGames * WTHOR_GAME_SIZE, WTHOR_HEADER_SIZE + first * WTHOR_GAME_SIZE ) )
+    {
+        fprintf( stderr, "reversi: cannot read '%s': %s\n", file->path, strerror( errno ) );
+        nGames = 0;
+        nRejected++;
+    }
+    for( number = 0; NULL != output && number < nGames; number++ )
+    {
+        if( !decodeWthorGame( records + number * WTHOR_GAME_SIZE, game ) )
+        {
+            fprintf( stderr, "reversi: %s: game %ld has an illegal move, skipped\n", file->path, first + number );
+            nRejected++;
+            continue;
+        }
+        nDecoded++;
+        if( NULL != options->outputFile )
+        {
+            writeGameRecord( output, game );
+            nPositions += game->nMoves + 1;
+            continue;
+        }
+        board = game->start;
+        for( ply = 0; ply < game->nMoves; ply++ )
+        {
+            if( game->moves[ply] < 0 )
+            {
+                passMove( &board, NULL );
+                continue;
+            }
+            snprintf( board.title, sizeof( board.title ), "%s game %ld ply %d", file->path, first + number, ply + 1 );
+            writeGameBoard( output, &board );
+            playMove( &board, game->moves[ply] / MAX_BOARD_COLUMNS, game->moves[ply] % MAX_BOARD_COLUMNS, NULL );
+            nPositions++;
+        }
+    }
+    if( NULL != output )
+    {
+        fclose( output );
+    }
+    __atomic_fetch_add( &import->nGames, nDecoded, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &import->nPositions, nPositions, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &import->nRejected, nRejected, __ATOMIC_RELAXED );
+    // always submit, even on failure, so later chunks are not held back
+    submitOrderedOutput( &import->output, index, buffer, size );
+    free( records );
+    free( game );
+}
+
+
+boolean runImportWthor( const Options * options )
+{
+    WthorContext import;
+    FILE * output = stdout;
+    int i;
+    boolean success = 0 < options->inputs.nPaths;
+    double seconds, start = currentSeconds( );
+
+    memset( &import, 0, sizeof( WthorContext ) );
+    import.options = options;
+    import.files = calloc( options->inputs.nPaths + 1, sizeof( WthorFile ) );
+    assert( NULL != import.files );
+    if( !success )
+    {
+        fprintf( stderr, "reversi: --import-wthor needs WTHOR files\n" );
+    }
+    for( i = 0; success && i < options->inputs.nPaths; i++ )
+    {
+        success = openWthorFile( options->inputs.paths[i], &import.files[i] );
+        import.files[i].firstJob = import.nJobs;
+        import.nJobs += ( import.files[i].nGames + options->chunkSize - 1 ) / options->chunkSize;
+        import.nFiles++;
+    }
+    if( success && NULL != options->outputFile && NULL == ( output = openGameFile( options->outputFile ) ) )
+    {
+        success = false;
+    }
+    if( success )
+    {
+        initOrderedOutput( &import.output, output, import.nJobs );
+        runWorkerPool( options->nThreads, import.nJobs, importWthorJob, &import );
+        freeOrderedOutput( &import.output );
+        if( stdout != output && 0 != fclose( output ) )
+        {
+            success = false;
+        }
+        seconds = currentSeconds( ) - start;
+        fprintf( stderr, "wthor: %lu game(s), %lu position(s) from %d file(s) in %.3f s (%.1f games/s), %lu rejected\n",
+            import.nGames, import.nPositions, import.nFiles, seconds, seconds > 0 ? import.nGames / seconds : 0.0,
+            import.nRejected );
+    }
+    for( i = 0; i < import.nFiles; i++ )
+    {
+        if( import.files[i].fd >= 0 )
+        {
+            close( import.files[i].fd );
+        }
+    }
+    free( import.files );
+    return success;
+}
+
+
+boolean writeNpyHeader( FILE * output, uint64_t nRecords )
+{
+    char header[NPY_HEADER_SIZE];
+    int length;
+
+    memset( header, ' ', sizeof( header ) );
+    memcpy( header, "\x93NUMPY\x01\x00", 8 );
+    header[8] = (char)( ( NPY_HEADER_SIZE - 10 ) & 0xFF );
+    header[9] = (char)( ( NPY_HEADER_SIZE - 10 ) >> 8 );
+    length = snprintf( header + 10, sizeof( header ) - 10,
+        "{'descr': [('planes', '|u1', (2, 8, 8)), ('score', '<i2'), ('side', '|u1'), ('result', '|i1'), "
+        "('best', '|i1'), ('played', '|i1'), ('ply', '|u1'), ('empties', '|u1')], "
+        "'fortran_order': False, 'shape': (%llu,), }", (unsigned long long)nRecords );
+    header[10 + length] = ' '; // pad with blanks up to the closing newline
+    header[NPY_HEADER_SIZE - 1] = '\n';
+    return 1 == fwrite( header, sizeof( header ), 1, output );
+}
+
+
+void labelDatasetJob( void * context, int index, int thread )
+{
+    DatasetContext * dataset = context;
+    const Options * options = dataset->options;
+    DatasetRecord * record;
+    SearchContext search;
+    GameBoard board;
+    BoardMove best;
+    int i, cell;
+    int first = index * options->chunkSize;
+    int end = first + options->chunkSize < dataset->nRecords ? first + options->chunkSize : dataset->nRecords;
+
+    (void)thread;
+    memset( &search, 0, sizeof( SearchContext ) );
+    search.weights = options->weights;
+    for( i = first; i < end; i++ )
+    {
+        record = &dataset->records[i];
+        memset( &board, 0, sizeof( GameBoard ) );
+        board.nRows = 8;
+        board.nColumns = 8;
+        board.player = 0 == record->side ? BLACK : WHITE;
+        for( cell = 0; cell < 64; cell++ )
+        {
+            board.state[cell / 8][cell % 8] = record->planes[0][cell / 8][cell % 8] ? BLACK
+                : record->planes[1][cell / 8][cell % 8] ? WHITE : NONE;
+        }
+        clearMoveOrdering( &search );
+        record->score = (int16_t)searchBestMove( &search, &board, options->searchDepth, &best );
+        record->best = (int8_t)( best.row < 0 ? -1 : best.row * 8 + best.col );
+    }
+    __atomic_fetch_add( &dataset->nNodes, search.nodes, __ATOMIC_RELAXED );
+}
+
+
+boolean runExportDataset( const Options * options )
+{
+    DatasetContext dataset;
+    DatasetRecord * record;
+    KeyIndex seen;          // hashGameBoard() of the positions written
+    GameRecord * game = malloc( sizeof( GameRecord ) );
+    GameBoard board;
+    FILE * input;
+    FILE * output;
+    uint64_t nWritten = 0;
+    long nGames = 0, nSkipped = 0;
+    int i, ply, row, col;
+    boolean more;
+    boolean success = true;
+    double seconds, start = currentSeconds( );
+
+    memset( &dataset, 0, sizeof( DatasetContext ) );
+    initKeyIndex( &seen );
+    dataset.options = options;
+    dataset.records = malloc( ( DATASET_BATCH_RECORDS + MAX_GAME_MOVES ) * sizeof( DatasetRecord ) );
+    assert( NULL != game && NULL != dataset.records );
+    output = fopen( options->datasetFile, "w+b" );
+    if( NULL == output || !writeNpyHeader( output, 0 ) )
+    {
+        fprintf( stderr, "reversi: cannot create '%s': %s\n", options->datasetFile, strerror( errno ) );
+        success = false;
+    }
+    for( i = 0; success && i < options->inputs.nPaths; i++ )
+    {
+        input = 0 == strcmp( options->inputs.paths[i], "-" ) ? stdin : fopen( options->inputs.paths[i], "rb" );
+        if( NULL == input || !readGameFileHeader( input ) )
+        {
+            fprintf( stderr, "reversi: '%s' is not a readable game file\n", options->inputs.paths[i] );
+            success = false;
+        }
+        do
+        {
+            // collect the unique positions of whole games up to a batch
+            dataset.nRecords = 0;
+            more = success;
+            while( more && dataset.nRecords < DATASET_BATCH_RECORDS && ( more = readGameRecord( input, game ) ) )
+            {
+                nGames++;
+                if( 8 != game->start.nRows || 8 != game->start.nColumns )
+                {
+                    nSkipped++;
+                    continue;
+                }
+                board = game->start;
+                for( ply = 0; ply < game->nMoves; ply++ )
+                {
+                    if( game->moves[ply] >= 0 && insertKeyIndex( &seen, hashGameBoard( &board ), 0 ) )
+                    {
+                        record = &dataset.records[dataset.nRecords++];
+                        memset( record, 0, sizeof( DatasetRecord ) );
+                        for( row = 0; row < 8; row++ )
+                        {
+                            for( col = 0; col < 8; col++ )
+                            {
+                                record->planes[0][row][col] = BLACK == board.state[row][col];
+                                record->planes[1][row][col] = WHITE == board.state[row][col];
+                                record->empties += NONE == board.state[row][col];
+                            }
+                        }
+                        record->side = WHITE == board.player;
+                        record->result = (int8_t)( BLACK == board.player ? game->result : -game->result );
+                        record->best = -1;
+                        record->played = (int8_t)( game->moves[ply] / MAX_BOARD_COLUMNS * 8 + game->moves[ply] % MAX_BOARD_COLUMNS );
+                        record->ply = (uint8_t)ply;
+                    }
+                    if( game->moves[ply] < 0 )
+                    {
+                        passMove( &board, NULL );
+                    }
+                    else if( 0 == playMove( &board, game->moves[ply] / MAX_BOARD_COLUMNS, game->moves[ply] % MAX_BOARD_COLUMNS, NULL ) )
+                    {
+                        fprintf( stderr, "reversi: %s: game %ld does not replay\n", options->inputs.paths[i], nGames - 1 );
+                        break;
+                    }
+                }
+            }
+            if( 0 < options->searchDepth )
+            {
+                runWorkerPool( options->nThreads, ( dataset.nRecords + options->chunkSize - 1 ) / options->chunkSize,
+                    labelDatasetJob, &dataset );
+            }
+            if( dataset.nRecords != (int)fwrite( dataset.records, sizeof( DatasetRecord ), dataset.nRecords, output ) )
+            {
+                fprintf( stderr, "reversi: cannot write '%s': %s\n", options->datasetFile, strerror( errno ) );
+                success = false;
+            }
+            nWritten += dataset.nRecords;
+        }
+        while( success && more );
+        if( NULL != input && stdin != input )
+        {
+            fclose( input );
+        }
+    }
+    if( NULL != output )
+    {   // now that the count is known
+        success = success && 0 == fseek( output, 0, SEEK_SET ) && writeNpyHeader( output, nWritten );
+        success = 0 == fclose( output ) && success;
+    }
+    if( success )
+    {
+        seconds = currentSeconds( ) - start;
+        fprintf( stderr, "dataset: %llu position(s) of %ld game(s) (%ld not 8x8), %lu node(s) searched in %.3f s\n",
+            (unsigned long long)nWritten, nGames, nSkipped, dataset.nNodes, seconds );
+    }
+    freeKeyIndex( &seen );
+    free( dataset.records );
+    free( game );
+    return success;
+}
+
+
+void buildPatternSet( PatternSet * patterns )
+{
+    static const int definitions[N_PATTERNS][MAX_PATTERN_CELLS + 1] =
+    {   // number of cells, then the cells as row * 8 + col
+        { 8, 0, 1, 2, 3, 4, 5, 6, 7 },              // edge
+        { 8, 8, 9, 10, 11, 12, 13, 14, 15 },        // second row
+        { 8, 16, 17, 18, 19, 20, 21, 22, 23 },      // third row
+        { 8, 24, 25, 26, 27, 28, 29, 30, 31 },      // fourth row
+        { 8, 0, 9, 18, 27, 36, 45, 54, 63 },        // main diagonal
+        { 7, 1, 10, 19, 28, 37, 46, 55 },           // diagonals of 7 to 4 cells
+        { 6, 2, 11, 20, 29, 38, 47 },
+        { 5, 3, 12, 21, 30, 39 },
+        { 4, 4, 13, 22, 31 },
+        { 9, 0, 1, 2, 8, 9, 10, 16, 17, 18 },       // 3x3 corner
+        { 10, 0, 1, 2, 3, 4, 8, 9, 10, 11, 12 }     // 2x5 corner
+    };
+    uint64_t seen[8];
+    uint64_t mask;
+    int pattern, transform, cell, row, col, i, nSeen, size;
+    int offset = 0;
+
+    memset( patterns, 0, sizeof( PatternSet ) );
+    for( pattern = 0; pattern < N_PATTERNS; pattern++ )
+    {
+        nSeen = 0;
+        for( transform = 0; transform < N_SQUARE_TRANSFORMS; transform++ )
+        {
+            mask = 0;
+            for( cell = 0; cell < definitions[pattern][0]; cell++ )
+            {
+                row = definitions[pattern][cell + 1] / 8;
+                col = definitions[pattern][cell + 1] % 8;
+                transformCell( transform, 8, 8, &row, &col );
+                patterns->cells[patterns->nInstances][cell] = (uint8_t)( row * 8 + col );
+                mask |= 1ULL << ( row * 8 + col );
+            }
+            for( i = 0; i < nSeen && seen[i] != mask; i++ )
+            {
+            }
+            if( i == nSeen )
+            {   // a new image rather than the same cells in another order
+                seen[nSeen++] = mask;
+                patterns->nCells[patterns->nInstances] = definitions[pattern][0];
+                patterns->offset[patterns->nInstances] = offset;
+                patterns->nInstances++;
+            }
+        }
+        for( size = 1, i = 0; i < definitions[pattern][0]; i++ )
+        {
+            size *= 3;
+        }
+        offset += size;
+    }
+    patterns->nPhaseWeights = offset + 1; // and the bias
+}
+
+
+int patternPhase( int empties )
+{
+    int phase = ( 60 - empties ) * WEIGHT_PHASES / 61;
+
+    return phase < 0 ? 0 : phase >= WEIGHT_PHASES ? WEIGHT_PHASES - 1 : phase;
+}
+
+
+void computePatternIndices( const PatternSet * patterns, const uint8_t * squares, int * indices )
+{
+    int instance, cell, index;
+
+    for( instance = 0; instance < patterns->nInstances; instance++ )
+    {
+        index = 0;
+        for( cell = 0; cell < patterns->nCells[instance]; cell++ )
+        {
+            index = 3 * index + squares[patterns->cells[instance][cell]];
+        }
+        indices[instance] = patterns->offset[instance] + index;
+    }
+}
+
+
+PatternWeights * loadPatternWeights( const char * path )
+{
+    PatternWeights * weights = calloc( 1, sizeof( PatternWeights ) );
+    WeightsHeader header;
+    FILE * input = fopen( path, "rb" );
+    size_t nWeights;
+    boolean success;
+
+    assert( NULL != weights );
+    buildPatternSet( &weights->patterns );
+    nWeights = (size_t)WEIGHT_PHASES * weights->patterns.nPhaseWeights;
+    success = NULL != input
+        && 1 == fread( &header, sizeof( header ), 1, input )
+        && 0 == memcmp( header.magic, WEIGHTS_MAGIC, sizeof( WEIGHTS_MAGIC ) )
+        && WEIGHTS_VERSION == header.version
+        && WEIGHT_PHASES == header.nPhases
+        && (uint32_t)weights->patterns.nPhaseWeights == header.nPhaseWeights;
+    if( success )
+    {
+        weights->scale = header.scale;
+        weights->weights = malloc( nWeights * sizeof( float ) );
+        assert( NULL != weights->weights );
+        success = nWeights == fread( weights->weights, sizeof( float ), nWeights, input );
+    }
+    if( NULL != input )
+    {
+        fclose( input );
+    }
+    if( !success )
+    {
+        fprintf( stderr, "reversi: '%s' is not a readable weight file\n", path );
+        freePatternWeights( weights );
+        weights = NULL;
+    }
+    return weights;
+}
+
+
+void freePatternWeights( PatternWeights * weights )
+{
+    if( NULL != weights )
+    {
+        free( weights->weights );
+        free( weights );
+    }
+}
+
+
+int evaluatePatterns( const PatternWeights * weights, const GameBoard * board )
+{
+    uint8_t squares[64];
+    int indices[MAX_PATTERN_INSTANCES];
+    const float * phaseWeights;
+    float sum;
+    int cell, instance;
+    int empties = 0;
+    int score;
+
+    for( cell = 0; cell < 64; cell++ )
+    {
+        squares[cell] = NONE == board->state[cell / 8][cell % 8] ? 0 : board->state[cell / 8][cell % 8] == board->player ? 1 : 2;
+        empties += 0 == squares[cell];
+    }
+    computePatternIndices( &weights->patterns, squares, indices );
+    phaseWeights = weights->weights + (size_t)patternPhase( empties ) * weights->patterns.nPhaseWeights;
+    sum = phaseWeights[weights->patterns.nPhaseWeights - 1];
+    for( instance = 0; instance < weights->patterns.nInstances; instance++ )
+    {
+        sum += phaseWeights[indices[instance]];
+    }
+    score = (int)lrintf( sum * weights->scale );
+    return score >= SEARCH_WIN ? SEARCH_WIN - 1 : score <= -SEARCH_WIN ? -SEARCH_WIN + 1 : score;
+}
+
+
+boolean mapDataset( const char * path, DatasetMap * dataset )
+{
+    static const char descr[] = "{'descr': [('planes', '|u1', (2, 8, 8)), ('score', '<i2'), ('side', '|u1'), "
+        "('result', '|i1'), ('best', '|i1'), ('played', '|i1'), ('ply', '|u1'), ('empties', '|u1')], "
+        "'fortran_order': False, 'shape': (";
+    struct stat info;
+    const char * header;
+    void * mapped = MAP_FAILED;
+    int fd = open( path, O_RDONLY );
+    boolean success = false;
+
+    memset( dataset, 0, sizeof( DatasetMap ) );
+    if( fd >= 0 && 0 == fstat( fd, &info ) && info.st_size >= NPY_HEADER_SIZE )
+    {
+        mapped = mmap( NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    }
+    if( MAP_FAILED != mapped )
+    {
+        header = mapped;
+        success = 0 == memcmp( header + 10, descr, sizeof( descr ) - 1 );
+        if( success )
+        {
+            dataset->records = (const DatasetRecord *)( header + NPY_HEADER_SIZE );
+            dataset->nRecords = strtoull( header + 10 + sizeof( descr ) - 1, NULL, 10 );
+            dataset->mappedSize = info.st_size;
+            success = NPY_HEADER_SIZE + dataset->nRecords * sizeof( DatasetRecord ) <= (uint64_t)info.st_size;
+        }
+        if( success )
+        {   // every epoch reads the records front to back
+            madvise( mapped, info.st_size, MADV_SEQUENTIAL );
+        }
+        else
+        {
+            munmap( mapped, info.st_size );
+        }
+    }
+    if( fd >= 0 )
+    {
+        close( fd );
+    }
+    if( !success )
+    {
+        fprintf( stderr, "reversi: '%s' is not a readable dataset\n", path );
+        memset( dataset, 0, sizeof( DatasetMap ) );
+    }
+    return success;
+}
+
+
+void trainGradientJob( void * context, int index, int thread )
+{
+    TrainContext * train = context;
+    const Options * options = train->options;
+    const DatasetMap * dataset = train->datasets;
+    const DatasetRecord * record;
+    uint8_t squares[64];
+    int indices[MAX_PATTERN_INSTANCES];
+    float * gradients;
+    float * counts;
+    const float * phaseWeights;
+    uint64_t first, end, r;
+    int cell, instance, own, score;
+    size_t base;
+    double sum, target, error, loss = 0;
+
+    while( dataset + 1 < train->datasets + train->nDatasets && dataset[1].firstJob <= index )
+    {
+        dataset++;
+    }
+    if( NULL == train->gradients[thread] )
+    {
+        train->gradients[thread] = calloc( train->nWeights, sizeof( float ) );
+        train->threadCounts[thread] = calloc( train->nWeights, sizeof( float ) );
+        assert( NULL != train->gradients[thread] && NULL != train->threadCounts[thread] );
+    }
+    gradients = train->gradients[thread];
+    counts = train->threadCounts[thread];
+    first = (uint64_t)( index - dataset->firstJob ) * TRAIN_CHUNK_RECORDS;
+    end = first + TRAIN_CHUNK_RECORDS < dataset->nRecords ? first + TRAIN_CHUNK_RECORDS : dataset->nRecords;
+    for( r = first; r < end; r++ )
+    {
+        record = &dataset->records[r];
+        own = record->side;
+        for( cell = 0; cell < 64; cell++ )
+        {
+            squares[cell] = record->planes[own][cell / 8][cell % 8] ? 1 : record->planes[1 - own][cell / 8][cell % 8] ? 2 : 0;
+        }
+        computePatternIndices( &train->patterns, squares, indices );
+        base = (size_t)patternPhase( record->empties ) * train->patterns.nPhaseWeights;
+        if( train->counting )
+        {
+            counts[base + train->patterns.nPhaseWeights - 1] += 1;
+            for( instance = 0; instance < train->patterns.nInstances; instance++ )
+            {
+                counts[base + indices[instance]] += 1;
+            }
+            continue;
+        }
+
+        phaseWeights = train->weights + base;
+        sum = phaseWeights[train->patterns.nPhaseWeights - 1];
+        for( instance = 0; instance < train->patterns.nInstances; instance++ )
+        {
+            sum += phaseWeights[indices[instance]];
+        }
+        score = options->trainOnScore ? record->score : record->result;
+        if( score >= SEARCH_WIN / 2 )
+        {   // a solved score: keep the disc difference
+            score -= SEARCH_WIN;
+        }
+        else if( score <= -SEARCH_WIN / 2 )
+        {
+            score += SEARCH_WIN;
+        }
+        if( options->logistic )
+        {
+            target = score > 0 ? 1.0 : score < 0 ? 0.0 : 0.5;
+            sum = 1.0 / ( 1.0 + exp( -sum ) );
+            error = sum - target;
+            loss -= target * log( sum + 1e-12 ) + ( 1 - target ) * log( 1 - sum + 1e-12 );
+        }
+        else
+        {
+            error = sum - score;
+            loss += error * error;
+        }
+        gradients[base + train->patterns.nPhaseWeights - 1] += (float)error;
+        for( instance = 0; instance < train->patterns.nInstances; instance++ )
+        {
+            gradients[base + indices[instance]] += (float)error;
+        }
+    }
+    train->loss[thread] += loss;
+}
+
+
+void trainUpdateJob( void * context, int index, int thread )
+{
+    TrainContext * train = context;
+    int first = (int)( (int64_t)train->nWeights * index / TRAIN_WEIGHT_SLICES );
+    int end = (int)( (int64_t)train->nWeights * ( index + 1 ) / TRAIN_WEIGHT_SLICES );
+    int t, w;
+    double sum;
+
+    (void)thread;
+    for( w = first; w < end; w++ )
+    {
+        sum = 0;
+        for( t = 0; t < MAX_WORKER_THREADS; t++ )
+        {
+            if( NULL != train->gradients[t] )
+            {
+                sum += train->counting ? train->threadCounts[t][w] : train->gradients[t][w];
+                train->gradients[t][w] = 0;
+            }
+        }
+        if( train->counting )
+        {
+            train->counts[w] = (float)sum;
+        }
+        else if( 0 < train->counts[w] )
+        {   // the mean error of the positions using this weight, shared by all weights of a position
+            train->weights[w] -= (float)( train->options->learningRate * sum / train->counts[w]
+                / ( train->patterns.nInstances + 1 ) );
+        }
+    }
+}
+
+
+boolean runTrainer( const Options * options )
+{
+    char temporary[MAX_INPUT_PATH + 8];
+    TrainContext * train = calloc( 1, sizeof( TrainContext ) );
+    WeightsHeader header;
+    FILE * output;
+    uint64_t nRecords = 0;
+    double loss;
+    int epoch, i, t;
+    boolean success = true;
+    double start = currentSeconds( );
+
+    assert( NULL != train );
+    train->options = options;
+    buildPatternSet( &train->patterns );
+    train->nWeights = WEIGHT_PHASES * train->patterns.nPhaseWeights;
+    train->weights = calloc( train->nWeights, sizeof( float ) );
+    train->counts = calloc( train->nWeights, sizeof( float ) );
+    train->datasets = calloc( options->inputs.nPaths, sizeof( DatasetMap ) );
+    assert( NULL != train->weights && NULL != train->counts && NULL != train->datasets );
+    for( i = 0; success && i < options->inputs.nPaths; i++ )
+    {
+        success = mapDataset( options->inputs.paths[i], &train->datasets[i] );
+        train->datasets[i].firstJob = train->nJobs;
+        train->nJobs += ( train->datasets[i].nRecords + TRAIN_CHUNK_RECORDS - 1 ) / TRAIN_CHUNK_RECORDS;
+        nRecords += train->datasets[i].nRecords;
+        train->nDatasets++;
+    }
+    if( success && 0 == nRecords )
+    {
+        fprintf( stderr, "reversi: no positions to train on\n" );
+        success = false;
+    }
+    if( success )
+    {
+        fprintf( stderr, "train: %llu position(s), %d pattern instance(s), %d weight(s)\n",
+            (unsigned long long)nRecords, train->patterns.nInstances, train->nWeights );
+        train->counting = true;
+        runWorkerPool( options->nThreads, train->nJobs, trainGradientJob, train );
+        runWorkerPool( options->nThreads, TRAIN_WEIGHT_SLICES, trainUpdateJob, train );
+        train->counting = false;
+    }
+    for( epoch = 0; success && epoch < options->epochs; epoch++ )
+    {
+        runWorkerPool( options->nThreads, train->nJobs, trainGradientJob, train );
+        runWorkerPool( options->nThreads, TRAIN_WEIGHT_SLICES, trainUpdateJob, train );
+        for( loss = 0, t = 0; t < MAX_WORKER_THREADS; t++ )
+        {
+            loss += train->loss[t];
+            train->loss[t] = 0;
+        }
+        fprintf( stderr, "train: epoch %d, %s %.4f, %.3f s\n", epoch + 1, options->logistic ? "log loss" : "rms error",
+            options->logistic ? loss / nRecords : sqrt( loss / nRecords ), currentSeconds( ) - start );
+    }
+    if( success )
+    {
+        memset( &header, 0, sizeof( header ) );
+        memcpy( header.magic, WEIGHTS_MAGIC, sizeof( WEIGHTS_MAGIC ) );
+        header.version = WEIGHTS_VERSION;
+        header.nPhases = WEIGHT_PHASES;
+        header.nPhaseWeights = train->patterns.nPhaseWeights;
+        header.scale = options->logistic ? LOGISTIC_SCALE : 1.0f;
+        snprintf( temporary, sizeof( temporary ), "%s.tmp", options->trainFile );
+        output = fopen( temporary, "wb" );
+        success = NULL != output
+            && 1 == fwrite( &header, sizeof( header ), 1, output )
+            && (size_t)train->nWeights == fwrite( train->weights, sizeof( float ), train->nWeights, output );
+        success = NULL != output && 0 == fclose( output ) && success;
+        success = success && 0 == rename( temporary, options->trainFile );
+        if( !success )
+        {
+            fprintf( stderr, "reversi: cannot write weight file '%s': %s\n", options->trainFile, strerror( errno ) );
+        }
+    }
+    for( i = 0; i < train->nDatasets; i++ )
+    {
+        if( NULL != train->datasets[i].records )
+        {
+            munmap( (char *)train->datasets[i].records - NPY_HEADER_SIZE, train->datasets[i].mappedSize );
+        }
+    }
+    for( t = 0; t < MAX_WORKER_THREADS; t++ )
+    {
+        free( train->gradients[t] );
+        free( train->threadCounts[t] );
+    }
+    free( train->datasets );
+    free( train->weights );
+    free( train->counts );
+    free( train );
+    return success;
+}
+
+
+boolean parseEngineSpec( const char * text, EngineSpec * spec )
+{
+    char copy[LINE_MAX];
+    char * word;
+    char * save;
+    boolean success = true;
+
+    memset( spec, 0, sizeof( EngineSpec ) );
+    snprintf( spec->name, sizeof( spec->name ), "%s", text );
+    snprintf( copy, sizeof( copy ), "%s", text );
+    spec->endgameEmpties = DEFAULT_ENDGAME_EMPTIES;
+    word = strtok_r( copy, ",", &save );
+    for( spec->kind = ENGINE_GREEDY; spec->kind <= ENGINE_ENDGAME; spec->kind++ )
+    {
+        if( NULL != word && 0 == strcmp( word, engineType( spec->kind )->name ) )
+        {
+            break;
+        }
+    }
+    success = spec->kind <= ENGINE_ENDGAME && strlen( text ) < sizeof( spec->name );
+    for( word = strtok_r( NULL, ",", &save ); success && NULL != word; word = strtok_r( NULL, ",", &save ) )
+    {
+        if( 0 == strncmp( word, "depth=", 6 ) )
+        {
+            spec->depth = atoi( word + 6 );
+            success = 0 < spec->depth && spec->depth <= MAX_BOOK_DEPTH;
+        }
+        else if( 0 == strncmp( word, "time=", 5 ) )
+        {
+            spec->moveTime = atof( word + 5 );
+            success = 0 <= spec->moveTime;
+        }
+        else if( 0 == strncmp( word, "playouts=", 9 ) )
+        {
+            spec->playouts = atoi( word + 9 );
+            success = 0 < spec->playouts;
+        }
+        else if( 0 == strncmp( word, "empties=", 8 ) )
+        {
+            spec->endgameEmpties = atoi( word + 8 );
+            success = 0 <= spec->endgameEmpties && spec->endgameEmpties <= MAX_MOVES;
+        }
+        else if( 0 == strcmp( word, "pvs=0" ) || 0 == strcmp( word, "pvs=1" ) )
+        {
+            spec->plainSearch = '0' == word[4];
+        }
+        else if( 0 == strncmp( word, "weights=", 8 ) && NULL == spec->weights )
+        {
+            spec->weights = loadPatternWeights( word + 8 );
+            success = NULL != spec->weights;
+        }
+        else
+        {
+            success = false;
+        }
+    }
+    if( !success )
+    {
+        fprintf( stderr, "reversi: bad engine '%s'\n", text );
+        freePatternWeights( spec->weights );
+        spec->weights = NULL;
+    }
+    return success;
+}
+
+
+void updateSprt( MatchContext * match )
+{
+    const Options * options = match->options;
+    double n = match->wins + match->draws + match->losses;
+    double score, variance, score0, score1;
+
+    if( 0 == n || 0 != match->decision )
+    {
+        return;
+    }
+    score = ( match->wins + 0.5 * match->draws ) / n;
+    variance = ( match->wins * ( 1 - score ) * ( 1 - score ) + match->draws * ( 0.5 - score ) * ( 0.5 - score )
+        + match->losses * score * score ) / n;
+    if( 0 >= variance )
+    {   // all results alike so far: no spread to weigh the evidence with
+        return;
+    }
+    score0 = 1 / ( 1 + pow( 10, -options->sprtElo0 / 400 ) );
+    score1 = 1 / ( 1 + pow( 10, -options->sprtElo1 / 400 ) );
+    // normal approximation of the trinomial log-likelihood ratio
+    match->llr = n * ( score1 - score0 ) * ( 2 * score - score0 - score1 ) / ( 2 * variance );
+    if( match->llr >= log( ( 1 - SPRT_BETA ) / SPRT_ALPHA ) )
+    {
+        match->decision = 1;
+    }
+    else if( match->llr <= log( SPRT_BETA / ( 1 - SPRT_ALPHA ) ) )
+    {
+        match->decision = -1;
+    }
+}
+
+
+void matchPairJob( void * context, int index, int thread )
+{
+    MatchContext * match = context;
+    const Options * options = match->options;
+    Engine * engines[2];
+    BoardMove best;
+    GameBoard start, board;
+    uint64_t random;
+    int cells[MAX_MOVES];
+    int game, black, player, nLegal, ply, cell, nPasses, decision;
+    int results[2];
+    int timeLoser[2];       // player who lost each game on time, -1 for none
+    int illegalLoser[2];    // player who lost each game by an illegal move, -1 for none
+    GameClock clocks[2];
+
+    pthread_mutex_lock( &match->lock );
+    decision = match->decision;
+    pthread_mutex_unlock( &match->lock );
+    if( 0 != decision )
+    {   // decided while this pair waited
+        return;
+    }
+
+    if( NULL != match->openings )
+    {
+        replayGame( &match->openings[index % match->nOpenings], &start, NULL, NULL );
+    }
+    else
+    {
+        initStartBoard( &start, 8, 8 );
+        random = mixHash( options->seed ) ^ mixHash( (uint64_t)index );
+        for( ply = 0; ply < options->randomPlies && 0 < ( nLegal = generateMoves( &start, cells ) ); ply++ )
+        {
+            cell = cells[nextRandom( &random ) % nLegal];
+            playMove( &start, cell / MAX_BOARD_COLUMNS, cell % MAX_BOARD_COLUMNS, NULL );
+        }
+    }
+
+    for( game = 0; game < 2; game++ )
+    {
+        black = game; // players[black] has BLACK
+        for( player = 0; player < 2; player++ )
+        {
+            engines[player] = &match->engines[player][thread];
+            if( !engines[player]->initialized )
+            {
+                initEngine( engines[player], &options->players[player], options );
+            }
+            resetEngine( engines[player] );
+        }
+        board = start;
+        timeLoser[game] = -1;
+        illegalLoser[game] = -1;
+        for( player = 0; player < 2; player++ )
+        {
+            clocks[player] = options->clock;
+            engines[player]->clock = 0 < options->clock.remaining ? &clocks[player] : NULL;
+        }
+        for( nPasses = 0, ply = 0; nPasses < 2 && ply < MAX_GAME_MOVES; ply++ )
+        {   // every legal move fills a cell, so the ply limit only guards against a broken engine
+            if( 0 == generateMoves( &board, NULL ) )
+            {
+                passMove( &board, NULL );
+                nPasses++;
+                continue;
+            }
+            nPasses = 0;
+            player = BLACK == board.player ? black : 1 - black;
+            chooseEngineMove( engines[player], &board, &best );
+            if( NULL != engines[player]->clock && 0 > clocks[player].remaining )
+            {   // the flag fell
+                timeLoser[game] = player;
+                break;
+            }
+            if( !isLegalMove( &board, best.row, best.col ) )
+            {
+                illegalLoser[game] = player;
+                break;
+            }
+            playMove( &board, best.row, best.col, NULL );
+        }
+        engines[0]->clock = NULL;
+        engines[1]->clock = NULL;
+        board.player = BLACK;
+        results[game] = 0 == black ? discDifference( &board ) : -discDifference( &board ); // for players[0]
+        if( 0 <= timeLoser[game] )
+        {
+            results[game] = 0 == timeLoser[game] ? -1 : 1;
+        }
+        if( 0 <= illegalLoser[game] )
+        {
+            results[game] = 0 == illegalLoser[game] ? -1 : 1;
+        }
+    }
+
+    pthread_mutex_lock( &match->lock );
+    for( game = 0; game < 2; game++ )
+    {
+        match->wins += results[game] > 0;
+        match->draws += 0 == results[game];
+        match->losses += results[game] < 0;
+        if( 0 <= timeLoser[game] )
+        {
+            match->timeLosses[timeLoser[game]]++;
+        }
+        if( 0 <= illegalLoser[game] )
+        {
+            match->illegalLosses[illegalLoser[game]]++;
+        }
+    }
+    updateSprt( match );
+    pthread_mutex_unlock( &match->lock );
+}
+
+
+boolean runMatch( const Options * options )
+{
+    MatchContext * match = calloc( 1, sizeof( MatchContext ) );
+    GameRecord * grown;
+    FILE * input;
+    int capacity = 0;
+    int i, t;
+    long nGames;
+    double score, margin, spread, seconds;
+    double elo[3];
+    boolean binary;
+    boolean success = true;
+    double start = currentSeconds( );
+
+    assert( NULL != match );
+    match->options = options;
+    pthread_mutex_init( &match->lock, NULL );
+    for( i = 0; success && i < options->inputs.nPaths; i++ )
+    {
+        input = 0 == strcmp( options->inputs.paths[i], "-" ) ? stdin : fopen( options->inputs.paths[i], "rb" );
+        if( NULL == input )
+        {
+            fprintf( stderr, "reversi: cannot open '%s': %s\n", options->inputs.paths[i], strerror( errno ) );
+            success = false;
+            break;
+        }
+        // a game file, or else text: standard input can only be text as it cannot be rewound
+        binary = stdin != input && readGameFileHeader( input );
+        if( !binary && stdin != input )
+        {
+            rewind( input );
+        }
+        for( ;; )
+        {
+            if( match->nOpenings == capacity )
+            {
+                capacity = 0 == capacity ? 64 : 2 * capacity;
+                grown = realloc( match->openings, capacity * sizeof( GameRecord ) );
+                assert( NULL != grown );
+                match->openings = grown;
+            }
+            if( !( binary ? readGameRecord( input, &match->openings[match->nOpenings] )
+                : readMoveList( input, &match->openings[match->nOpenings] ) ) )
+            {
+                break;
+            }
+            if( binary && match->openings[match->nOpenings].nMoves > options->randomPlies )
+            {   // recorded games serve as openings through their first --random-plies moves
+                match->openings[match->nOpenings].nMoves = options->randomPlies;
+            }
+            match->nOpenings++;
+        }
+        if( stdin != input )
+        {
+            fclose( input );
+        }
+    }
+    if( success && 0 < options->inputs.nPaths && 0 == match->nOpenings )
+    {
+        fprintf( stderr, "reversi: no openings in the inputs\n" );
+        success = false;
+    }
+    if( success )
+    {
+        runWorkerPool( options->nThreads, (int)( ( options->matchGames + 1 ) / 2 ), matchPairJob, match );
+        seconds = currentSeconds( ) - start;
+        nGames = match->wins + match->draws + match->losses;
+        score = 0 < nGames ? ( match->wins + 0.5 * match->draws ) / nGames : 0.5;
+        spread = 0 < nGames ? sqrt( ( match->wins * ( 1 - score ) * ( 1 - score )
+            + match->draws * ( 0.5 - score ) * ( 0.5 - score ) + match->losses * score * score ) / nGames ) : 0;
+        margin = 0 < nGames ? 1.96 * spread / sqrt( nGames ) : 0;
+        for( t = 0; t < 3; t++ )
+        {   // the score and the ends of its 95% interval, as Elo differences
+            elo[t] = fmin( fmax( score + ( t - 1 ) * margin, 1e-6 ), 1 - 1e-6 );
+            elo[t] = -400 * log10( 1 / elo[t] - 1 );
+        }
+        printf( "%s vs %s\n", options->players[0].name, options->players[1].name );
+        printf( "games %ld: +%ld =%ld -%ld, score %.1f%%, Elo %+.1f (95%%: %+.1f to %+.1f)\n",
+            nGames, match->wins, match->draws, match->losses, 100 * score, elo[1], elo[0], elo[2] );
+        printf( "sprt [%g, %g]: llr %.2f (%.2f, %.2f), %s\n", options->sprtElo0, options->sprtElo1, match->llr,
+            log( SPRT_BETA / ( 1 - SPRT_ALPHA ) ), log( ( 1 - SPRT_BETA ) / SPRT_ALPHA ),
+            1 == match->decision ? "H1 accepted" : -1 == match->decision ? "H0 accepted" : "inconclusive" );
+        if( 0 < options->clock.remaining )
+        {
+            printf( "clock %g+%g: lost on time %ld and %ld\n", options->clock.remaining, options->clock.increment,
+                match->timeLosses[0], match->timeLosses[1] );
+        }
+        if( 0 < match->illegalLosses[0] + match->illegalLosses[1] )
+        {
+            printf( "illegal moves: lost %ld and %ld\n", match->illegalLosses[0], match->illegalLosses[1] );
+        }
+        fprintf( stderr, "match: %ld game(s) in %.3f s (%.1f games/s)\n",
+            nGames, seconds, seconds > 0 ? nGames / seconds : 0.0 );
+    }
+    for( i = 0; i < 2; i++ )
+    {
+        for( t = 1; t < MAX_WORKER_THREADS; t++ )
+        {
+            mergeEngineStats( &match->engines[i][0], &match->engines[i][t] );
+            freeEngine( &match->engines[i][t] );
+        }
+        if( success )
+        {
+            printEngineStats( &match->engines[i][0], stderr );
+        }
+        freeEngine( &match->engines[i][0] );
+    }
+    pthread_mutex_destroy( &match->lock );
+    free( match->openings );
+    free( match );
+    return success;
+}
+
+
+const EngineType * engineType( EngineKind kind )
+{
+    static const EngineType types[] =
+    {
+        { "greedy", NULL, chooseGreedyMove, NULL, NULL, printGreedyStats, NULL, NULL },
+        { "search", initSearchEngine, chooseSearchMove, rankSearchMoves, ponderSearch, printSearchStats,
+            resetSearchEngine, releaseSearchEngine },
+        { "mcts", NULL, chooseMctsMove, rankMctsMoves, ponderMcts, printMctsStats, resetMctsEngine,
+            releaseMctsEngine },
+        { "endgame", initSearchEngine, chooseEndgameMove, rankSearchMoves, ponderSearch, printSearchStats,
+            resetSearchEngine, releaseSearchEngine }
+    };
+
+    return &types[kind];
+}
+
+
+void initEngine( Engine * engine, const EngineSpec * spec, const Options * options )
+{
+    const EngineType * type = engineType( spec->kind );
+
+    memset( engine, 0, sizeof( Engine ) );
+    engine->spec = *spec;
+    engine->depth = 0 < spec->depth ? spec->depth : options->searchDepth;
+    engine->weights = NULL != spec->weights ? spec->weights : options->weights;
+    engine->tableEntries = options->tableEntries;
+    engine->seed = options->seed;
+    engine->configId = engineConfigId( engine, &options->clock );
+    engine->initialized = true;
+    if( NULL != type->init )
+    {
+        type->init( engine );
+    }
+}
+
+
+void chooseEngineMove( Engine * engine, GameBoard * board, BoardMove * best )
+{
+    double start = currentSeconds( );
+    double moveTime = engine->spec.moveTime;
+    double elapsed;
+
+    if( NULL != engine->clock )
+    {   // the clock overrides the time per move
+        allocateMoveTime( engine->clock, board, &engine->search.softTime, &engine->spec.moveTime );
+    }
+    engineType( engine->spec.kind )->choose( engine, board, best );
+    engine->spec.moveTime = moveTime;
+    engine->search.softTime = 0;
+    elapsed = currentSeconds( ) - start;
+    if( NULL != engine->clock )
+    {
+        engine->clock->remaining += engine->clock->increment - elapsed;
+    }
+    engine->seconds += elapsed;
+    engine->nMoves++;
+}
+
+
+void resetEngine( Engine * engine )
+{
+    const EngineType * type = engineType( engine->spec.kind );
+
+    if( NULL != type->reset )
+    {
+        type->reset( engine );
+    }
+}
+
+
+void mergeEngineStats( Engine * total, const Engine * engine )
+{
+    total->nMoves += engine->nMoves;
+    total->nPlayouts += engine->nPlayouts;
+    total->seconds += engine->seconds;
+    total->search.nodes += engine->search.nodes;
+    total->search.tableHits += engine->search.tableHits;
+    total->search.researches += engine->search.researches;
+    total->search.aspirationFails += engine->search.aspirationFails;
+    total->search.cutoffs += engine->search.cutoffs;
+    total->search.firstCutoffs += engine->search.firstCutoffs;
+}
+
+
+void printEngineStats( const Engine * engine, FILE * output )
+{
+    engineType( engine->spec.kind )->stats( engine, output );
+}
+
+
+void freeEngine( Engine * engine )
+{
+    const EngineType * type = engineType( engine->spec.kind );
+
+    if( engine->initialized && NULL != type->release )
+    {
+        type->release( engine );
+    }
+    if( engine->ownsWeights )
+    {
+        freePatternWeights( engine->spec.weights );
+    }
+    memset( engine, 0, sizeof( Engine ) );
+}
+
+
+Engine * acquireEngine( AnalysisContext * analysis, const char * text )
+{
+    const Options * options = analysis->options;
+    const char * name = '\0' == text[0] ? options->engine.name : text;
+    Engine ** grown;
+    Engine * engine = NULL;
+    EngineSpec spec;
+    int i;
+
+    pthread_mutex_lock( &analysis->engineLock );
+    for( i = 0; NULL == engine && i < analysis->nEngines; i++ )
+    {
+        if( !analysis->engines[i]->busy && 0 == strcmp( analysis->engines[i]->spec.name, name ) )
+        {
+            engine = analysis->engines[i];
+        }
+    }
+    pthread_mutex_unlock( &analysis->engineLock );
+    if( NULL == engine )
+    {   // every engine of the configuration is busy: one more, set up outside the lock
+        if( '\0' == text[0] )
+        {
+            spec = options->engine;
+        }
+        else if( !parseEngineSpec( text, &spec ) )
+        {
+            return NULL;
+        }
+        engine = malloc( sizeof( Engine ) );
+        assert( NULL != engine );
+        initEngine( engine, &spec, options );
+        engine->ownsWeights = '\0' != text[0];
+        pthread_mutex_lock( &analysis->engineLock );
+        if( analysis->nEngines == analysis->engineCapacity )
+        {
+            analysis->engineCapacity = 0 == analysis->engineCapacity ? 16 : 2 * analysis->engineCapacity;
+            grown = realloc( analysis->engines, analysis->engineCapacity * sizeof( Engine * ) );
+            assert( NULL != grown );
+            analysis->engines = grown;
+        }
+        analysis->engines[analysis->nEngines++] = engine;
+    }
+    else
+    {
+        pthread_mutex_lock( &analysis->engineLock );
+    }
+    engine->busy = true;
+    pthread_mutex_unlock( &analysis->engineLock );
+    return engine;
+}
+
+
+void releaseEngine( AnalysisContext * analysis, Engine * engine )
+{
+    pthread_mutex_lock( &analysis->engineLock );
+    engine->busy = false;
+    pthread_mutex_unlock( &analysis->engineLock );
+}
+
+
+void chooseGreedyMove( Engine * engine, GameBoard * board, BoardMove * best )
+{
+    int col, row, reverses;
+
+    (void)engine;
+    best->row = -1;
+    best->col = -1;
+    best->score = 0;
+    best->depth = 1;
+    best->source = SOURCE_ENGINE;
+    for( row = 0; row < board->nRows; row++ )
+    {
+        for( col = 0; col < board->nColumns; col++ )
+        {
+            if( canPlayAt( board, row, col ) )
+            {
+                board->state[row][col] = board->player; // play the piece
+                reverses = numAllReverse( board, row, col );
+                board->state[row][col] = NONE; // revert our last change
+                if( reverses > best->score )
+                {
+                    best->row = row;
+                    best->col = col;
+                    best->score = reverses;
+                }
+            }
+        }
+    }
+}
+
+
+void printGreedyStats( const Engine * engine, FILE * output )
+{
+    fprintf( output, "%s: %lu move(s) in %.3f s\n", engine->spec.name, engine->nMoves, engine->seconds );
+}
+
+
+void initSearchEngine( Engine * engine )
+{
+    createTranspositionTable( &engine->search, engine->tableEntries );
+    engine->search.plain = engine->spec.plainSearch;
+}
+
+
+void chooseSearchMove( Engine * engine, GameBoard * board, BoardMove * best )
+{
+    int cells[MAX_MOVES];
+
+    engine->search.weights = engine->weights;
+    engine->search.deadline = 0 < engine->spec.moveTime ? currentSeconds( ) + engine->spec.moveTime : 0;
+    searchIterative( &engine->search, board, engine->depth, best );
+    engine->search.deadline = 0;
+    if( best->row < 0 && 0 < generateMoves( board, cells ) )
+    {   // out of time before the first move was searched
+        best->row = cells[0] / MAX_BOARD_COLUMNS;
+        best->col = cells[0] % MAX_BOARD_COLUMNS;
+    }
+}
+
+
+void chooseEndgameMove( Engine * engine, GameBoard * board, BoardMove * best )
+{
+    BoardMove exact;
+    double moveTime = engine->spec.moveTime;
+    double start = currentSeconds( );
+    int row, col;
+    int nEmpty = 0;
+
+    for( row = 0; row < board->nRows; row++ )
+    {
+        for( col = 0; col < board->nColumns; col++ )
+        {
+            nEmpty += NONE == board->state[row][col];
+        }
+    }
+    if( nEmpty > engine->spec.endgameEmpties )
+    {
+        chooseSearchMove( engine, board, best );
+        return;
+    }
+    if( 0 < moveTime )
+    {   // the solve may not finish in time: search first, with half of it, for a move to fall back on
+        engine->spec.moveTime = moveTime / 2;
+        chooseSearchMove( engine, board, best );
+        engine->spec.moveTime = moveTime;
+    }
+    // every move fills a cell, so the search reaches the end of the game
+    engine->search.stopped = false;
+    engine->search.deadline = 0 < moveTime ? start + moveTime : 0;
+    clearMoveOrdering( &engine->search );
+    searchBestMove( &engine->search, board, nEmpty, &exact );
+    engine->search.deadline = 0;
+    if( 0 < moveTime && engine->search.stopped )
+    {
+        return;
+    }
+    *best = exact;
+    if( best->score > SEARCH_WIN / 2 )
+    {
+        best->score -= SEARCH_WIN;
+    }
+    else if( best->score < -SEARCH_WIN / 2 )
+    {
+        best->score += SEARCH_WIN;
+    }
+    if( !engine->search.stopped && NULL != engine->search.info )
+    {
+        printSearchInfo( &engine->search, board, best );
+    }
+}
+
+
+void printSearchStats( const Engine * engine, FILE * output )
+{
+    fprintf( output, "%s: %lu move(s), %lu node(s), %lu table hit(s), %lu re-search(es), %lu aspiration fail(s),"
+        " %.1f%% of %lu cutoff(s) on the first move in %.3f s (%.0f nodes/s)\n", engine->spec.name, engine->nMoves,
+        engine->search.nodes, engine->search.tableHits, engine->search.researches, engine->search.aspirationFails,
+        0 < engine->search.cutoffs ? 100.0 * engine->search.firstCutoffs / engine->search.cutoffs : 0.0,
+        engine->search.cutoffs, engine->seconds, engine->seconds > 0 ? engine->search.nodes / engine->seconds : 0.0 );
+}
+
+
+void resetSearchEngine( Engine * engine )
+{
+    clearTranspositionTable( &engine->search );
+}
+
+
+void releaseSearchEngine( Engine * engine )
+{
+    freeTranspositionTable( &engine->search );
+}
+
+
+void chooseMctsMove( Engine * engine, GameBoard * board, BoardMove * best )
+{
+    const MctsNode * root;
+    int i, chosen;
+    long limit;
+    double deadline = 0 < engine->spec.moveTime ? currentSeconds( ) + engine->spec.moveTime : 0;
+
+    limit = 0 < engine->spec.playouts ? engine->spec.playouts : 0 < deadline ? -1 : DEFAULT_MCTS_PLAYOUTS;
+    best->row = -1;
+    best->col = -1;
+    best->score = 0;
+    best->depth = 0;
+    best->source = SOURCE_ENGINE;
+    rootMctsTree( engine, board );
+    root = &engine->tree[0];
+    if( root->nChildren <= 0 || -1 == engine->tree[root->firstChild].move )
+    {   // no move to choose
+        return;
+    }
+    if( 0 < limit )
+    {   // playouts of a kept tree, such as those of a ponder, count
+        limit = (long)root->visits >= limit ? 0 : limit - (long)root->visits;
+    }
+    best->depth = runMctsPlayouts( engine, board, limit, deadline );
+    if( NULL != engine->search.info )
+    {
+        printMctsInfo( engine, board, best->depth );
+    }
+    root = &engine->tree[0];
+    chosen = root->firstChild;
+    for( i = 1; i < root->nChildren; i++ )
+    {
+        if( engine->tree[root->firstChild + i].visits > engine->tree[chosen].visits )
+        {
+            chosen = root->firstChild + i;
+        }
+    }
+    best->row = engine->tree[chosen].move / MAX_BOARD_COLUMNS;
+    best->col = engine->tree[chosen].move % MAX_BOARD_COLUMNS;
+    best->score = 0 < engine->tree[chosen].visits
+        ? (int)lrint( 100.0 * engine->tree[chosen].wins / engine->tree[chosen].visits ) : 50;
+    engine->treeChosen = true;
+}
+
+
+void rootMctsTree( Engine * engine, GameBoard * board )
+{
+    uint64_t key = hashGameBoard( board );
+
+    if( NULL == engine->tree )
+    {
+        engine->treeCapacity = 1024;
+        engine->tree = malloc( engine->treeCapacity * sizeof( MctsNode ) );
+        assert( NULL != engine->tree );
+    }
+    if( key != engine->treeKey || 0 == engine->nTreeNodes )
+    {
+        engine->nTreeNodes = 1;
+        memset( engine->tree, 0, sizeof( MctsNode ) );
+        engine->tree[0].move = -1;
+        engine->tree[0].nChildren = -1;
+        engine->tree[0].player = opponentOf( board->player );
+        engine->treeKey = key;
+    }
+    engine->treeChosen = false;
+    if( -1 == engine->tree[0].nChildren )
+    {
+        expandMctsNode( engine, 0, board );
+    }
+}
+
+
+int runMctsPlayouts( Engine * engine, const GameBoard * board, long limit, double deadline )
+{
+    MctsNode * node;
+    GameBoard work;
+    uint64_t random = mixHash( engine->seed ) ^ hashGameBoard( board ) ^ mixHash( engine->tree[0].visits );
+    int path[MAX_GAME_MOVES + 1];
+    int nPath, i, child, chosen, difference;
+    int deepest = 0;
+    long playout;
+    double value, bestValue, logVisits;
+    double start = currentSeconds( );
+
+    for( playout = 0; playout < limit || 0 > limit; playout++ )
+    {
+        if( engine->search.stopRequest
+            || ( 0 < deadline && 0 == ( playout & 63 ) && currentSeconds( ) >= deadline ) )
+        {
+            break;
+        }
+        if( 0 < engine->search.softTime && 0 < playout && 0 == ( playout & 63 )
+            && isMctsSettled( engine, playout, currentSeconds( ) - start ) )
+        {
+            break;
+        }
+        if( NULL != engine->search.info && 0 < engine->search.info->interval && 0 == ( playout & 63 )
+            && currentSeconds( ) >= engine->search.info->next )
+        {
+            printMctsInfo( engine, board, deepest );
+        }
+        // selection: descend by UCB1 to a node not yet expanded
+        work = *board;
+        path[0] = 0;
+        nPath = 1;
+        for( node = &engine->tree[0]; 0 < node->nChildren; node = &engine->tree[chosen] )
+        {
+            chosen = -1;
+            bestValue = -1;
+            logVisits = log( (double)node->visits + 1 );
+            for( i = 0; i < node->nChildren; i++ )
+            {
+                child = node->firstChild + i;
+                if( 0 == engine->tree[child].visits )
+                {   // every move is tried once before any is tried twice
+                    chosen = child;
+                    break;
+                }
+                value = engine->tree[child].wins / engine->tree[child].visits
+                    + MCTS_EXPLORATION * sqrt( logVisits / engine->tree[child].visits );
+                if( value > bestValue )
+                {
+                    bestValue = value;
+                    chosen = child;
+                }
+            }
+            if( 0 > engine->tree[chosen].move )
+            {
+                passMove( &work, NULL );
+            }
+            else
+            {
+                playMove( &work, engine->tree[chosen].move / MAX_BOARD_COLUMNS, engine->tree[chosen].move % MAX_BOARD_COLUMNS, NULL );
+            }
+            path[nPath++] = chosen;
+            if( -1 == engine->tree[chosen].nChildren && 0 < engine->tree[chosen].visits )
+            {   // visited once already: grow the tree below it
+                expandMctsNode( engine, chosen, &work );
+            }
+        }
+        if( nPath - 1 > deepest )
+        {
+            deepest = nPath - 1;
+        }
+        // simulation and back-propagation
+        playRandomGame( &work, &random );
+        work.player = BLACK;
+        difference = discDifference( &work );
+        for( i = 0; i < nPath; i++ )
+        {
+            node = &engine->tree[path[i]];
+            node->visits++;
+            node->wins += 0 == difference ? 0.5f : ( difference > 0 ) == ( BLACK == node->player ) ? 1.0f : 0.0f;
+        }
+    }
+    engine->nPlayouts += playout;
+    return deepest;
+}
+
+
+void advanceMctsTree( Engine * engine, const GameBoard * board, int move )
+{
+    MctsNode * kept;
+    int i, next;
+    int child = -1;
+
+    for( i = 0; 0 != engine->treeKey && i < engine->tree[0].nChildren; i++ )
+    {
+        if( engine->tree[engine->tree[0].firstChild + i].move == move )
+        {
+            child = engine->tree[0].firstChild + i;
+        }
+    }
+    if( 0 > child )
+    {   // nothing known below the move
+        engine->treeKey = 0;
+        return;
+    }
+    // breadth first copy: a node's firstChild still indexes the old tree until it is visited
+    kept = malloc( engine->treeCapacity * sizeof( MctsNode ) );
+    assert( NULL != kept );
+    kept[0] = engine->tree[child];
+    next = 1;
+    for( i = 0; i < next; i++ )
+    {
+        if( 0 < kept[i].nChildren )
+        {
+            memcpy( &kept[next], &engine->tree[kept[i].firstChild], kept[i].nChildren * sizeof( MctsNode ) );
+            kept[i].firstChild = next;
+            next += kept[i].nChildren;
+        }
+    }
+    free( engine->tree );
+    engine->tree = kept;
+    engine->nTreeNodes = next;
+    engine->treeKey = hashGameBoard( board );
+    engine->treeChosen = false;
+}
+
+
+void ponderMcts( Engine * engine, GameBoard * board, BoardMove * best )
+{
+    best->row = -1;
+    best->col = -1;
+    rootMctsTree( engine, board );
+    runMctsPlayouts( engine, board, -1, 0 );
+}
+
+
+void resetMctsEngine( Engine * engine )
+{
+    engine->treeKey = 0;
+    engine->nTreeNodes = 0;
+    engine->treeChosen = false;
+}
+
+
+void expandMctsNode( Engine * engine, int node, GameBoard * board )
+{
+    MctsNode * grown;
+    MoveUndo undo;
+    int cells[MAX_MOVES];
+    int nMoves = generateMoves( board, cells );
+    int i;
+
+    if( 0 == nMoves )
+    {   // a pass when the opponent can move, else the end of the game
+        passMove( board, &undo );
+        if( 0 < generateMoves( board, NULL ) )
+        {
+            cells[0] = -1;
+            nMoves = 1;
+        }
+        undoMove( board, &undo );
+    }
+    if( 0 < node && engine->nTreeNodes + nMoves > MAX_MCTS_NODES )
+    {   // full: the node stays a leaf
+        return;
+    }
+    if( engine->nTreeNodes + nMoves > engine->treeCapacity )
+    {
+        engine->treeCapacity = 2 * engine->treeCapacity + nMoves;
+        grown = realloc( engine->tree, engine->treeCapacity * sizeof( MctsNode ) );
+        assert( NULL != grown );
+        engine->tree = grown;
+    }
+    engine->tree[node].firstChild = engine->nTreeNodes;
+    engine->tree[node].nChildren = (int16_t)nMoves;
+    for( i = 0; i < nMoves; i++ )
+    {
+        memset( &engine->tree[engine->nTreeNodes], 0, sizeof( MctsNode ) );
+        engine->tree[engine->nTreeNodes].move = (int16_t)cells[i];
+        engine->tree[engine->nTreeNodes].nChildren = -1;
+        engine->tree[engine->nTreeNodes].player = (uint8_t)board->player;
+        engine->nTreeNodes++;
+    }
+}
+
+
+void playRandomGame( GameBoard * board, uint64_t * random )
+{
+    int cells[MAX_MOVES];
+    int nMoves, cell;
+    int nPasses = 0;
+
+    while( nPasses < 2 )
+    {
+        nMoves = generateMoves( board, cells );
+        if( 0 == nMoves )
+        {
+            passMove( board, NULL );
+            nPasses++;
+        }
+        else
+        {
+            cell = cells[nextRandom( random ) % nMoves];
+            playMove( board, cell / MAX_BOARD_COLUMNS, cell % MAX_BOARD_COLUMNS, NULL );
+            nPasses = 0;
+        }
+    }
+}
+
+
+void printMctsStats( const Engine * engine, FILE * output )
+{
+    fprintf( output, "%s: %lu move(s), %lu playout(s) in %.3f s (%.0f playouts/s)\n",
+        engine->spec.name, engine->nMoves, engine->nPlayouts, engine->seconds,
+        engine->seconds > 0 ? engine->nPlayouts / engine->seconds : 0.0 );
+}
+
+
+void releaseMctsEngine( Engine * engine )
+{
+    free( engine->tree );
+    engine->tree = NULL;
+}
+
+
+void rankEngineMoves( Engine * engine, GameBoard * board, MoveRanking * ranking )
+{
+    const EngineType * type = engineType( engine->spec.kind );
+    MoveUndo undo;
+    short * grown;
+    int cells[MAX_MOVES];
+    int i;
+
+    ranking->nMoves = generateMoves( board, cells );
+    ranking->nFlips = 0;
+    for( i = 0; i < ranking->nMoves; i++ )
+    {   // one pass: play every move once, keeping what it reverses
+        playMove( board, cells[i] / MAX_BOARD_COLUMNS, cells[i] % MAX_BOARD_COLUMNS, &undo );
+        undoMove( board, &undo );
+        if( ranking->nFlips + undo.nFlips > ranking->flipCapacity )
+        {
+            ranking->flipCapacity = 2 * ranking->flipCapacity + MAX_FLIPS;
+            grown = realloc( ranking->flips, ranking->flipCapacity * sizeof( short ) );
+            assert( NULL != grown );
+            ranking->flips = grown;
+        }
+        memcpy( &ranking->flips[ranking->nFlips], undo.flips, undo.nFlips * sizeof( short ) );
+        ranking->moves[i].cell = cells[i];
+        ranking->moves[i].score = undo.nFlips;
+        ranking->moves[i].order = undo.nFlips;
+        ranking->moves[i].nFlips = undo.nFlips;
+        ranking->moves[i].firstFlip = ranking->nFlips;
+        ranking->nFlips += undo.nFlips;
+    }
+    if( 0 < ranking->nMoves && NULL != type->rank )
+    {
+        type->rank( engine, board, ranking );
+    }
+    qsort( ranking->moves, ranking->nMoves, sizeof( RankedMove ), compareRankedMoves );
+}
+
+
+int compareRankedMoves( const void * left, const void * right )
+{
+    const RankedMove * a = left;
+    const RankedMove * b = right;
+
+    return a->order != b->order ? ( a->order < b->order ? 1 : -1 ) : a->cell - b->cell;
+}
+
+
+void printMoveRanking( FILE * output, const MoveRanking * ranking, int count, boolean scored )
+{
+    const RankedMove * move;
+    int i, j;
+
+    if( count > ranking->nMoves )
+    {
+        count = ranking->nMoves;
+    }
+    fprintf( output, "Ranked moves (%d of %d):\n", count, ranking->nMoves );
+    for( i = 0; i < count; i++ )
+    {
+        move = &ranking->moves[i];
+        fprintf( output, "%3d. (%c, %d) reverses %d", i + 1,
+            move->cell % MAX_BOARD_COLUMNS + 'a', move->cell / MAX_BOARD_COLUMNS + 1, move->nFlips );
+        if( scored )
+        {
+            fprintf( output, ", score %d", move->score );
+        }
+        fprintf( output, ", flips" );
+        for( j = 0; j < move->nFlips; j++ )
+        {
+            fprintf( output, " %c%d", ranking->flips[move->firstFlip + j] % MAX_BOARD_COLUMNS + 'a',
+                ranking->flips[move->firstFlip + j] / MAX_BOARD_COLUMNS + 1 );
+        }
+        fprintf( output, "\n" );
+    }
+}
+
+
+void rankSearchMoves( Engine * engine, GameBoard * board, MoveRanking * ranking )
+{
+    MoveUndo undo;
+    int scores[MAX_MOVES];
+    int row, col, i, depth, iteration;
+    int nEmpty = 0;
+    boolean exact;
+
+    for( row = 0; row < board->nRows; row++ )
+    {
+        for( col = 0; col < board->nColumns; col++ )
+        {
+            nEmpty += NONE == board->state[row][col];
+        }
+    }
+    exact = ENGINE_ENDGAME == engine->spec.kind && nEmpty <= engine->spec.endgameEmpties;
+    depth = exact ? nEmpty : engine->depth;
+    engine->search.weights = engine->weights;
+    engine->search.stopped = false;
+    engine->search.deadline = !exact && 0 < engine->spec.moveTime ? currentSeconds( ) + engine->spec.moveTime : 0;
+    clearMoveOrdering( &engine->search );
+    for( iteration = exact ? depth : 1; iteration <= depth && !engine->search.stopped; iteration++ )
+    {
+        ageMoveOrdering( &engine->search );
+        for( i = 0; i < ranking->nMoves; i++ )
+        {
+            playMove( board, ranking->moves[i].cell / MAX_BOARD_COLUMNS, ranking->moves[i].cell % MAX_BOARD_COLUMNS, &undo );
+            scores[i] = -searchPosition( &engine->search, board, iteration - 1, -SEARCH_INFINITY, SEARCH_INFINITY );
+            undoMove( board, &undo );
+            if( engine->search.stopped && 1 < iteration )
+            {   // an interrupted iteration only counts when there is nothing better
+                break;
+            }
+        }
+        for( i = 0; i < ranking->nMoves && ( !engine->search.stopped || 1 == iteration ); i++ )
+        {   // a game-ending score is printed as the disc difference, but still ranks above any estimate
+            ranking->moves[i].order = scores[i];
+            ranking->moves[i].score = scores[i] > SEARCH_WIN / 2 ? scores[i] - SEARCH_WIN
+                : scores[i] < -SEARCH_WIN / 2 ? scores[i] + SEARCH_WIN : scores[i];
+        }
+    }
+    engine->search.deadline = 0;
+}
+
+
+void rankMctsMoves( Engine * engine, GameBoard * board, MoveRanking * ranking )
+{
+    const MctsNode * root;
+    const MctsNode * child;
+    BoardMove best;
+    int i, j;
+
+    if( !engine->treeChosen || hashGameBoard( board ) != engine->treeKey )
+    {
+        chooseMctsMove( engine, board, &best );
+    }
+    root = &engine->tree[0];
+    for( i = 0; i < ranking->nMoves; i++ )
+    {
+        ranking->moves[i].score = 0;
+        ranking->moves[i].order = 0;
+        for( j = 0; j < root->nChildren; j++ )
+        {
+            child = &engine->tree[root->firstChild + j];
+            if( child->move == ranking->moves[i].cell && 0 < child->visits )
+            {
+                ranking->moves[i].score = (int)lrint( 100.0 * child->wins / child->visits );
+                ranking->moves[i].order = (int)child->visits;
+            }
+        }
+    }
+}
+
+
+void ponderSearch( Engine * engine, GameBoard * board, BoardMove * best )
+{
+    double moveTime = engine->spec.moveTime;
+
+    engine->spec.moveTime = 0; // until stopped, whatever the time per move
+    engineType( engine->spec.kind )->choose( engine, board, best );
+    engine->spec.moveTime = moveTime;
+}
+
+
+void startPonder( PonderContext * ponder, Engine * engine, const GameBoard * board )
+{
+    memset( ponder, 0, sizeof( PonderContext ) );
+    ponder->engine = engine;
+    ponder->board = *board;
+    ponder->predicted = -1;
+    if( NULL == engineType( engine->spec.kind )->ponder )
+    {
+        return;
+    }
+    if( NULL != engine->search.table )
+    {   // the searches ponder the reply their principal variation expects
+        if( 1 != principalVariation( &engine->search, &ponder->board, &ponder->predicted, 1 ) )
+        {
+            return;
+        }
+        playMove( &ponder->board, ponder->predicted / MAX_BOARD_COLUMNS, ponder->predicted % MAX_BOARD_COLUMNS, NULL );
+    }
+    engine->search.stopRequest = 0;
+    ponder->running = 0 == pthread_create( &ponder->thread, NULL, ponderThread, ponder );
+}
+
+
+void stopPonder( PonderContext * ponder )
+{
+    if( ponder->running )
+    {
+        ponder->engine->search.stopRequest = 1;
+        pthread_join( ponder->thread, NULL );
+        ponder->engine->search.stopRequest = 0;
+        ponder->running = false;
+    }
+}
+
+
+void * ponderThread( void * argument )
+{
+    PonderContext * ponder = argument;
+    Engine * engine = ponder->engine;
+    unsigned long nodes = engine->search.nodes;
+    unsigned long tableHits = engine->search.tableHits;
+    unsigned long researches = engine->search.researches;
+    unsigned long aspirationFails = engine->search.aspirationFails;
+    unsigned long cutoffs = engine->search.cutoffs;
+    unsigned long firstCutoffs = engine->search.firstCutoffs;
+    unsigned long nPlayouts = engine->nPlayouts;
+
+    if( ponder->analysis )
+    {
+        engine->search.info = &ponder->info;
+        chooseEngineMove( engine, &ponder->board, &ponder->best );
+        engine->search.info = NULL;
+        if( 0 > ponder->best.row )
+        {
+            printf( "best pass\n" );
+        }
+        else
+        {
+            printf( "best %c%d\n", ponder->best.col + 'a', ponder->best.row + 1 );
+        }
+        fflush( stdout );
+        return NULL;
+    }
+    engineType( engine->spec.kind )->ponder( engine, &ponder->board, &ponder->best );
+    ponder->complete = !engine->search.stopRequest && !engine->search.stopped;
+    // the totals of the engine measure the time spent on its own moves
+    engine->search.nodes = nodes;
+    engine->search.tableHits = tableHits;
+    engine->search.researches = researches;
+    engine->search.aspirationFails = aspirationFails;
+    engine->search.cutoffs = cutoffs;
+    engine->search.firstCutoffs = firstCutoffs;
+    engine->nPlayouts = nPlayouts;
+    return NULL;
+}
+
+
+boolean runPlay( const Options * options )
+{
+    Engine engine;
+    PonderContext ponder;
+    InfoSink info;
+    GameClock clock = options->clock;
+    GameBoard board;
+    BoardMove best;
+    MoveUndo undo;
+    char line[LINE_MAX];
+    char command[LINE_MAX];
+    char column;
+    int row, cell;
+    unsigned long nPonders = 0;
+    unsigned long nHits = 0;
+
+    initEngine( &engine, &options->engine, options );
+    initStartBoard( &board, 8, 8 );
+    memset( &ponder, 0, sizeof( PonderContext ) );
+    while( NULL != fgets( line, sizeof( line ), stdin ) )
+    {
+        if( 1 != sscanf( line, "%s", command ) )
+        {
+            continue;
+        }
+        if( 0 == strcmp( command, "quit" ) )
+        {
+            break;
+        }
+        else if( 0 == strcmp( command, "new" ) )
+        {
+            stopPonder( &ponder );
+            ponder.complete = false;
+            resetEngine( &engine );
+            initStartBoard( &board, 8, 8 );
+            clock = options->clock;
+            printf( "ok\n" );
+        }
+        else if( 0 == strcmp( command, "board" ) )
+        {   // an analysis may be printing meanwhile
+            flockfile( stdout );
+            printBoard( stdout, &board );
+            fflush( stdout );
+            funlockfile( stdout );
+        }
+        else if( 0 == strcmp( command, "stop" ) )
+        {
+            if( !ponder.running || !ponder.analysis )
+            {
+                printf( "error no analysis\n" );
+            }
+            else
+            {   // the analysis answers with its move
+                stopPonder( &ponder );
+            }
+        }
+        else if( 0 == strcmp( command, "analyze" ) )
+        {
+            stopPonder( &ponder );
+            memset( &ponder, 0, sizeof( PonderContext ) );
+            ponder.engine = &engine;
+            ponder.board = board;
+            ponder.analysis = true;
+            startInfo( &ponder.info, stdout, options->infoInterval, &engine.search );
+            ponder.running = 0 == pthread_create( &ponder.thread, NULL, ponderThread, &ponder );
+        }
+        else if( 0 == strcmp( command, "move" ) || 0 == strcmp( command, "pass" ) )
+        {
+            cell = -1;
+            if( 0 == strcmp( command, "move" ) )
+            {
+                if( 2 != sscanf( line, "%*s %c%d", &column, &row )
+                    || !isLegalMove( &board, row - 1, ( column | 0x20 ) - 'a' ) )
+                {
+                    printf( "error illegal move\n" );
+                    fflush( stdout );
+                    continue;
+                }
+                cell = ( row - 1 ) * MAX_BOARD_COLUMNS + ( column | 0x20 ) - 'a';
+            }
+            else if( 0 < generateMoves( &board, NULL ) )
+            {
+                printf( "error a move is possible\n" );
+                fflush( stdout );
+                continue;
+            }
+            stopPonder( &ponder );
+            if( 0 > cell )
+            {
+                passMove( &board, NULL );
+            }
+            else
+            {
+                playMove( &board, cell / MAX_BOARD_COLUMNS, cell % MAX_BOARD_COLUMNS, NULL );
+            }
+            if( NULL != engine.tree )
+            {   // keep what the tree learnt below the reply
+                advanceMctsTree( &engine, &board, cell );
+                nHits += options->ponder && 0 != engine.treeKey;
+            }
+            printf( "ok\n" );
+        }
+        else if( 0 == strcmp( command, "go" ) )
+        {
+            stopPonder( &ponder );
+            if( ponder.complete && 0 <= ponder.best.row && hashGameBoard( &ponder.board ) == hashGameBoard( &board ) )
+            {   // the predicted reply came: the ponder answered it already
+                best = ponder.best;
+                nHits++;
+            }
+            else
+            {
+                engine.search.info = options->info ? &info : NULL;
+                engine.clock = 0 < options->clock.remaining ? &clock : NULL;
+                startInfo( &info, stdout, options->infoInterval, &engine.search );
+                chooseEngineMove( &engine, &board, &best );
+                engine.search.info = NULL;
+                engine.clock = NULL;
+            }
+            ponder.complete = false;
+            if( 0 > best.row )
+            {   // no legal move: a pass, unless neither side can move
+                passMove( &board, &undo );
+                if( 0 == generateMoves( &board, NULL ) )
+                {
+                    undoMove( &board, &undo );
+                    printf( "error game over\n" );
+                }
+                else
+                {
+                    printf( "pass\n" );
+                }
+            }
+            else
+            {
+                playMove( &board, best.row, best.col, NULL );
+                if( NULL != engine.tree )
+                {
+                    advanceMctsTree( &engine, &board, best.row * MAX_BOARD_COLUMNS + best.col );
+                }
+                printf( "move %c%d\n", best.col + 'a', best.row + 1 );
+                if( options->ponder )
+                {
+                    startPonder( &ponder, &engine, &board );
+                    nPonders += ponder.running;
+                }
+            }
+        }
+        else
+        {
+            printf( "error unknown command '%s'\n", command );
+        }
+        fflush( stdout );
+    }
+    stopPonder( &ponder );
+    if( options->ponder )
+    {
+        fprintf( stderr, "ponder: %lu hit(s) in %lu ponder(s)\n", nHits, nPonders );
+    }
+    printEngineStats( &engine, stderr );
+    freeEngine( &engine );
+    return !ferror( stdin );
+}
+
+
+void pollSearch( SearchContext * search )
+{
+    InfoSink * info = search->info;
+    double now = currentSeconds( );
+    double elapsed;
+    unsigned long nodes;
+
+    if( search->stopRequest || ( 0 < search->deadline && now >= search->deadline ) )
+    {
+        search->stopped = true;
+    }
+    if( NULL != info && 0 < info->interval && now >= info->next )
+    {
+        elapsed = now - info->start;
+        nodes = search->nodes - info->startNodes;
+        flockfile( info->output );
+        fprintf( info->output, "info time %.0f nodes %lu nps %.0f\n",
+            1000 * elapsed, nodes, elapsed > 0 ? nodes / elapsed : 0.0 );
+        fflush( info->output );
+        funlockfile( info->output );
+        info->next = now + info->interval;
+    }
+}
+
+
+void startInfo( InfoSink * info, FILE * output, double interval, const SearchContext * search )
+{
+    info->output = output;
+    info->start = currentSeconds( );
+    info->startNodes = search->nodes;
+    info->interval = interval;
+    info->next = info->start + interval;
+}
+
+
+void printSearchInfo( SearchContext * search, GameBoard * board, const BoardMove * best )
+{
+    InfoSink * info = search->info;
+    int moves[MAX_PV_LENGTH];
+    int nMoves, i;
+    double now = currentSeconds( );
+    double elapsed = now - info->start;
+    unsigned long nodes = search->nodes - info->startNodes;
+
+    // the table may hold deeper lines from earlier searches
+    nMoves = principalVariation( search, board, moves, best->depth < MAX_PV_LENGTH ? best->depth : MAX_PV_LENGTH );
+    if( 0 == nMoves && 0 <= best->row )
+    {   // no table to follow
+        moves[nMoves++] = best->row * MAX_BOARD_COLUMNS + best->col;
+    }
+    // one line, whatever the thread answering commands prints meanwhile
+    flockfile( info->output );
+    fprintf( info->output, "info depth %d score %d time %.0f nodes %lu nps %.0f pv",
+        best->depth, best->score, 1000 * elapsed, nodes, elapsed > 0 ? nodes / elapsed : 0.0 );
+    for( i = 0; i < nMoves; i++ )
+    {
+        fprintf( info->output, " %c%d", moves[i] % MAX_BOARD_COLUMNS + 'a', moves[i] / MAX_BOARD_COLUMNS + 1 );
+    }
+    fprintf( info->output, "\n" );
+    fflush( info->output );
+    funlockfile( info->output );
+    info->next = now + info->interval;
+}
+
+
+void printMctsInfo( Engine * engine, const GameBoard * board, int depth )
+{
+    InfoSink * info = engine->search.info;
+    const MctsNode * node = &engine->tree[0];
+    const MctsNode * child;
+    const MctsNode * first = NULL;
+    int i, nMoves;
+    double now = currentSeconds( );
+
+    (void)board;
+    flockfile( info->output );
+    fprintf( info->output, "info depth %d", depth );
+    for( nMoves = 0; 0 < node->nChildren && nMoves < MAX_PV_LENGTH; nMoves++ )
+    {   // the principal variation follows the most visited children
+        child = &engine->tree[node->firstChild];
+        for( i = 1; i < node->nChildren; i++ )
+        {
+            if( engine->tree[node->firstChild + i].visits > child->visits )
+            {
+                child = &engine->tree[node->firstChild + i];
+            }
+        }
+        if( 0 == child->visits )
+        {
+            break;
+        }
+        if( NULL == first )
+        {
+            first = child;
+            fprintf( info->output, " score %d time %.0f playouts %u pv", (int)lrint( 100.0 * child->wins / child->visits ),
+                1000 * ( now - info->start ), engine->tree[0].visits );
+        }
+        if( 0 > child->move )
+        {
+            fprintf( info->output, " --" );
+        }
+        else
+        {
+            fprintf( info->output, " %c%d", child->move % MAX_BOARD_COLUMNS + 'a', child->move / MAX_BOARD_COLUMNS + 1 );
+        }
+        node = child;
+    }
+    fprintf( info->output, "\n" );
+    fflush( info->output );
+    funlockfile( info->output );
+    info->next = now + info->interval;
+}
+
+
+boolean parseNboardMove( const char * text, int * cell )
 {
-    GameBoard board;
-    int col, row;
-    int bestCol = -1;
-    int bestRow = -1;
-    int bestReverse = 0;
-    int currReverse = 0;
-    boolean success = false;
+    char column;
+    int row;
+
+    if( 'p' == ( text[0] | 0x20 ) && 'a' == ( text[1] | 0x20 ) )
+    {   // "PA", or "pass" as some GGF writers have it
+        *cell = -1;
+        return true;
+    }
+    if( 2 != sscanf( text, "%c%d", &column, &row ) )
+    {
+        return false;
+    }
+    column |= 0x20;
+    if( column < 'a' || column >= 'a' + MAX_BOARD_COLUMNS || row < 1 || row > MAX_BOARD_ROWS )
+    {
+        return false;
+    }
+    *cell = ( row - 1 ) * MAX_BOARD_COLUMNS + column - 'a';
+    return true;
+}
+
+
+boolean playNboardMove( GameBoard * board, int cell )
+{
+    if( 0 > cell )
+    {
+        if( 0 < generateMoves( board, NULL ) )
+        {
+            return false;
+        }
+        passMove( board, NULL );
+        return true;
+    }
+    if( cell / MAX_BOARD_COLUMNS >= board->nRows || cell % MAX_BOARD_COLUMNS >= board->nColumns
+        || !isLegalMove( board, cell / MAX_BOARD_COLUMNS, cell % MAX_BOARD_COLUMNS ) )
+    {
+        return false;
+    }
+    playMove( board, cell / MAX_BOARD_COLUMNS, cell % MAX_BOARD_COLUMNS, NULL );
+    return true;
+}
+
 
-    if( readGameBoard( &board ) )
+boolean parseGgfGame( const char * text, GameBoard * board )
+{
+    const char * next = text;
+    const char * open;
+    const char * close;
+    const char * tag;
+    GameBoardCell player;
+    int size, offset, cell;
+    boolean started = false;
+
+    while( NULL != ( open = strchr( next, '[' ) ) )
     {
-        printBoard( &board );
-        for( row = 0; row < board.nRows; row++ )
+        if( NULL == ( close = strchr( open, ']' ) ) )
+        {
+            return false;
+        }
+        for( tag = open; tag > next && 'A' <= tag[-1] && 'Z' >= tag[-1]; tag-- )
         {
-            for( col = 0; col < board.nColumns; col++ )
+        }
+        if( 2 == open - tag && 'B' == tag[0] && 'O' == tag[1] )
+        {   // start position: size, cells row by row, side to move
+            if( 1 != sscanf( open + 1, "%d%n", &size, &offset ) || size < 2 || size > MAX_BOARD_ROWS
+                || size > MAX_BOARD_COLUMNS )
+            {
+                return false;
+            }
+            memset( board, 0, sizeof( GameBoard ) );
+            board->nRows = size;
+            board->nColumns = size;
+            snprintf( board->title, sizeof( board->title ), "NBOARD GAME %dx%d", size, size );
+            open += 1 + offset;
+            for( cell = 0; cell <= size * size && open < close; open++ )
             {
-                if( canPlayAt( &board, row, col ) )
+                if( ' ' == *open || '\t' == *open )
                 {
-                    board.state[row][col] = board.player; // play the piece
-                    currReverse = numAllReverse( &board, row, col );
-                    board.state[row][col] = NONE; // revert our last change
-                    if( currReverse > bestReverse )
-                    {
-                        bestCol = col;
-                        bestRow = row;
-                        bestReverse = currReverse;
-                    }
+                    continue;
+                }
+                player = '*' == *open || 'x' == ( *open | 0x20 ) ? BLACK : 'o' == ( *open | 0x20 ) ? WHITE : NONE;
+                if( NONE == player && '-' != *open && '.' != *open )
+                {
+                    return false;
+                }
+                if( cell < size * size )
+                {
+                    board->state[cell / size][cell % size] = player;
+                }
+                else if( NONE == player )
+                {
+                    return false;
+                }
+                else
+                {
+                    board->player = player;
                 }
+                cell++;
+            }
+            if( cell != size * size + 1 )
+            {
+                return false;
             }
+            started = true;
         }
-        printf( "\n" );
-        printf( "The best move for %s is (%c, %d), which will reverse %d opponent piece(s)\n",
-            WHITE == board.player ? "WHITE" : "BLACK",
-            bestCol + 'a',
-            bestRow + 1,
-            bestReverse );
-        printf( "\n" );
-        success = true;
+        else if( 1 == open - tag && ( 'B' == tag[0] || 'W' == tag[0] ) )
+        {
+            if( !started || !parseNboardMove( open + 1, &cell ) )
+            {
+                return false;
+            }
+            if( board->player != ( 'B' == tag[0] ? BLACK : WHITE ) )
+            {   // a pass the record leaves out
+                if( 0 < generateMoves( board, NULL ) )
+                {
+                    return false;
+                }
+                passMove( board, NULL );
+            }
+            if( !playNboardMove( board, cell ) )
+            {
+                return false;
+            }
+        }
+        next = close + 1;
     }
-    return success;
+    return started;
 }
 
 
-boolean canPlayAt( const GameBoard * board, int row, int col )
+boolean runNboard( const Options * options )
 {
-    boolean result = false;
-
-	if (checkstate(board))
-	{
-		assert(0 <= row && row < board->nRows);
-		assert(0 <= col && col < board->nColumns);
-
-		//only can play at the spot that demonstrates NONE state
-		if (0 <= row && row < board->nRows && 0 <= col && col < board->nColumns && board->state[row][col] == NONE)
-		{
-			//check if opponent's piece is around given position. 8 directions 
-			if ((row - 1 >= 0 && row -1 < board->nRows && col -1 >= 0 && col - 1 < board->nRows && board->state[row - 1][col - 1] != board->player && board->state[row - 1][col - 1] != NONE)
-				|| (row - 1 > 0 && row - 1 < board->nRows && board->state[row - 1][col] != board->player && board->state[row - 1][col] != NONE)
-				|| (row - 1 >= 0 && row - 1 < board->nRows && col + 1 >= 0 && col + 1 < board->nRows && board->state[row - 1][col + 1] != board->player && board->state[row - 1][col + 1] != NONE)
-				|| (col - 1 >= 0 && col - 1 < board->nRows && board->state[row][col - 1] != board->player && board->state[row][col - 1] != NONE)
-				|| (col + 1 >= 0 && col + 1 < board->nRows && board->state[row][col + 1] != board->player && board->state[row][col + 1] != NONE)
-				|| (row + 1 >= 0 && row + 1 < board->nRows && col - 1 >= 0 && col - 1 < board->nRows && board->state[row + 1][col - 1] != board->player && board->state[row + 1][col - 1] != NONE)
-				|| (row + 1 >= 0 && row + 1 < board->nRows && board->state[row + 1][col] != board->player && board->state[row + 1][col] != NONE)
-				|| (row + 1 >= 0 && row + 1 < board->nRows && col + 1 >= 0 && col + 1 < board->nRows && board->state[row + 1][col + 1] != board->player && board->state[row + 1][col + 1] != NONE))
-			{
-				result = true;
-			}
-		}
-	}
+    Engine engine;
+    GameBoard board;
+    BoardMove best;
+    MoveRanking ranking;
+    GameClock clock = options->clock;
+    char * line = NULL;
+    size_t lineCapacity = 0;
+    char command[LINE_MAX];
+    char argument[LINE_MAX];
+    int i, count, cell;
+    unsigned long nodes;
+    double start;
 
-	return result;
+    initEngine( &engine, &options->engine, options );
+    initStartBoard( &board, 8, 8 );
+    memset( &ranking, 0, sizeof( MoveRanking ) );
+    while( 0 <= getline( &line, &lineCapacity, stdin ) )
+    {
+        line[strcspn( line, "\r\n" )] = '\0';
+        argument[0] = '\0';
+        if( 1 > sscanf( line, "%s %s", command, argument ) )
+        {
+            continue;
+        }
+        if( 0 == strcmp( command, "quit" ) )
+        {
+            break;
+        }
+        else if( 0 == strcmp( command, "nboard" ) )
+        {
+            printf( "set myname %s\n", engine.spec.name );
+        }
+        else if( 0 == strcmp( command, "ping" ) )
+        {   // every command before it is answered already
+            printf( "pong %s\n", argument );
+        }
+        else if( 0 == strcmp( command, "learn" ) )
+        {
+            printf( "learned\n" );
+        }
+        else if( 0 == strcmp( command, "set" ) && 0 == strcmp( argument, "depth" ) )
+        {
+            if( 1 != sscanf( line, "%*s %*s %d", &count ) || count < 1 || count > MAX_MOVES )
+            {
+                fprintf( stderr, "nboard: bad depth in '%s'\n", line );
+            }
+            else
+            {
+                engine.depth = count;
+            }
+        }
+        else if( 0 == strcmp( command, "set" ) && 0 == strcmp( argument, "game" ) )
+        {   // the engine keeps its tables: positions of the game are likely met again
+            if( !parseGgfGame( strstr( line, "game" ) + 4, &board ) )
+            {
+                fprintf( stderr, "nboard: bad game in '%s'\n", line );
+                initStartBoard( &board, 8, 8 );
+            }
+            clock = options->clock;
+        }
+        else if( 0 == strcmp( command, "set" ) )
+        {   // contempt and other settings do not apply
+        }
+        else if( 0 == strcmp( command, "move" ) )
+        {
+            if( !parseNboardMove( argument, &cell ) || !playNboardMove( &board, cell ) )
+            {
+                fprintf( stderr, "nboard: illegal move '%s'\n", argument );
+            }
+            else if( NULL != engine.tree )
+            {   // keep what the tree learnt below the move
+                advanceMctsTree( &engine, &board, cell );
+            }
+        }
+        else if( 0 == strcmp( command, "go" ) || 0 == strcmp( command, "hint" ) )
+        {
+            nodes = engine.search.nodes + engine.nPlayouts;
+            start = currentSeconds( );
+            printf( "status %s\n", 0 == strcmp( command, "go" ) ? "Thinking" : "Analysing" );
+            fflush( stdout );
+            if( 0 == strcmp( command, "go" ) )
+            {
+                engine.clock = 0 < options->clock.remaining ? &clock : NULL;
+                chooseEngineMove( &engine, &board, &best );
+                engine.clock = NULL;
+                printf( "nodestats %lu %.3f\n", engine.search.nodes + engine.nPlayouts - nodes, currentSeconds( ) - start );
+                if( 0 > best.row )
+                {
+                    printf( "=== PA\n" );
+                }
+                else
+                {
+                    printf( "=== %c%d/%d/%.3f\n", best.col + 'A', best.row + 1, best.score, currentSeconds( ) - start );
+                }
+            }
+            else
+            {
+                count = atoi( argument );
+                rankEngineMoves( &engine, &board, &ranking );
+                if( 0 == ranking.nMoves && 0 < count )
+                {   // the pass is the only move, its evaluation that of the engine's choice, not played
+                    engineType( engine.spec.kind )->choose( &engine, &board, &best );
+                    printf( "search PA %d 0 %d\n", best.score, engine.depth );
+                }
+                for( i = 0; i < ranking.nMoves && i < count; i++ )
+                {
+                    printf( "search %c%d %d 0 %d\n", ranking.moves[i].cell % MAX_BOARD_COLUMNS + 'A',
+                        ranking.moves[i].cell / MAX_BOARD_COLUMNS + 1, ranking.moves[i].score, engine.depth );
+                }
+                printf( "nodestats %lu %.3f\n", engine.search.nodes + engine.nPlayouts - nodes, currentSeconds( ) - start );
+            }
+            printf( "status\n" );
+        }
+        else
+        {
+            fprintf( stderr, "nboard: unsupported command '%s'\n", command );
+        }
+        fflush( stdout );
+    }
+    printEngineStats( &engine, stderr );
+    freeEngine( &engine );
+    free( ranking.flips );
+    free( line );
+    return !ferror( stdin );
 }
 
 
-int numAllReverse( const GameBoard * board, int row, int col )
+void allocateMoveTime( const GameClock * clock, const GameBoard * board, double * soft, double * hard )
 {
-    int count = 0;
+    int row, col;
+    int nEmpty = 0;
+    double usable = clock->remaining - TIME_SAFETY_MARGIN;
 
-    if( checkstate( board ) )
+    for( row = 0; row < board->nRows; row++ )
     {
-        assert( 0 <= row && row < board->nRows );
-        assert( 0 <= col && col < board->nColumns );
-        assert( board->state[row][col] == board->player );
-
-        if( 0 <= row && row < board->nRows && 0 <= col && col < board->nColumns && board->state[row][col] == board->player )
-        {   // we could make following statements to one; however, this is easier to step-in in debugger
-            count += numReverseDirection( board, row, col, -1, -1 );
-            count += numReverseDirection( board, row, col, -1, 0 );
-            count += numReverseDirection( board, row, col, -1, 1 );
-            count += numReverseDirection( board, row, col, 0, -1 );
-            count += numReverseDirection( board, row, col, 0, 1 );
-            count += numReverseDirection( board, row, col, 1, -1 );
-            count += numReverseDirection( board, row, col, 1, 0 );
-            count += numReverseDirection( board, row, col, 1, 1 );
+        for( col = 0; col < board->nColumns; col++ )
+        {
+            nEmpty += NONE == board->state[row][col];
         }
     }
-    return count;
+    *soft = fmax( usable, 0 ) / ( ( nEmpty + 1 ) / 2 + TIME_RESERVE_MOVES ) + clock->increment;
+    *hard = fmin( *soft * HARD_TIME_FACTOR, fmax( usable, 0 ) / 2 + clock->increment );
+    *hard = fmin( *hard, usable );
+    *soft = fmin( *soft, *hard );
+    *soft = fmax( *soft, MIN_MOVE_TIME );
+    *hard = fmax( *hard, MIN_MOVE_TIME );
 }
 
 
-int numReverseDirection( const GameBoard * board, int row, int col, int dirRow, int dirCol )
+boolean isMctsSettled( const Engine * engine, long nPlayouts, double elapsed )
 {
-	int count = 0;
-
-	if (checkstate(board))
-	{
-		assert(0 <= row && row < board->nRows);
-		assert(0 <= col && col < board->nColumns);
-		assert(board->state[row][col] == board->player);
-		
-		if (0 <= row && row < board->nRows && 0 <= col && col < board->nColumns && board->state[row][col] == board->player)
-		{
-			//the cell which we are going to check must be inside board.
-			while (0 <= row + dirRow && row + dirRow < board->nRows && 0 <= col + dirCol && col + dirCol < board->nColumns)
-			{
-				if (board->state[row + dirRow][col + dirCol] == board->player)
-					return count;
-				else if (board->state[row + dirRow][col + dirCol] == NONE)
-					break;
-				else
-					count++;
+    const MctsNode * root = &engine->tree[0];
+    uint32_t first = 0;
+    uint32_t second = 0;
+    int i;
 
-				row = row + dirRow;
-				col = col + dirCol;
-			}
-		}	
-	}
-	//outside board or found NONE state position.
-	count = 0;
-	return count;
+    if( elapsed >= engine->search.softTime )
+    {
+        return true;
+    }
+    for( i = 0; i < root->nChildren; i++ )
+    {
+        if( engine->tree[root->firstChild + i].visits > first )
+        {
+            second = first;
+            first = engine->tree[root->firstChild + i].visits;
+        }
+        else if( engine->tree[root->firstChild + i].visits > second )
+        {
+            second = engine->tree[root->firstChild + i].visits;
+        }
+    }
+    // at the rate so far, the runner-up could not catch up before the soft limit
+    return first - second > nPlayouts / elapsed * ( engine->search.softTime - elapsed );
 }
 
 
-boolean readGameBoard( GameBoard * board )
+int searchAspiration( SearchContext * search, GameBoard * board, int depth, int guess, BoardMove * best )
 {
-    char line[LINE_MAX];
-    char player = 0;
-    int length = 0;
-    int col, row;
-    boolean success = false;
+    int width = ASPIRATION_WINDOW;
+    int alpha = guess - width;
+    int beta = guess + width;
+    int score;
 
-    assert( NULL != board );
-    if( NULL != board )
+    for( ;; )
     {
-        memset( board, 0, sizeof( GameBoard ) ); // initialization
-
-        fgets( board->title, MAX_BOARD_TITLE, stdin );
-        length = strlen( board->title );
-        if( length > 0 && board->title[length - 1] == '\n' )
-        {   // remove \n
-            board->title[length - 1] = '\0';
+        score = searchRoot( search, board, depth, alpha, beta, best );
+        if( search->stopped || ( score > alpha && score < beta ) )
+        {
+            return score;
         }
-
-        fgets( line, MAX_BOARD_TITLE, stdin );
-        sscanf( line, "%d %d %c", &board->nColumns, &board->nRows, &player );
-        board->player = 'W' == player ? WHITE : BLACK; // who will play next?
-
-        for( row = 0; NULL != fgets( line, LINE_MAX, stdin ) && row < board->nRows; row++ )
-        {   // by putting read line first, we discard the last empty line
-            for( col = 0; '\0' != line[col] && col < board->nColumns; col++ )
-            {
-                switch( line[col] )
-                {
-                case 'B':
-                    board->state[row][col] = BLACK;
-                    break;
-                case 'W':
-                    board->state[row][col] = WHITE;
-                    break;
-                case ' ':
-                default:
-                    board->state[row][col] = NONE;
-                    break;
-                }
-            }
+        search->aspirationFails++;
+        width *= 2;
+        if( score <= alpha )
+        {
+            alpha = score - width > -SEARCH_INFINITY ? score - width : -SEARCH_INFINITY;
+        }
+        else
+        {
+            beta = score + width < SEARCH_INFINITY ? score + width : SEARCH_INFINITY;
         }
-        success = row > 0 && row >= board->nRows && checkstate( board );
     }
-    return success;
 }
 
 
-void printBoard( const GameBoard * board )
+void orderMoves( SearchContext * search, GameBoard * board, int * cells, int nMoves, int hintMove, int depth )
 {
-    int col, row;
+    const short * killers = search->killers[depth < MAX_MOVES ? depth : MAX_MOVES];
+    MoveUndo undo;
+    int keys[MAX_MOVES];
+    int i, j, cell, key;
 
-    if( checkstate( board ) )
+    for( i = 0; i < nMoves; i++ )
     {
-        printf( "%s\n\n", board->title );
-        printBoardColumnName( board->nColumns );
-        printBoardRowSeparator( board->nColumns );
-        for( row = 0; row < board->nRows; row++ )
+        cell = cells[i];
+        if( cell == hintMove )
         {
-            printf( "%2d|", row + 1 );
-            for( col = 0; col < board->nColumns; col++ )
-            {
-                switch( board->state[row][col] )
-                {
-                case BLACK:
-                    printf( "B|" );
-                    break;
-                case WHITE:
-                    printf( "W|" );
-                    break;
-                default:
-                    printf( " |" );
-                    break;
-                }
+            key = ORDER_TABLE_MOVE;
+        }
+        else if( cell + 1 == killers[0] || cell + 1 == killers[1] )
+        {
+            key = cell + 1 == killers[0] ? ORDER_KILLER + 1 : ORDER_KILLER;
+        }
+        else
+        {
+            key = search->history[cell];
+            if( depth >= ORDER_MOBILITY_DEPTH )
+            {   // fewer replies first
+                playMove( board, cell / MAX_BOARD_COLUMNS, cell % MAX_BOARD_COLUMNS, &undo );
+                key -= ORDER_MOBILITY_WEIGHT * generateMoves( board, NULL );
+                undoMove( board, &undo );
             }
-            printf( "%-2d\n", row + 1 );
-            printBoardRowSeparator( board->nColumns );
         }
-        printBoardColumnName( board->nColumns );
+        for( j = i; j > 0 && keys[j - 1] < key; j-- )
+        {   // insertion sort: stable, and the lists are short
+            keys[j] = keys[j - 1];
+            cells[j] = cells[j - 1];
+        }
+        keys[j] = key;
+        cells[j] = cell;
     }
 }
 
 
-void printBoardColumnName( int nColumns )
+void recordCutoff( SearchContext * search, int cell, int depth, int index )
 {
-    int col;
+    short * killers = search->killers[depth < MAX_MOVES ? depth : MAX_MOVES];
+    int i;
 
-    assert( nColumns > 0 );
-    assert( nColumns < MAX_BOARD_COLUMNS );
-    printf( "   " );
-    for( col = 0; col < nColumns; col++ )
+    search->cutoffs++;
+    search->firstCutoffs += 0 == index;
+    search->history[cell] += depth * depth;
+    if( search->history[cell] > ORDER_HISTORY_LIMIT )
+    {
+        for( i = 0; i < MAX_MOVES; i++ )
+        {
+            search->history[i] /= 2;
+        }
+    }
+    if( cell + 1 != killers[0] )
     {
-        printf( "%c ", 'a' + col );
+        killers[1] = killers[0];
+        killers[0] = (short)( cell + 1 );
     }
-    printf( "  \n" );
 }
 
 
-void printBoardRowSeparator( int nColumns )
+void ageMoveOrdering( SearchContext * search )
 {
-    int col;
+    int i;
 
-    assert( nColumns > 0 );
-    assert( nColumns < MAX_BOARD_COLUMNS );
-    printf( "  +" );
-    for( col = 0; col < nColumns; col++ )
+    for( i = 0; i < MAX_MOVES; i++ )
     {
-        printf( "-+" );
+        search->history[i] /= 2;
     }
-    printf( "\n" );
+    memset( search->killers, 0, sizeof( search->killers ) );
 }
 
+
+void clearMoveOrdering( SearchContext * search )
+{
+    memset( search->history, 0, sizeof( search->history ) );
+    memset( search->killers, 0, sizeof( search->killers ) );
+}
@@ -0,0 +1,29 @@
+#!/bin/sh
+# Golden-file checks in the style of TEST_INPUT / TEST_OUTPUT: every directory under
+# tests/ holds a TEST_COMMAND, run by sh in a scratch copy of the directory with
+# $REVERSI set to the program, whose standard output must match TEST_OUTPUT.
+#
+#     gcc -O2 -pthread -o reversi reversi.c -lm && sh tests/run_tests.sh ./reversi
+
+REVERSI=$(cd "$(dirname "${1:-./reversi}")" && pwd)/$(basename "${1:-./reversi}")
+TESTS=$(cd "$(dirname "$0")" && pwd)
+SCRATCH=$(mktemp -d)
+export REVERSI
+trap 'rm -rf "$SCRATCH"' EXIT
+
+failed=0
+"$REVERSI" < "$TESTS/../TEST_INPUT" 2> /dev/null | cmp -s - "$TESTS/../TEST_OUTPUT" \
+    || { echo "FAIL TEST_INPUT"; failed=1; }
+for dir in "$TESTS"/*/; do
+    name=$(basename "$dir")
+    rm -rf "$SCRATCH/$name"
+    cp -R "$dir" "$SCRATCH/$name"
+    if ( cd "$SCRATCH/$name" && sh ./TEST_COMMAND > actual 2> /dev/null ) && cmp -s "$SCRATCH/$name/actual" "$dir/TEST_OUTPUT"; then
+        echo "ok   $name"
+    else
+        echo "FAIL $name"
+        diff "$dir/TEST_OUTPUT" "$SCRATCH/$name/actual" | head -20
+        failed=1
+    fi
+done
+exit $failed